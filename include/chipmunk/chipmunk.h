@@ -67,6 +67,17 @@ CP_EXPORT void cpMessage(const char *condition, const char *file, int line, int
 	#define CP_BUFFER_BYTES (32*1024)
 #endif
 
+/// Pairs of polygons that both have at most this many vertexes are collided using a separating axis test instead of GJK/EPA.
+/// Set to 0 to always use GJK/EPA. Must be less than 128.
+#ifndef CP_SAT_MAX_VERTEXES
+	#define CP_SAT_MAX_VERTEXES 8
+#endif
+
+// The separating axis test marks its collision ids with the top bit, which GJK only sets for vertex indexes of 128 or more.
+#if CP_SAT_MAX_VERTEXES > 127
+	#error CP_SAT_MAX_VERTEXES must be less than 128.
+#endif
+
 #ifndef cpcalloc
 	/// Chipmunk calloc() alias.
 	#define cpcalloc calloc
@@ -84,6 +95,7 @@ CP_EXPORT void cpMessage(const char *condition, const char *file, int line, int
 
 typedef struct cpArray cpArray;
 typedef struct cpHashSet cpHashSet;
+typedef struct cpPairTable cpPairTable;
 
 typedef struct cpBody cpBody;
 
@@ -91,6 +103,9 @@ typedef struct cpShape cpShape;
 typedef struct cpCircleShape cpCircleShape;
 typedef struct cpSegmentShape cpSegmentShape;
 typedef struct cpPolyShape cpPolyShape;
+typedef struct cpChainShape cpChainShape;
+typedef struct cpHeightfieldShape cpHeightfieldShape;
+typedef struct cpCompoundShape cpCompoundShape;
 
 typedef struct cpConstraint cpConstraint;
 typedef struct cpPinJoint cpPinJoint;
@@ -120,6 +135,9 @@ typedef struct cpSpace cpSpace;
 #include "cpBody.h"
 #include "cpShape.h"
 #include "cpPolyShape.h"
+#include "cpChainShape.h"
+#include "cpHeightfieldShape.h"
+#include "cpCompoundShape.h"
 
 #include "cpConstraint.h"
 
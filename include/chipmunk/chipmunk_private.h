@@ -68,6 +68,22 @@ typedef cpBool (*cpHashSetFilterFunc)(void *elt, void *data);
 void cpHashSetFilter(cpHashSet *set, cpHashSetFilterFunc func, void *data);
 
 
+//MARK: cpPairTable
+
+// Set of unordered pointer pairs used by the spatial indexes to track overlapping objects.
+
+void cpPairTableInit(cpPairTable *table);
+void cpPairTableDestroy(cpPairTable *table);
+
+// Returns the index of the pair (a, b) in either order, or -1 if it's not in the table.
+int cpPairTableFind(cpPairTable *table, void *a, void *b);
+// Inserts the pair (a, b) if it's not already in the table and returns its index.
+int cpPairTableInsert(cpPairTable *table, void *a, void *b);
+// Removes a pair by moving the last pair into its place.
+void cpPairTableRemoveIndex(cpPairTable *table, int index);
+cpBool cpPairTableRemove(cpPairTable *table, void *a, void *b);
+
+
 //MARK: Bodies
 
 void cpBodyAddShape(cpBody *body, cpShape *shape);
@@ -77,6 +93,8 @@ void cpBodyRemoveShape(cpBody *body, cpShape *shape);
 void cpBodyAccumulateMassFromShapes(cpBody *body);
 
 void cpBodyRemoveConstraint(cpBody *body, cpConstraint *constraint);
+// Move a body without changing its velocity or waking it up. Used by the position solver.
+void cpBodyCorrectPosition(cpBody *body, cpVect dp, cpFloat da);
 
 
 //MARK: Spatial Index Functions
@@ -97,9 +115,19 @@ cpArbiterThreadForBody(cpArbiter *arb, cpBody *body)
 void cpArbiterUnthread(cpArbiter *arb);
 
 void cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space);
-void cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat bias, cpFloat slop);
+void cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias, cpBool blockSolve);
+// Recalculate the bias velocities of the contacts for the current body positions without recalculating the contacts.
+void cpArbiterUpdateBias(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias);
+// Apply the accumulated impulses again at the start of a substep.
+void cpArbiterApplyAccumulatedImpulse(cpArbiter *arb);
 void cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef);
-void cpArbiterApplyImpulse(cpArbiter *arb);
+// Returns the largest change in the accumulated impulses of the arbiter's contacts.
+cpFloat cpArbiterApplyImpulse(cpArbiter *arb);
+// Same as cpArbiterApplyImpulse(), but skips the bias impulses. Used when overlap is resolved by the position solver instead.
+cpFloat cpArbiterApplyVelocityImpulse(cpArbiter *arb);
+// Run one iteration of the position solver, accumulating the corrections in the bodies' solver scratch values.
+// Returns the deepest penetration beyond the slop that was found.
+cpFloat cpArbiterSolvePosition(cpArbiter *arb, cpFloat slop, cpFloat bias);
 
 
 //MARK: Shapes/Collisions
@@ -114,6 +142,39 @@ cpShapeActive(cpShape *shape)
 	return (shape->prev || (shape->body && shape->body->shapeList == shape));
 }
 
+// Exposed so chain shapes can reuse the segment queries for their edges.
+extern const cpShapeClass cpSegmentShapeClass;
+
+static inline int
+cpChainShapeEdgeCount(const cpChainShape *chain)
+{
+	return (chain->loop ? chain->count : chain->count - 1);
+}
+
+// Fill out a temporary segment shape in world coordinates for an edge of a chain.
+void cpChainShapeGetEdge(const cpChainShape *chain, int edge, cpSegmentShape *seg);
+
+typedef void (*cpChainEdgeIteratorFunc)(const cpChainShape *chain, int edge, void *data);
+// Call 'func' for each edge of a chain whose bounding box may overlap 'bb' (in world coordinates).
+void cpChainShapeQueryEdges(const cpChainShape *chain, cpBB bb, cpChainEdgeIteratorFunc func, void *data);
+
+static inline int
+cpHeightfieldShapeColumnCount(const cpHeightfieldShape *heightfield)
+{
+	return heightfield->count - 1;
+}
+
+// Fill out a temporary segment shape in world coordinates for a column of a heightfield.
+void cpHeightfieldShapeGetColumn(const cpHeightfieldShape *heightfield, int column, cpSegmentShape *seg);
+
+// Find the range of columns [first, last) whose x-extents overlap 'bb' (in world coordinates).
+// The range is empty if 'bb' misses the heightfield.
+void cpHeightfieldShapeColumnRange(const cpHeightfieldShape *heightfield, cpBB bb, int *first, int *last);
+
+typedef void (*cpCompoundShapeIteratorFunc)(cpShape *child, int index, void *data);
+// Call 'func' for each child of a compound whose bounding box may overlap 'bb' (in world coordinates).
+void cpCompoundShapeQueryShapes(const cpCompoundShape *compound, cpBB bb, cpCompoundShapeIteratorFunc func, void *data);
+
 // Note: This function returns contact points with r1/r2 in absolute coordinates, not body relative.
 struct cpCollisionInfo cpCollide(const cpShape *a, const cpShape *b, cpCollisionID id, struct cpContact *contacts);
 
@@ -162,6 +223,40 @@ void cpLoopIndexes(const cpVect *verts, int count, int *start, int *end);
 
 void cpConstraintInit(cpConstraint *constraint, const struct cpConstraintClass *klass, cpBody *a, cpBody *b);
 
+// Define the batch versions of a constraint class's preStep(), applyCachedImpulse() and applyImpulseDelta() functions,
+// and an applyImpulse() that discards the delta to match the cpConstraintApplyImpulseImpl signature.
+// Must be used in the same file as the static single constraint functions so they can be inlined into the loops.
+#define CP_DEFINE_CONSTRAINT_BATCH_FUNCS(type)\
+static void preStepBatch(cpConstraint **constraints, int count, cpFloat dt){\
+	for(int i=0; i<count; i++) preStep((type *)constraints[i], dt);\
+}\
+static void applyCachedImpulseBatch(cpConstraint **constraints, int count, cpFloat dt_coef){\
+	for(int i=0; i<count; i++) applyCachedImpulse((type *)constraints[i], dt_coef);\
+}\
+static cpFloat applyImpulseBatch(cpConstraint **constraints, int count, cpFloat dt){\
+	cpFloat delta = 0.0f;\
+	for(int i=0; i<count; i++) delta = cpfmax(delta, applyImpulseDelta((type *)constraints[i], dt));\
+	return delta;\
+}\
+static void applyImpulse(type *constraint, cpFloat dt){\
+	applyImpulseDelta(constraint, dt);\
+}
+
+// Apply a constraint's impulse and return the magnitude of the change in its accumulated impulse.
+static inline cpFloat
+cpConstraintApplyImpulseDelta(cpConstraint *constraint, cpFloat dt)
+{
+	const cpConstraintClass *klass = constraint->klass;
+	if(klass->applyImpulseDelta){
+		return klass->applyImpulseDelta(constraint, dt);
+	} else {
+		// Classes written before the delta function existed only provide applyImpulse().
+		// Their change can't be measured, so they never let the solver stop early.
+		klass->applyImpulse(constraint, dt);
+		return INFINITY;
+	}
+}
+
 static inline void
 cpConstraintActivateBodies(cpConstraint *constraint)
 {
@@ -291,6 +386,21 @@ cpPostStepCallback *cpSpaceGetPostStepCallback(cpSpace *space, void *key);
 cpBool cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space);
 void cpSpaceFilterArbiters(cpSpace *space, cpBody *body, cpShape *filter);
 
+// Returns true if the cached separation between two shapes guarantees they are still not touching.
+// The cached entry (or NULL) is returned in 'cached' so it can be passed to cpSpaceCacheSeparation().
+cpBool cpSpaceSeparationHolds(cpSpace *space, const cpShape *a, const cpShape *b, struct cpSeparation **cached);
+// Remember (or forget) the separation between the shapes of a narrowphase result.
+void cpSpaceCacheSeparation(cpSpace *space, struct cpSeparation *cached, const struct cpCollisionInfo *info);
+cpBool cpSpaceSeparationSetFilter(struct cpSeparation *separation, cpSpace *space);
+// Forget the cached separations involving a shape or the children of a compound, or all of them if 'filter' is NULL.
+void cpSpaceFilterSeparations(cpSpace *space, const cpShape *filter);
+
+// Get the stored collision ID for a pair of shapes, creating it with 'id' if the pair doesn't have one yet.
+struct cpPairID *cpSpacePairID(cpSpace *space, const cpShape *a, const cpShape *b, cpCollisionID id);
+cpBool cpSpacePairIDSetFilter(struct cpPairID *pairID, cpSpace *space);
+// Forget the stored collision IDs involving a shape or the children of a compound.
+void cpSpaceFilterPairIDs(cpSpace *space, const cpShape *filter);
+
 void cpSpaceActivateBody(cpSpace *space, cpBody *body);
 void cpSpaceLock(cpSpace *space);
 void cpSpaceUnlock(cpSpace *space, cpBool runPostStep);
@@ -313,6 +423,23 @@ cpSpaceArrayForBodyType(cpSpace *space, cpBodyType type)
 
 void cpShapeUpdateFunc(cpShape *shape, void *unused);
 cpCollisionID cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space);
+// Find or create the arbiter for a narrowphase result and run the begin/preSolve callbacks.
+// The contacts in info->arr must be the most recently pushed contacts in the space's contact buffer.
+void cpSpaceProcessCollision(cpSpace *space, struct cpCollisionInfo *info);
+
+// Group space->constraints by class and rebuild space->constraintBuckets.
+// Must be called after the constraints array has been finalized for the step.
+void cpSpaceSortConstraints(cpSpace *space);
+// Run the constraint solver functions a bucket at a time.
+void cpSpacePreStepConstraints(cpSpace *space, cpFloat dt);
+void cpSpaceApplyCachedConstraintImpulses(cpSpace *space, cpFloat dt_coef);
+// Returns the largest change in the accumulated impulses of the constraints, which is only measured when the solver tolerance is enabled.
+cpFloat cpSpaceApplyConstraintImpulses(cpSpace *space, cpFloat dt);
+
+// Run the impulse solver iterations using the packed contact arrays in space->contactSolver.
+// Returns the number of iterations used.
+int cpSpaceSolvePacked(cpSpace *space, cpFloat dt);
+void cpContactSolverDestroy(struct cpContactSolver *solver);
 
 
 //MARK: Foreach loops
@@ -341,4 +468,38 @@ cpArbiterNext(cpArbiter *node, cpBody *body)
 #define CP_BODY_FOREACH_COMPONENT(root, var)\
 	for(cpBody *var = root; var; var = var->sleeping.next)
 
+
+//MARK: Broadphase Filtering
+
+static inline cpBool
+cpSpaceQueryRejectConstraint(cpBody *a, cpBody *b)
+{
+	CP_BODY_FOREACH_CONSTRAINT(a, constraint){
+		if(
+			!constraint->collideBodies && (
+				(constraint->a == a && constraint->b == b) ||
+				(constraint->a == b && constraint->b == a)
+			)
+		) return cpTrue;
+	}
+	
+	return cpFalse;
+}
+
+// Returns true if a broadphase pair should be skipped before running the narrowphase.
+static inline cpBool
+cpSpaceQueryReject(cpShape *a, cpShape *b)
+{
+	return (
+		// BBoxes must overlap
+		!cpBBIntersects(a->bb, b->bb)
+		// Don't collide shapes attached to the same body.
+		|| a->body == b->body
+		// Don't collide shapes that are filtered.
+		|| cpShapeFilterReject(a->filter, b->filter)
+		// Don't collide bodies if they have a constraint with collideBodies == cpFalse.
+		|| cpSpaceQueryRejectConstraint(a->body, b->body)
+	);
+}
+
 #endif
@@ -32,6 +32,21 @@ struct cpArray {
 	void **arr;
 };
 
+struct cpPair {
+	void *a, *b;
+	cpCollisionID id;
+};
+
+struct cpPairTable {
+	// Pairs are stored contiguously in the order they were inserted, except where removals filled holes.
+	struct cpPair *pairs;
+	int count, capacity;
+	
+	// Open addressed index of the pairs, -1 marks empty slots. The size is a power of two.
+	int *slots;
+	int slotCount;
+};
+
 struct cpBody {
 	// Integration functions
 	cpBodyVelocityFunc velocity_func;
@@ -78,6 +93,19 @@ struct cpBody {
 		cpBody *next;
 		cpFloat idleTime;
 	} sleeping;
+	
+	// Scratch values used by the solver while batching arbiters and constraints.
+	struct {
+		// Bitmask of the batch colors already used by constraints touching this body.
+		uint64_t colors;
+		// Index of the body in the packed contact solver, or -1 if it hasn't been packed.
+		int index;
+		// Island the body was assigned to by the island solver, or -1 if it hasn't been visited.
+		int island;
+		// Position correction accumulated by the position solver and not yet applied to the body.
+		cpVect dp;
+		cpFloat da;
+	} solver;
 };
 
 enum cpArbiterState {
@@ -119,6 +147,31 @@ struct cpCollisionInfo {
 	int count;
 	// TODO Should this be a unique struct type?
 	struct cpContact *arr;
+	
+	// Lower bound on the gap between the shapes when they are not touching, 0 if unknown.
+	cpFloat d;
+};
+
+// Distance between two nearby shapes that were not touching, cached by cpSpaceSetSeparationCaching().
+struct cpSeparation {
+	const cpShape *a, *b;
+	cpFloat distance;
+	
+	// Body positions and angles when the distance was measured.
+	cpVect p_a, p_b;
+	cpFloat angle_a, angle_b;
+	// How far each shape reaches from its body's center of gravity.
+	cpFloat reach_a, reach_b;
+	
+	cpTimestamp stamp;
+};
+
+// Collision ID of a pair that the spatial index can't store it for, like the children of a compound shape.
+struct cpPairID {
+	const cpShape *a, *b;
+	cpCollisionID id;
+	
+	cpTimestamp stamp;
 };
 
 struct cpArbiter {
@@ -136,6 +189,11 @@ struct cpArbiter {
 	struct cpContact *contacts;
 	cpVect n;
 	
+	// Set by cpArbiterPreStep() when the two contacts are solved together as a 2x2 block.
+	// blockK is the effective mass matrix of the normal impulses and blockMass is its inverse.
+	cpBool blockSolve;
+	cpMat2x2 blockK, blockMass;
+	
 	// Regular, wildcard A and wildcard B collision handlers.
 	cpCollisionHandler *handler, *handlerA, *handlerB;
 	cpBool swapped;
@@ -155,6 +213,9 @@ typedef enum cpShapeType{
 	CP_CIRCLE_SHAPE,
 	CP_SEGMENT_SHAPE,
 	CP_POLY_SHAPE,
+	CP_CHAIN_SHAPE,
+	CP_HEIGHTFIELD_SHAPE,
+	CP_COMPOUND_SHAPE,
 	CP_NUM_SHAPES
 } cpShapeType;
 
@@ -235,16 +296,97 @@ struct cpPolyShape {
 	struct cpSplittingPlane _planes[2*CP_POLY_SHAPE_INLINE_ALLOC];
 };
 
+// Node of a chain shape's bounding volume hierarchy.
+// Nodes are stored in depth first order and cover a contiguous range of edges.
+struct cpChainNode {
+	cpBB bb;
+	int start, end;
+	// Index of the next node to visit when this node's subtree is skipped.
+	int skip;
+};
+
+struct cpChainShape {
+	cpShape shape;
+	
+	cpFloat r;
+	
+	int count;
+	cpBool loop;
+	// Vertexes and edge normals in body coordinates.
+	cpVect *verts;
+	cpVect *normals;
+	
+	int nodeCount;
+	struct cpChainNode *nodes;
+	
+	// Edges are only transformed when they are needed, so the transform from the last cacheData() is kept.
+	cpTransform transform;
+};
+
+struct cpHeightfieldShape {
+	cpShape shape;
+	
+	cpFloat r;
+	
+	int count;
+	cpFloat *heights;
+	cpFloat spacing;
+	cpVect offset;
+	
+	// Bounding box of all the columns in body coordinates.
+	cpBB bb;
+	// Like chain shapes, columns are only transformed when they are needed.
+	cpTransform transform;
+};
+
+// Node of a compound shape's bounding volume hierarchy.
+// Like chain nodes, they are stored in depth first order and cover a contiguous range of child shapes.
+struct cpCompoundNode {
+	cpBB bb;
+	int start, end;
+	int skip;
+};
+
+struct cpCompoundShape {
+	cpShape shape;
+	
+	int count;
+	// Child shapes sorted so the children under each node are contiguous.
+	cpShape **shapes;
+	
+	int nodeCount;
+	struct cpCompoundNode *nodes;
+	
+	cpTransform transform;
+};
+
 typedef void (*cpConstraintPreStepImpl)(cpConstraint *constraint, cpFloat dt);
 typedef void (*cpConstraintApplyCachedImpulseImpl)(cpConstraint *constraint, cpFloat dt_coef);
 typedef void (*cpConstraintApplyImpulseImpl)(cpConstraint *constraint, cpFloat dt);
 typedef cpFloat (*cpConstraintGetImpulseImpl)(cpConstraint *constraint);
+// Same as cpConstraintApplyImpulseImpl, but returns the magnitude of the change in the constraint's accumulated impulse.
+typedef cpFloat (*cpConstraintApplyImpulseDeltaImpl)(cpConstraint *constraint, cpFloat dt);
+
+typedef void (*cpConstraintPreStepBatchImpl)(cpConstraint **constraints, int count, cpFloat dt);
+typedef void (*cpConstraintApplyCachedImpulseBatchImpl)(cpConstraint **constraints, int count, cpFloat dt_coef);
+// Returns the largest change in accumulated impulse of the constraints.
+typedef cpFloat (*cpConstraintApplyImpulseBatchImpl)(cpConstraint **constraints, int count, cpFloat dt);
 
 typedef struct cpConstraintClass {
 	cpConstraintPreStepImpl preStep;
 	cpConstraintApplyCachedImpulseImpl applyCachedImpulse;
 	cpConstraintApplyImpulseImpl applyImpulse;
 	cpConstraintGetImpulseImpl getImpulse;
+	
+	// Optional versions of the functions above that process a whole array of constraints of this class.
+	// If NULL, the space falls back to calling the single constraint functions.
+	cpConstraintPreStepBatchImpl preStepBatch;
+	cpConstraintApplyCachedImpulseBatchImpl applyCachedImpulseBatch;
+	cpConstraintApplyImpulseBatchImpl applyImpulseBatch;
+	
+	// Optional version of applyImpulse() used by the solver tolerance.
+	// If NULL, the solver always runs all of the iterations when the space contains constraints of this class.
+	cpConstraintApplyImpulseDeltaImpl applyImpulseDelta;
 } cpConstraintClass;
 
 struct cpConstraint {
@@ -390,11 +532,52 @@ struct cpSimpleMotor {
 	cpFloat jAcc;
 };
 
+// Range of a space's constraints array that all share the same class.
+struct cpConstraintBucket {
+	const cpConstraintClass *klass;
+	int start, count;
+};
+
 typedef struct cpContactBufferHeader cpContactBufferHeader;
-typedef void (*cpSpaceArbiterApplyImpulseFunc)(cpArbiter *arb);
+
+// Velocity state of a body packed for the contact solver.
+struct cpSolverBody {
+	cpVect v, v_bias;
+	cpFloat w, w_bias;
+	cpFloat m_inv, i_inv;
+};
+
+// Structure of arrays copy of the active contacts, rebuilt each step for the solver.
+struct cpContactSolver {
+	int bodyCount, bodyCapacity;
+	cpBody **bodies;
+	struct cpSolverBody *solverBodies;
+	
+	// Indexes of the packed bodies that are also attached to constraints.
+	// Their velocities must be synced with the cpBody before and after solving constraints.
+	int constrainedCount;
+	int *constrainedBodies;
+	
+	int contactCount, contactCapacity;
+	struct cpContact **contacts;
+	int *bodyA, *bodyB;
+	
+	cpFloat *r1x, *r1y, *r2x, *r2y;
+	cpFloat *nx, *ny;
+	cpFloat *surfaceVx, *surfaceVy;
+	cpFloat *friction;
+	
+	cpFloat *nMass, *tMass;
+	cpFloat *bias, *bounce;
+	cpFloat *jnAcc, *jtAcc, *jBias;
+};
 
 struct cpSpace {
 	int iterations;
+	cpFloat solverTolerance;
+	int iterationsUsed;
+	cpBool blockSolver;
+	int positionIterations;
 	
 	cpVect gravity;
 	cpFloat damping;
@@ -422,11 +605,27 @@ struct cpSpace {
 	
 	cpArray *constraints;
 	
+	// Constraints are grouped by class each step so each group can be solved with a single batch call.
+	struct cpConstraintBucket *constraintBuckets;
+	int constraintBucketCount, constraintBucketCapacity;
+	cpArray *sortedConstraints;
+	
 	cpArray *arbiters;
 	cpContactBufferHeader *contactBuffersHead;
+	
+	cpBool packedSolver;
+	struct cpContactSolver contactSolver;
+
 	cpHashSet *cachedArbiters;
 	cpArray *pooledArbiters;
 	
+	cpBool cacheSeparations;
+	cpHashSet *cachedSeparations;
+	cpArray *pooledSeparations;
+	
+	cpHashSet *cachedPairIDs;
+	cpArray *pooledPairIDs;
+	
 	cpArray *allocatedBuffers;
 	unsigned int locked;
 	
@@ -0,0 +1,48 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpChainShape cpChainShape
+/// A chain of connected edges for large static terrain.
+/// The edges are kept in a bounding volume hierarchy inside the shape so only a single leaf is added to the space's static index.
+/// Contacts against the edges are merged into a single arbiter per colliding shape.
+/// Like segment shapes with neighbors, bumps at the vertexes between edges are smoothed out.
+/// Chain shapes do not collide with other chain or heightfield shapes.
+/// @{
+
+/// Allocate a chain shape.
+CP_EXPORT cpChainShape* cpChainShapeAlloc(void);
+/// Initialize a chain shape from a list of vertexes.
+/// If @c loop is true, the last vertex is connected back to the first.
+/// The vertexes are copied and don't need to be kept around.
+CP_EXPORT cpChainShape* cpChainShapeInit(cpChainShape *chain, cpBody *body, int count, const cpVect *verts, cpBool loop, cpFloat radius);
+/// Allocate and initialize a chain shape from a list of vertexes.
+CP_EXPORT cpShape* cpChainShapeNew(cpBody *body, int count, const cpVect *verts, cpBool loop, cpFloat radius);
+
+/// Get the number of verts in a chain shape.
+CP_EXPORT int cpChainShapeGetCount(const cpShape *shape);
+/// Get the @c ith vertex of a chain shape.
+CP_EXPORT cpVect cpChainShapeGetVert(const cpShape *shape, int index);
+/// Get whether the chain shape's last vertex is connected back to the first.
+CP_EXPORT cpBool cpChainShapeGetLoop(const cpShape *shape);
+/// Get the radius of a chain shape.
+CP_EXPORT cpFloat cpChainShapeGetRadius(const cpShape *shape);
+
+/// @}
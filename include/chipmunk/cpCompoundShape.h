@@ -0,0 +1,46 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpCompoundShape cpCompoundShape
+/// A group of shapes attached to the same body that is added to the space as a single shape.
+/// The children are kept in a bounding volume hierarchy inside the compound, so a complex body only adds a single leaf to the space's index.
+/// The space collides the overlapping children individually, so each child keeps its own arbiters, friction, elasticity, collision type and filter.
+/// A collision has to pass both the compound's and the child's filters.
+/// Point and segment queries report the compound shape.
+/// @{
+
+/// Allocate a compound shape.
+CP_EXPORT cpCompoundShape* cpCompoundShapeAlloc(void);
+/// Initialize a compound shape from a list of child shapes.
+/// The compound takes ownership of the children and frees them when it's freed.
+/// The children must not be compound shapes themselves, must not be added to a space, and must not be modified afterwards.
+/// If any of the children have a mass, the compound's mass is the sum of their masses. Otherwise, set the compound's mass or density directly.
+CP_EXPORT cpCompoundShape* cpCompoundShapeInit(cpCompoundShape *compound, cpBody *body, int count, cpShape **shapes);
+/// Allocate and initialize a compound shape from a list of child shapes.
+CP_EXPORT cpShape* cpCompoundShapeNew(cpBody *body, int count, cpShape **shapes);
+
+/// Get the number of children of a compound shape.
+CP_EXPORT int cpCompoundShapeGetCount(const cpShape *shape);
+/// Get the @c ith child of a compound shape.
+/// The children are reordered when the compound is created, so the order doesn't match the list the compound was created with.
+CP_EXPORT cpShape* cpCompoundShapeGetShape(const cpShape *shape, int index);
+
+/// @}
@@ -2,26 +2,46 @@
 // See http://chipmunk2d.net/legal.php for more information.
 
 /// cpHastySpace is exclusive to Chipmunk Pro
-/// Currently it enables ARM NEON optimizations in the solver, but in the future will include other optimizations such as
-/// a multi-threaded solver and multi-threaded collision broadphases.
+/// It enables ARM NEON or x86 SSE2 optimizations in the solver, a multi-threaded solver and a multi-threaded narrowphase.
 
 struct cpHastySpace;
 typedef struct cpHastySpace cpHastySpace;
 
 /// Create a new hasty space.
-/// On ARM platforms that support NEON, this will enable the vectorized solver.
+/// On ARM platforms that support NEON and on x86 platforms, this will enable the vectorized solver.
 /// cpHastySpace also supports multiple threads, but runs single threaded by default for determinism.
 CP_EXPORT cpSpace *cpHastySpaceNew(void);
 CP_EXPORT void cpHastySpaceFree(cpSpace *space);
 
-/// Set the number of threads to use for the solver.
-/// Currently Chipmunk is limited to 2 threads as using more generally provides very minimal performance gains.
-/// Passing 0 as the thread count on iOS or OS X will cause Chipmunk to automatically detect the number of threads it should use.
-/// On other platforms passing 0 for the thread count will set 1 thread.
+/// Set the number of threads to use for the solver (including the calling thread).
+/// Passing 0 as the thread count will cause Chipmunk to automatically detect the number of hardware threads available.
+/// Idle workers spin briefly waiting for work before going to sleep, so dispatching work to them each step is cheap.
+/// The default solver mode gains little from more than 2 threads. Use CP_HASTY_SOLVER_MODE_COLORED or CP_HASTY_SOLVER_MODE_ISLANDS to scale to more cores.
 CP_EXPORT void cpHastySpaceSetThreads(cpSpace *space, unsigned long threads);
 
 /// Returns the number of threads the solver is using to run.
 CP_EXPORT unsigned long cpHastySpaceGetThreads(cpSpace *space);
 
+/// Algorithms cpHastySpace can use to split the solver work between threads.
+typedef enum cpHastySpaceSolverMode {
+	/// Each thread runs a share of the iterations over all of the arbiters and constraints.
+	/// This is the fastest mode, but threads race on shared bodies so results are not deterministic when using more than one thread.
+	CP_HASTY_SOLVER_MODE_DEFAULT,
+	/// Color the contact graph into batches of arbiters and constraints that share no dynamic bodies and solve each batch in parallel.
+	/// Results are identical from run to run regardless of the thread count.
+	CP_HASTY_SOLVER_MODE_COLORED,
+	/// Split the contact graph into islands of bodies that touch each other and solve each island on a single thread.
+	/// Islands share no dynamic bodies, so there is no synchronization between them and results are identical regardless of the thread count.
+	/// Scales best with many separate piles of objects. A single large pile is solved by a single thread.
+	CP_HASTY_SOLVER_MODE_ISLANDS,
+} cpHastySpaceSolverMode;
+
+/// Set the algorithm used to split the solver work between threads. Defaults to CP_HASTY_SOLVER_MODE_DEFAULT.
+/// cpSpaceSetSolverTolerance() is supported by the island solver mode, where each island stops iterating as soon as it converges,
+/// and by the default solver mode when running on a single thread. The other modes always run all of the iterations.
+CP_EXPORT void cpHastySpaceSetSolverMode(cpSpace *space, cpHastySpaceSolverMode mode);
+/// Returns the algorithm used to split the solver work between threads.
+CP_EXPORT cpHastySpaceSolverMode cpHastySpaceGetSolverMode(cpSpace *space);
+
 /// When stepping a hasty space, you must use this function.
 CP_EXPORT void cpHastySpaceStep(cpSpace *space, cpFloat dt);
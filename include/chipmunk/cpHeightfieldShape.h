@@ -0,0 +1,49 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/// @defgroup cpHeightfieldShape cpHeightfieldShape
+/// A heightmap of samples spaced evenly along the x-axis for side-scrolling terrain.
+/// The columns overlapping a shape are found directly from its bounding box, so only a single leaf is added to the space's static index.
+/// Like chain shapes, contacts against the columns are merged into a single arbiter per colliding shape,
+/// and heightfield shapes do not collide with chain or heightfield shapes.
+/// @{
+
+/// Allocate a heightfield shape.
+CP_EXPORT cpHeightfieldShape* cpHeightfieldShapeAlloc(void);
+/// Initialize a heightfield shape from a list of heights.
+/// Sample @c i is at <tt>cpv(offset.x + i*spacing, offset.y + heights[i])</tt> in body coordinates.
+/// The heights are copied and don't need to be kept around.
+CP_EXPORT cpHeightfieldShape* cpHeightfieldShapeInit(cpHeightfieldShape *heightfield, cpBody *body, int count, const cpFloat *heights, cpFloat spacing, cpVect offset, cpFloat radius);
+/// Allocate and initialize a heightfield shape from a list of heights.
+CP_EXPORT cpShape* cpHeightfieldShapeNew(cpBody *body, int count, const cpFloat *heights, cpFloat spacing, cpVect offset, cpFloat radius);
+
+/// Get the number of samples in a heightfield shape.
+CP_EXPORT int cpHeightfieldShapeGetCount(const cpShape *shape);
+/// Get the @c ith height of a heightfield shape.
+CP_EXPORT cpFloat cpHeightfieldShapeGetHeight(const cpShape *shape, int index);
+/// Get the horizontal distance between the samples of a heightfield shape.
+CP_EXPORT cpFloat cpHeightfieldShapeGetSpacing(const cpShape *shape);
+/// Get the position of the first sample at height 0.
+CP_EXPORT cpVect cpHeightfieldShapeGetOffset(const cpShape *shape);
+/// Get the radius of a heightfield shape.
+CP_EXPORT cpFloat cpHeightfieldShapeGetRadius(const cpShape *shape);
+
+/// @}
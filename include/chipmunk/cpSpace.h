@@ -83,6 +83,44 @@ CP_EXPORT void cpSpaceFree(cpSpace *space);
 CP_EXPORT int cpSpaceGetIterations(const cpSpace *space);
 CP_EXPORT void cpSpaceSetIterations(cpSpace *space, int iterations);
 
+/// The solver stops iterating early once no arbiter or constraint changes its accumulated impulse by more than this amount during an iteration.
+/// The tolerance is an impulse, so it should be scaled along with the masses and velocities of your bodies.
+/// The default value of 0 disables the early out and always runs all of the iterations.
+CP_EXPORT cpFloat cpSpaceGetSolverTolerance(const cpSpace *space);
+CP_EXPORT void cpSpaceSetSolverTolerance(cpSpace *space, cpFloat solverTolerance);
+
+/// Number of solver iterations that were run during the last call to cpSpaceStep(), summed over all of the substeps.
+CP_EXPORT int cpSpaceGetIterationsUsed(const cpSpace *space);
+
+/// If enabled, the normal impulses of collisions with exactly two contacts are solved together as a 2x2 block instead of one after another.
+/// Stacks of boxes converge much faster with the block solver, so they need fewer iterations to be stable.
+/// Ill-conditioned contact pairs fall back to the sequential solver. Ignored by the packed solver. Defaults to false.
+CP_EXPORT cpBool cpSpaceGetBlockSolver(const cpSpace *space);
+CP_EXPORT void cpSpaceSetBlockSolver(cpSpace *space, cpBool blockSolver);
+
+/// Number of iterations of the position solver used to resolve overlapping shapes.
+/// When non-zero, overlap is no longer resolved by the impulse solver using bias velocities.
+/// Instead, a separate pass after the collisions are found moves the overlapping bodies apart directly.
+/// The position pass is much cheaper than an impulse solver iteration and usually only needs a few iterations.
+/// The speed of the correction is still controlled by the collision bias. Only collisions are corrected, not joints.
+/// Not supported by cpHastySpaceStep(). The default value of 0 uses bias velocities.
+CP_EXPORT int cpSpaceGetPositionIterations(const cpSpace *space);
+CP_EXPORT void cpSpaceSetPositionIterations(cpSpace *space, int positionIterations);
+
+/// If enabled, cpSpaceStep() copies the contacts into flat arrays before running the impulse solver.
+/// This avoids chasing pointers between arbiters, bodies and contacts during each iteration and is faster for spaces with many contacts.
+/// Results are identical to the regular solver. Defaults to false.
+CP_EXPORT cpBool cpSpaceGetPackedSolver(const cpSpace *space);
+CP_EXPORT void cpSpaceSetPackedSolver(cpSpace *space, cpBool packedSolver);
+
+/// If enabled, the space remembers the distance between nearby shapes that aren't touching.
+/// The narrowphase is skipped for those pairs until their bodies have moved or rotated far enough that the gap could have closed.
+/// This helps spaces with many loosely packed shapes whose bounding boxes overlap without the shapes touching,
+/// especially polygons with many vertexes. For cheap shapes like circles the bookkeeping can cost more than it saves.
+/// The same contacts are found as when running the narrowphase every step. Defaults to false.
+CP_EXPORT cpBool cpSpaceGetSeparationCaching(const cpSpace *space);
+CP_EXPORT void cpSpaceSetSeparationCaching(cpSpace *space, cpBool cacheSeparations);
+
 /// Gravity to pass to rigid bodies when integrating velocity.
 CP_EXPORT cpVect cpSpaceGetGravity(const cpSpace *space);
 CP_EXPORT void cpSpaceSetGravity(cpSpace *space, cpVect gravity);
@@ -157,6 +195,9 @@ CP_EXPORT cpCollisionHandler *cpSpaceAddWildcardHandler(cpSpace *space, cpCollis
 /// Add a collision shape to the simulation.
 /// If the shape is attached to a static body, it will be added as a static shape.
 CP_EXPORT cpShape* cpSpaceAddShape(cpSpace *space, cpShape *shape);
+/// Add many collision shapes to the simulation at once, such as when loading a level.
+/// The spatial indexes are built in a single pass, which is faster and produces better trees than adding the shapes one at a time.
+CP_EXPORT void cpSpaceAddShapes(cpSpace *space, cpShape **shapes, int count);
 /// Add a rigid body to the simulation.
 CP_EXPORT cpBody* cpSpaceAddBody(cpSpace *space, cpBody *body);
 /// Add a constraint to the simulation.
@@ -246,7 +287,18 @@ CP_EXPORT void cpSpaceReindexShape(cpSpace *space, cpShape *shape);
 CP_EXPORT void cpSpaceReindexShapesForBody(cpSpace *space, cpBody *body);
 
 /// Switch the space to use a spatial has as it's spatial index.
+/// Pass 0 for @c dim to have the spatial hash pick and adapt its own cell dimensions and table size as the shapes change.
 CP_EXPORT void cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count);
+/// Switch the space to keep its static shapes in a packed static tree and its dynamic shapes in a bounding box tree.
+/// The static tree is rebuilt by cpSpaceReindexStatic() and whenever static shapes are added or removed, so it suits large amounts of static geometry that never moves.
+CP_EXPORT void cpSpaceUseStaticTree(cpSpace *space);
+/// Switch the space to use a uniform grid for the dynamic shapes. Static shapes are kept in a bounding box tree.
+/// The cell dimensions should roughly match the size of your objects and the cell count should be a few times larger than the number of objects.
+/// Unlike cpSpaceUseSpatialHash(), @c dim must be positive.
+CP_EXPORT void cpSpaceUseSpatialGrid(cpSpace *space, cpFloat dim, int count);
+/// Switch the space to use a persistent two axis sort and sweep for the dynamic shapes.
+/// Static shapes are kept in a bounding box tree.
+CP_EXPORT void cpSpaceUseSweep2D(cpSpace *space);
 
 
 //MARK: Time Stepping
@@ -254,6 +306,13 @@ CP_EXPORT void cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count);
 /// Step the space forward in time by @c dt.
 CP_EXPORT void cpSpaceStep(cpSpace *space, cpFloat dt);
 
+/// Step the space forward in time by @c dt, split into @c substeps smaller steps of the solver.
+/// Collision detection only runs once, and the substeps reuse the contacts it found.
+/// This is much cheaper than calling cpSpaceStep() several times when you only need a stiffer solver.
+/// Each substep runs the full number of solver iterations, so you will usually want to lower them.
+/// The impulses reported by arbiters and constraints, as well as cpSpaceGetCurrentTimeStep(), are those of the last substep.
+CP_EXPORT void cpSpaceStepSubsteps(cpSpace *space, cpFloat dt, int substeps);
+
 
 //MARK: Debug API
 
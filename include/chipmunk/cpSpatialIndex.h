@@ -81,6 +81,25 @@ CP_EXPORT cpSpatialIndex* cpSpaceHashNew(cpFloat celldim, int cells, cpSpatialIn
 /// Some trial and error is required to find the optimum numbers for efficiency.
 CP_EXPORT void cpSpaceHashResize(cpSpaceHash *hash, cpFloat celldim, int numcells);
 
+/// Let the spatial hash pick its own cell dimensions and table size.
+/// Each rehash collects the average object size and the number of cells the objects cover,
+/// and the next rehash resizes the hash when they drift too far from what it was tuned for.
+/// A hash created with a cell size of 0 takes its initial cell size from the first object inserted.
+CP_EXPORT void cpSpaceHashSetAutoResize(cpSpaceHash *hash, cpBool autoResize);
+
+//MARK: Uniform Grid
+
+typedef struct cpSpaceGrid cpSpaceGrid;
+
+/// Allocate a uniform grid.
+/// Unlike the spatial hash, the grid is rebuilt from scratch each step with a counting sort into flat arrays.
+/// It works best with many similarly sized objects that are about the size of a cell, such as particles.
+CP_EXPORT cpSpaceGrid* cpSpaceGridAlloc(void);
+/// Initialize a uniform grid. The grid wraps around so that it covers all of space using a table of 'numcells' cells.
+CP_EXPORT cpSpatialIndex* cpSpaceGridInit(cpSpaceGrid *grid, cpFloat celldim, int numcells, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+/// Allocate and initialize a uniform grid.
+CP_EXPORT cpSpatialIndex* cpSpaceGridNew(cpFloat celldim, int numcells, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+
 //MARK: AABB Tree
 
 typedef struct cpBBTree cpBBTree;
@@ -92,15 +111,55 @@ CP_EXPORT cpSpatialIndex* cpBBTreeInit(cpBBTree *tree, cpSpatialIndexBBFunc bbfu
 /// Allocate and initialize a bounding box tree.
 CP_EXPORT cpSpatialIndex* cpBBTreeNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
 
+/// Store the overlapping pairs in a hash table instead of linked lists threaded through the leaves.
+/// Pairs are added when leaves start overlapping and swept away when they stop, so long lived pairs cost almost nothing to track.
+/// Pairs whose leaves haven't moved outside of their enlarged bounding boxes are reported without being checked again.
+/// Must be set on the dynamic tree while it's empty. Pairs with a static tree are stored in the dynamic tree's table.
+CP_EXPORT void cpBBTreeSetPairTable(cpSpatialIndex *index, cpBool enabled);
+
+/// Speed up queries by collapsing the tree into nodes with four children whose bounds are tested at once using SIMD.
+/// The wide nodes are rebuilt lazily the first time the tree is queried after it changes,
+/// so they work best for trees that are queried often but change rarely, such as the static shapes of a space.
+/// A dynamic tree also uses the wide nodes of its static tree to find the static pairs.
+CP_EXPORT void cpBBTreeSetWideNodes(cpSpatialIndex *index, cpBool enabled);
+
 /// Perform a static top down optimization of the tree.
+/// The tree is rebuilt using the surface area heuristic.
 CP_EXPORT void cpBBTreeOptimize(cpSpatialIndex *index);
 
+/// State of a tree rebuild that can run in the background.
+typedef struct cpBBTreeRebuild cpBBTreeRebuild;
+
+/// Start rebuilding the tree from scratch using the surface area heuristic.
+/// The tree rebalances itself as objects are inserted and moved, but a full rebuild gives the best query performance.
+/// This copies the bounds of the objects so that cpBBTreeRebuildRun() can be called from another thread while the space is stepped.
+CP_EXPORT cpBBTreeRebuild *cpBBTreeRebuildNew(cpSpatialIndex *index);
+/// Build the new tree. This does not access the index and is safe to call from another thread.
+CP_EXPORT void cpBBTreeRebuildRun(cpBBTreeRebuild *rebuild);
+/// Swap the rebuilt tree in and free the rebuild. Must be called between steps once cpBBTreeRebuildRun() has returned.
+/// Objects that moved since cpBBTreeRebuildNew() are refit into the new tree.
+/// If objects were added or removed in the meantime, the rebuild is discarded and false is returned.
+CP_EXPORT cpBool cpBBTreeRebuildFinish(cpSpatialIndex *index, cpBBTreeRebuild *rebuild);
+
 /// Bounding box tree velocity callback function.
 /// This function should return an estimate for the object's velocity.
 typedef cpVect (*cpBBTreeVelocityFunc)(void *obj);
 /// Set the velocity function for the bounding box tree to enable temporal coherence.
 CP_EXPORT void cpBBTreeSetVelocityFunc(cpSpatialIndex *index, cpBBTreeVelocityFunc func);
 
+//MARK: Static Tree
+
+typedef struct cpStaticTree cpStaticTree;
+
+/// Allocate a packed bounding box tree for objects that rarely move, such as static level geometry.
+/// The tree is built top down with SAH splits and stored depth first with skip links so it can be traversed without a stack.
+/// It cannot be updated incrementally. Adding, removing or moving objects rebuilds the whole tree before it is used next.
+CP_EXPORT cpStaticTree* cpStaticTreeAlloc(void);
+/// Initialize a static tree.
+CP_EXPORT cpSpatialIndex* cpStaticTreeInit(cpStaticTree *tree, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+/// Allocate and initialize a static tree.
+CP_EXPORT cpSpatialIndex* cpStaticTreeNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+
 //MARK: Single Axis Sweep
 
 typedef struct cpSweep1D cpSweep1D;
@@ -112,6 +171,19 @@ CP_EXPORT cpSpatialIndex* cpSweep1DInit(cpSweep1D *sweep, cpSpatialIndexBBFunc b
 /// Allocate and initialize a 1D sort and sweep broadphase.
 CP_EXPORT cpSpatialIndex* cpSweep1DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
 
+//MARK: Two Axis Sweep
+
+typedef struct cpSweep2D cpSweep2D;
+
+/// Allocate a persistent sort and sweep broadphase that sorts along both the x and y axes.
+/// The sorted endpoints and the set of overlapping pairs are kept between steps and updated incrementally,
+/// so it works best when objects move only a little each step relative to their size.
+CP_EXPORT cpSweep2D* cpSweep2DAlloc(void);
+/// Initialize a 2D sort and sweep broadphase.
+CP_EXPORT cpSpatialIndex* cpSweep2DInit(cpSweep2D *sweep, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+/// Allocate and initialize a 2D sort and sweep broadphase.
+CP_EXPORT cpSpatialIndex* cpSweep2DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex);
+
 //MARK: Spatial Index Implementation
 
 typedef void (*cpSpatialIndexDestroyImpl)(cpSpatialIndex *index);
@@ -130,6 +202,8 @@ typedef void (*cpSpatialIndexReindexQueryImpl)(cpSpatialIndex *index, cpSpatialI
 typedef void (*cpSpatialIndexQueryImpl)(cpSpatialIndex *index, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data);
 typedef void (*cpSpatialIndexSegmentQueryImpl)(cpSpatialIndex *index, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data);
 
+typedef void (*cpSpatialIndexInsertBatchImpl)(cpSpatialIndex *index, void **objs, cpHashValue *hashids, int count);
+
 struct cpSpatialIndexClass {
 	cpSpatialIndexDestroyImpl destroy;
 	
@@ -146,6 +220,9 @@ struct cpSpatialIndexClass {
 	
 	cpSpatialIndexQueryImpl query;
 	cpSpatialIndexSegmentQueryImpl segmentQuery;
+	
+	// Optional. Objects are inserted one at a time when NULL.
+	cpSpatialIndexInsertBatchImpl insertBatch;
 };
 
 /// Destroy and free a spatial index.
@@ -185,6 +262,17 @@ static inline void cpSpatialIndexInsert(cpSpatialIndex *index, void *obj, cpHash
 	index->klass->insert(index, obj, hashid);
 }
 
+/// Add several objects to a spatial index at once.
+/// Indexes that support it build their structure in a single pass instead of inserting the objects one at a time.
+static inline void cpSpatialIndexInsertBatch(cpSpatialIndex *index, void **objs, cpHashValue *hashids, int count)
+{
+	if(index->klass->insertBatch){
+		index->klass->insertBatch(index, objs, hashids, count);
+	} else {
+		for(int i=0; i<count; i++) index->klass->insert(index, objs[i], hashids[i]);
+	}
+}
+
 /// Remove an object from a spatial index.
 /// Most spatial indexes use hashed storage, so you must provide a hash value too.
 static inline void cpSpatialIndexRemove(cpSpatialIndex *index, void *obj, cpHashValue hashid)
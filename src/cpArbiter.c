@@ -326,6 +326,7 @@ cpArbiterInit(cpArbiter *arb, cpShape *a, cpShape *b)
 	
 	arb->count = 0;
 	arb->contacts = NULL;
+	arb->blockSolve = cpFalse;
 	
 	arb->a = a; arb->body_a = a->body;
 	arb->b = b; arb->body_b = b->body;
@@ -411,8 +412,38 @@ cpArbiterUpdate(cpArbiter *arb, struct cpCollisionInfo *info, cpSpace *space)
 	if(arb->state == CP_ARBITER_STATE_CACHED) arb->state = CP_ARBITER_STATE_FIRST_COLLISION;
 }
 
+// Block solving ill-conditioned manifolds is numerically unstable, so they fall back to the sequential solver.
+#define BLOCK_SOLVER_MAX_CONDITION 1000.0f
+
+static void
+cpArbiterPreStepBlock(cpArbiter *arb)
+{
+	cpBody *a = arb->body_a;
+	cpBody *b = arb->body_b;
+	cpVect n = arb->n;
+	struct cpContact *con1 = &arb->contacts[0];
+	struct cpContact *con2 = &arb->contacts[1];
+	
+	cpFloat rn1a = cpvcross(con1->r1, n), rn1b = cpvcross(con1->r2, n);
+	cpFloat rn2a = cpvcross(con2->r1, n), rn2b = cpvcross(con2->r2, n);
+	
+	cpFloat m_sum = a->m_inv + b->m_inv;
+	cpFloat k11 = m_sum + a->i_inv*rn1a*rn1a + b->i_inv*rn1b*rn1b;
+	cpFloat k22 = m_sum + a->i_inv*rn2a*rn2a + b->i_inv*rn2b*rn2b;
+	cpFloat k12 = m_sum + a->i_inv*rn1a*rn2a + b->i_inv*rn1b*rn2b;
+	
+	cpFloat det = k11*k22 - k12*k12;
+	arb->blockSolve = (k11*k11 < BLOCK_SOLVER_MAX_CONDITION*det);
+	
+	if(arb->blockSolve){
+		cpFloat det_inv = 1.0f/det;
+		arb->blockK = cpMat2x2New(k11, k12, k12, k22);
+		arb->blockMass = cpMat2x2New(k22*det_inv, -k12*det_inv, -k12*det_inv, k11*det_inv);
+	}
+}
+
 void
-cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias)
+cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias, cpBool blockSolve)
 {
 	cpBody *a = arb->body_a;
 	cpBody *b = arb->body_b;
@@ -434,6 +465,40 @@ cpArbiterPreStep(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias)
 		// Calculate the target bounce velocity.
 		con->bounce = normal_relative_velocity(a, b, con->r1, con->r2, n)*arb->e;
 	}
+	
+	arb->blockSolve = cpFalse;
+	if(blockSolve && arb->count == 2) cpArbiterPreStepBlock(arb);
+}
+
+void
+cpArbiterUpdateBias(cpArbiter *arb, cpFloat dt, cpFloat slop, cpFloat bias)
+{
+	cpBody *a = arb->body_a;
+	cpBody *b = arb->body_b;
+	cpVect n = arb->n;
+	cpVect body_delta = cpvsub(b->p, a->p);
+	
+	for(int i=0; i<arb->count; i++){
+		struct cpContact *con = &arb->contacts[i];
+		
+		// The contact offsets are not updated, so only the separation due to the bodies' translation is tracked.
+		cpFloat dist = cpvdot(cpvadd(cpvsub(con->r2, con->r1), body_delta), n);
+		con->bias = -bias*cpfmin(0.0f, dist + slop)/dt;
+		con->jBias = 0.0f;
+	}
+}
+
+void
+cpArbiterApplyAccumulatedImpulse(cpArbiter *arb)
+{
+	cpBody *a = arb->body_a;
+	cpBody *b = arb->body_b;
+	cpVect n = arb->n;
+	
+	for(int i=0; i<arb->count; i++){
+		struct cpContact *con = &arb->contacts[i];
+		apply_impulses(a, b, con->r1, con->r2, cpvrotate(n, cpv(con->jnAcc, con->jtAcc)));
+	}
 }
 
 void
@@ -452,16 +517,107 @@ cpArbiterApplyCachedImpulse(cpArbiter *arb, cpFloat dt_coef)
 	}
 }
 
-// TODO: is it worth splitting velocity/position correction?
+// Solve the 2 contact LCP K*x + b >= 0, x >= 0 with complementarity by enumerating the four cases.
+// 'old' is the previously accumulated impulse and 'vn' the current normal velocities minus their targets.
+// Returns the new accumulated impulse, or 'old' if no case applies.
+static inline cpVect
+SolveBlockLCP(cpMat2x2 K, cpMat2x2 mass, cpVect old, cpVect vn)
+{
+	cpVect b = cpvsub(vn, cpMat2x2Transform(K, old));
+	
+	// Case 1: Both contacts are pushing.
+	cpVect x = cpvneg(cpMat2x2Transform(mass, b));
+	if(x.x >= 0.0f && x.y >= 0.0f) return x;
+	
+	// Case 2: Only the first contact is pushing.
+	x = cpv(-b.x/K.a, 0.0f);
+	if(x.x >= 0.0f && K.c*x.x + b.y >= 0.0f) return x;
+	
+	// Case 3: Only the second contact is pushing.
+	x = cpv(0.0f, -b.y/K.d);
+	if(x.y >= 0.0f && K.b*x.y + b.x >= 0.0f) return x;
+	
+	// Case 4: Both contacts are separating.
+	if(b.x >= 0.0f && b.y >= 0.0f) return cpvzero;
+	
+	// No solution, this can happen due to numerical error. Leave the impulses alone.
+	return old;
+}
 
-void
-cpArbiterApplyImpulse(cpArbiter *arb)
+// Solves both contacts of a two point manifold together instead of one after another.
+// 'useBias' is a constant so the bias impulses are compiled out of the velocity only version.
+static inline cpFloat
+ApplyImpulseBlock(cpArbiter *arb, const cpBool useBias)
+{
+	cpBody *a = arb->body_a;
+	cpBody *b = arb->body_b;
+	cpVect n = arb->n;
+	cpVect surface_vr = arb->surface_vr;
+	cpFloat friction = arb->u;
+	cpFloat delta = 0.0f;
+	
+	struct cpContact *con1 = &arb->contacts[0];
+	struct cpContact *con2 = &arb->contacts[1];
+	
+	// Bias impulses.
+	if(useBias){
+		cpFloat vbn1 = cpvdot(cpvsub(cpvadd(b->v_bias, cpvmult(cpvperp(con1->r2), b->w_bias)), cpvadd(a->v_bias, cpvmult(cpvperp(con1->r1), a->w_bias))), n);
+		cpFloat vbn2 = cpvdot(cpvsub(cpvadd(b->v_bias, cpvmult(cpvperp(con2->r2), b->w_bias)), cpvadd(a->v_bias, cpvmult(cpvperp(con2->r1), a->w_bias))), n);
+		
+		cpVect old = cpv(con1->jBias, con2->jBias);
+		cpVect acc = SolveBlockLCP(arb->blockK, arb->blockMass, old, cpv(vbn1 - con1->bias, vbn2 - con2->bias));
+		con1->jBias = acc.x;
+		con2->jBias = acc.y;
+		
+		apply_bias_impulses(a, b, con1->r1, con1->r2, cpvmult(n, acc.x - old.x));
+		apply_bias_impulses(a, b, con2->r1, con2->r2, cpvmult(n, acc.y - old.y));
+		delta = cpfmax(delta, cpfmax(cpfabs(acc.x - old.x), cpfabs(acc.y - old.y)));
+	}
+	
+	// Friction impulses are still solved one contact at a time, limited by the normal impulses from the previous iteration.
+	for(int i=0; i<2; i++){
+		struct cpContact *con = &arb->contacts[i];
+		cpVect vr = cpvadd(relative_velocity(a, b, con->r1, con->r2), surface_vr);
+		cpFloat vrt = cpvdot(vr, cpvperp(n));
+		
+		cpFloat jtMax = friction*con->jnAcc;
+		cpFloat jt = -vrt*con->tMass;
+		cpFloat jtOld = con->jtAcc;
+		con->jtAcc = cpfclamp(jtOld + jt, -jtMax, jtMax);
+		
+		apply_impulses(a, b, con->r1, con->r2, cpvmult(cpvperp(n), con->jtAcc - jtOld));
+		delta = cpfmax(delta, cpfabs(con->jtAcc - jtOld));
+	}
+	
+	// Normal impulses.
+	{
+		cpFloat vrn1 = cpvdot(cpvadd(relative_velocity(a, b, con1->r1, con1->r2), surface_vr), n);
+		cpFloat vrn2 = cpvdot(cpvadd(relative_velocity(a, b, con2->r1, con2->r2), surface_vr), n);
+		
+		cpVect old = cpv(con1->jnAcc, con2->jnAcc);
+		cpVect acc = SolveBlockLCP(arb->blockK, arb->blockMass, old, cpv(vrn1 + con1->bounce, vrn2 + con2->bounce));
+		con1->jnAcc = acc.x;
+		con2->jnAcc = acc.y;
+		
+		apply_impulses(a, b, con1->r1, con1->r2, cpvmult(n, acc.x - old.x));
+		apply_impulses(a, b, con2->r1, con2->r2, cpvmult(n, acc.y - old.y));
+		delta = cpfmax(delta, cpfmax(cpfabs(acc.x - old.x), cpfabs(acc.y - old.y)));
+	}
+	
+	return delta;
+}
+
+static inline cpFloat
+ApplyImpulse(cpArbiter *arb, const cpBool useBias)
 {
+	if(arb->blockSolve) return ApplyImpulseBlock(arb, useBias);
+	
 	cpBody *a = arb->body_a;
 	cpBody *b = arb->body_b;
 	cpVect n = arb->n;
 	cpVect surface_vr = arb->surface_vr;
 	cpFloat friction = arb->u;
+	cpFloat delta = 0.0f;
 
 	for(int i=0; i<arb->count; i++){
 		struct cpContact *con = &arb->contacts[i];
@@ -469,17 +625,22 @@ cpArbiterApplyImpulse(cpArbiter *arb)
 		cpVect r1 = con->r1;
 		cpVect r2 = con->r2;
 		
-		cpVect vb1 = cpvadd(a->v_bias, cpvmult(cpvperp(r1), a->w_bias));
-		cpVect vb2 = cpvadd(b->v_bias, cpvmult(cpvperp(r2), b->w_bias));
 		cpVect vr = cpvadd(relative_velocity(a, b, r1, r2), surface_vr);
-		
-		cpFloat vbn = cpvdot(cpvsub(vb2, vb1), n);
 		cpFloat vrn = cpvdot(vr, n);
 		cpFloat vrt = cpvdot(vr, cpvperp(n));
 		
-		cpFloat jbn = (con->bias - vbn)*nMass;
-		cpFloat jbnOld = con->jBias;
-		con->jBias = cpfmax(jbnOld + jbn, 0.0f);
+		if(useBias){
+			cpVect vb1 = cpvadd(a->v_bias, cpvmult(cpvperp(r1), a->w_bias));
+			cpVect vb2 = cpvadd(b->v_bias, cpvmult(cpvperp(r2), b->w_bias));
+			cpFloat vbn = cpvdot(cpvsub(vb2, vb1), n);
+			
+			cpFloat jbn = (con->bias - vbn)*nMass;
+			cpFloat jbnOld = con->jBias;
+			con->jBias = cpfmax(jbnOld + jbn, 0.0f);
+			
+			apply_bias_impulses(a, b, r1, r2, cpvmult(n, con->jBias - jbnOld));
+			delta = cpfmax(delta, cpfabs(con->jBias - jbnOld));
+		}
 		
 		cpFloat jn = -(con->bounce + vrn)*nMass;
 		cpFloat jnOld = con->jnAcc;
@@ -490,7 +651,54 @@ cpArbiterApplyImpulse(cpArbiter *arb)
 		cpFloat jtOld = con->jtAcc;
 		con->jtAcc = cpfclamp(jtOld + jt, -jtMax, jtMax);
 		
-		apply_bias_impulses(a, b, r1, r2, cpvmult(n, con->jBias - jbnOld));
 		apply_impulses(a, b, r1, r2, cpvrotate(n, cpv(con->jnAcc - jnOld, con->jtAcc - jtOld)));
+		
+		delta = cpfmax(delta, cpfmax(cpfabs(con->jnAcc - jnOld), cpfabs(con->jtAcc - jtOld)));
 	}
+	
+	return delta;
+}
+
+cpFloat
+cpArbiterApplyImpulse(cpArbiter *arb)
+{
+	return ApplyImpulse(arb, cpTrue);
+}
+
+cpFloat
+cpArbiterApplyVelocityImpulse(cpArbiter *arb)
+{
+	return ApplyImpulse(arb, cpFalse);
+}
+
+cpFloat
+cpArbiterSolvePosition(cpArbiter *arb, cpFloat slop, cpFloat bias)
+{
+	cpBody *a = arb->body_a;
+	cpBody *b = arb->body_b;
+	cpVect n = arb->n;
+	cpFloat depth = 0.0f;
+	
+	for(int i=0; i<arb->count; i++){
+		struct cpContact *con = &arb->contacts[i];
+		
+		// Rotate the contact offsets by the correction accumulated so far (small angle approximation).
+		cpVect r1 = cpvadd(con->r1, cpvmult(cpvperp(con->r1), a->solver.da));
+		cpVect r2 = cpvadd(con->r2, cpvmult(cpvperp(con->r2), b->solver.da));
+		cpVect p1 = cpvadd(a->p, a->solver.dp);
+		cpVect p2 = cpvadd(b->p, b->solver.dp);
+		
+		cpFloat dist = cpvdot(cpvadd(cpvsub(r2, r1), cpvsub(p2, p1)), n);
+		cpFloat C = cpfmin(0.0f, dist + slop);
+		depth = cpfmax(depth, -C);
+		
+		// Push the bodies apart directly, using the effective mass from the prestep.
+		cpVect P = cpvmult(n, -bias*C*con->nMass);
+		a->solver.dp = cpvsub(a->solver.dp, cpvmult(P, a->m_inv));
+		a->solver.da -= a->i_inv*cpvcross(r1, P);
+		b->solver.dp = cpvadd(b->solver.dp, cpvmult(P, b->m_inv));
+		b->solver.da += b->i_inv*cpvcross(r2, P);
+	}
+	
+	return depth;
 }
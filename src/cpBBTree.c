@@ -27,48 +27,78 @@
 static inline cpSpatialIndexClass *Klass();
 
 typedef struct Node Node;
+typedef struct NodeLink NodeLink;
+typedef struct Leaf Leaf;
 typedef struct Pair Pair;
+typedef struct WideNode WideNode;
+
+// Index used to mark missing nodes.
+#define NULL_NODE (-1)
 
 struct cpBBTree {
 	cpSpatialIndex spatialIndex;
 	cpBBTreeVelocityFunc velocityFunc;
 	
 	cpHashSet *leaves;
-	Node *root;
+	int root;
+	
+	// Nodes are stored in two parallel arrays addressed by index.
+	// 'nodes' holds the fields read while traversing the tree, 'links' holds the rest.
+	Node *nodes;
+	NodeLink *links;
+	int nodeCount, nodeCapacity;
+	int pooledNodes;
 	
-	Node *pooledNodes;
+	Leaf *pooledLeaves;
 	Pair *pooledPairs;
 	cpArray *allocatedBuffers;
 	
 	cpTimestamp stamp;
+	// Incremented when objects are inserted or removed to detect stale rebuilds.
+	unsigned int version;
+	
+	// Pairs stored in an open addressed hash table instead of the threaded lists. See cpBBTreeSetPairTable().
+	cpBool pairTable;
+	cpPairTable tablePairs;
+	// Removed leaves that may still be referenced by table pairs.
+	cpArray *deadLeaves;
+	// Leaves with a stamp older than this have not moved since the pairs were last swept.
+	cpTimestamp sweepStamp;
+	
+	// Copy of the tree collapsed into nodes with four children. See cpBBTreeSetWideNodes().
+	cpBool wideEnabled;
+	// Set when the tree changes and the wide nodes need to be rebuilt before they are used again.
+	cpBool wideDirty;
+	WideNode *wideNodes;
+	int wideCount, wideCapacity;
 };
 
 struct Node {
-	void *obj;
 	cpBB bb;
-	Node *parent;
-	
-	union {
-		// Internal nodes
-		struct { Node *a, *b; } children;
-		
-		// Leaves
-		struct {
-			cpTimestamp stamp;
-			Pair *pairs;
-		} leaf;
-	} node;
+	// Children of internal nodes. Leaves have no children.
+	int a, b;
+};
+
+struct NodeLink {
+	// The parent of pooled nodes is the next pooled node.
+	int parent;
+	// The leaf data when the node is a leaf.
+	Leaf *leaf;
 };
 
-// Can't use anonymous unions and still get good x-compiler compatability
-#define A node.children.a
-#define B node.children.b
-#define STAMP node.leaf.stamp
-#define PAIRS node.leaf.pairs
+// Leaf data needs a stable address since it's stored in the leaves hash set.
+struct Leaf {
+	void *obj;
+	cpBBTree *tree;
+	// NULL_NODE once the leaf has been removed.
+	int node;
+	cpTimestamp stamp;
+	Pair *pairs;
+};
 
 typedef struct Thread {
 	Pair *prev;
-	Node *leaf;
+	Leaf *leaf;
 	Pair *next;
 } Thread;
 
@@ -77,6 +107,15 @@ struct Pair {
 	cpCollisionID id;
 };
 
+struct WideNode {
+	// Bounds of the children in structure of arrays form so four of them can be tested at once.
+	// They are rounded outwards to floats, so a hit is only a hint and leaves are checked again exactly.
+	float l[4], b[4], r[4], t[4];
+	// Wide node index of an internal child, or the node index of a leaf child stored as ~node.
+	int child[4];
+	int count;
+};
+
 //MARK: Misc Functions
 
 static inline cpBB
@@ -103,9 +142,10 @@ GetTree(cpSpatialIndex *index)
 	return (index && index->klass == Klass() ? (cpBBTree *)index : NULL);
 }
 
-static inline Node *
-GetRootIfTree(cpSpatialIndex *index){
-	return (index && index->klass == Klass() ? ((cpBBTree *)index)->root : NULL);
+static inline cpBBTree *
+GetTreeIfRoot(cpSpatialIndex *index){
+	cpBBTree *tree = GetTree(index);
+	return (tree && tree->root != NULL_NODE ? tree : NULL);
 }
 
 static inline cpBBTree *
@@ -178,15 +218,18 @@ ThreadUnlink(Thread thread)
 	if(prev){
 		if(prev->a.leaf == thread.leaf) prev->a.next = next; else prev->b.next = next;
 	} else {
-		thread.leaf->PAIRS = next;
+		thread.leaf->pairs = next;
 	}
 }
 
 static void
-PairsClear(Node *leaf, cpBBTree *tree)
+PairsClear(Leaf *leaf, cpBBTree *tree)
 {
-	Pair *pair = leaf->PAIRS;
-	leaf->PAIRS = NULL;
+	// Table pairs are removed lazily when they are swept.
+	if(GetMasterTree(tree)->pairTable) return;
+	
+	Pair *pair = leaf->pairs;
+	leaf->pairs = NULL;
 	
 	while(pair){
 		if(pair->a.leaf == leaf){
@@ -204,13 +247,19 @@ PairsClear(Node *leaf, cpBBTree *tree)
 }
 
 static void
-PairInsert(Node *a, Node *b, cpBBTree *tree)
+PairInsert(Leaf *a, Leaf *b, cpBBTree *tree)
 {
-	Pair *nextA = a->PAIRS, *nextB = b->PAIRS;
+	cpBBTree *master = GetMasterTree(tree);
+	if(master->pairTable){
+		cpPairTableInsert(&master->tablePairs, a, b);
+		return;
+	}
+	
+	Pair *nextA = a->pairs, *nextB = b->pairs;
 	Pair *pair = PairFromPool(tree);
 	Pair temp = {{NULL, a, nextA},{NULL, b, nextB}, 0};
 	
-	a->PAIRS = b->PAIRS = pair;
+	a->pairs = b->pairs = pair;
 	*pair = temp;
 	
 	if(nextA){
@@ -222,95 +271,200 @@ PairInsert(Node *a, Node *b, cpBBTree *tree)
 	}
 }
 
+//MARK: Pair Table Functions
+
+static inline cpBB
+LeafGetBB(Leaf *leaf)
+{
+	return leaf->tree->nodes[leaf->node].bb;
+}
+
+static void LeafRecycle(cpBBTree *tree, Leaf *leaf);
+
+// Report all of the pairs to the query function, dropping pairs whose leaves were removed or no longer overlap.
+// Pairs where neither leaf moved since the last sweep can't have stopped overlapping and are reported without checking.
+static void
+PairTableSweep(cpBBTree *tree, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpTimestamp stamp = tree->sweepStamp;
+	
+	cpPairTable *table = &tree->tablePairs;
+	for(int i=0; i<table->count;){
+		struct cpPair *pair = table->pairs + i;
+		Leaf *a = (Leaf *)pair->a, *b = (Leaf *)pair->b;
+		
+		if(
+			a->node == NULL_NODE || b->node == NULL_NODE ||
+			((a->stamp >= stamp || b->stamp >= stamp) && !cpBBIntersects(LeafGetBB(a), LeafGetBB(b)))
+		){
+			cpPairTableRemoveIndex(table, i);
+		} else {
+			pair->id = func(a->obj, b->obj, pair->id, data);
+			i++;
+		}
+	}
+	
+	// Nothing references the dead leaves anymore.
+	cpArray *dead = tree->deadLeaves;
+	for(int i=0; i<dead->num; i++){
+		Leaf *leaf = (Leaf *)dead->arr[i];
+		LeafRecycle(leaf->tree, leaf);
+	}
+	dead->num = 0;
+}
 
 //MARK: Node Functions
 
 static void
-NodeRecycle(cpBBTree *tree, Node *node)
+NodeRecycle(cpBBTree *tree, int node)
 {
-	node->parent = tree->pooledNodes;
+	tree->links[node].parent = tree->pooledNodes;
 	tree->pooledNodes = node;
 }
 
-static Node *
+// Beware that this may move the node arrays, so Node pointers must not be held across calls to it.
+static int
 NodeFromPool(cpBBTree *tree)
 {
-	Node *node = tree->pooledNodes;
+	int node = tree->pooledNodes;
 	
-	if(node){
-		tree->pooledNodes = node->parent;
+	if(node != NULL_NODE){
+		tree->pooledNodes = tree->links[node].parent;
 		return node;
 	} else {
-		// Pool is exhausted, make more
-		int count = CP_BUFFER_BYTES/sizeof(Node);
-		cpAssertHard(count, "Internal Error: Buffer size is too small.");
-		
-		Node *buffer = (Node *)cpcalloc(1, CP_BUFFER_BYTES);
-		cpArrayPush(tree->allocatedBuffers, buffer);
+		// Pool is exhausted, grow the arrays
+		if(tree->nodeCount == tree->nodeCapacity){
+			tree->nodeCapacity = (tree->nodeCapacity ? 2*tree->nodeCapacity : CP_BUFFER_BYTES/sizeof(Node));
+			tree->nodes = (Node *)cprealloc(tree->nodes, tree->nodeCapacity*sizeof(Node));
+			tree->links = (NodeLink *)cprealloc(tree->links, tree->nodeCapacity*sizeof(NodeLink));
+		}
 		
-		// push all but the first one, return the first instead
-		for(int i=1; i<count; i++) NodeRecycle(tree, buffer + i);
-		return buffer;
+		return tree->nodeCount++;
 	}
 }
 
 static inline void
-NodeSetA(Node *node, Node *value)
+NodeSetA(cpBBTree *tree, int node, int value)
 {
-	node->A = value;
-	value->parent = node;
+	tree->nodes[node].a = value;
+	tree->links[value].parent = node;
 }
 
 static inline void
-NodeSetB(Node *node, Node *value)
+NodeSetB(cpBBTree *tree, int node, int value)
 {
-	node->B = value;
-	value->parent = node;
+	tree->nodes[node].b = value;
+	tree->links[value].parent = node;
 }
 
-static Node *
-NodeNew(cpBBTree *tree, Node *a, Node *b)
+static int
+NodeNew(cpBBTree *tree, int a, int b)
 {
-	Node *node = NodeFromPool(tree);
+	int node = NodeFromPool(tree);
 	
-	node->obj = NULL;
-	node->bb = cpBBMerge(a->bb, b->bb);
-	node->parent = NULL;
+	tree->nodes[node].bb = cpBBMerge(tree->nodes[a].bb, tree->nodes[b].bb);
+	tree->links[node].parent = NULL_NODE;
+	tree->links[node].leaf = NULL;
 	
-	NodeSetA(node, a);
-	NodeSetB(node, b);
+	NodeSetA(tree, node, a);
+	NodeSetB(tree, node, b);
 	
 	return node;
 }
 
 static inline cpBool
-NodeIsLeaf(Node *node)
+NodeIsLeaf(const Node *node)
 {
-	return (node->obj != NULL);
+	return (node->a == NULL_NODE);
 }
 
-static inline Node *
-NodeOther(Node *node, Node *child)
+static inline int
+NodeOther(cpBBTree *tree, int node, int child)
 {
-	return (node->A == child ? node->B : node->A);
+	Node *n = tree->nodes + node;
+	return (n->a == child ? n->b : n->a);
+}
+
+// Swap a grandchild of 'node' with its uncle when that shrinks the area of the grandchild's parent.
+// Applied to every node whose bounds changed on insert and remove to keep the tree balanced as objects move.
+static void
+NodeRotate(cpBBTree *tree, int node)
+{
+	Node *nodes = tree->nodes;
+	int b = nodes[node].a, c = nodes[node].b;
+	
+	// 0: no rotation, 1: c <-> b.a, 2: c <-> b.b, 3: b <-> c.a, 4: b <-> c.b
+	int rotation = 0;
+	cpFloat best = 0.0f;
+	
+	if(!NodeIsLeaf(nodes + b)){
+		cpFloat area = cpBBArea(nodes[b].bb);
+		cpBB d = nodes[nodes[b].a].bb, e = nodes[nodes[b].b].bb, cbb = nodes[c].bb;
+		
+		cpFloat gain_d = area - cpBBMergedArea(cbb, e);
+		if(gain_d > best){best = gain_d; rotation = 1;}
+		
+		cpFloat gain_e = area - cpBBMergedArea(d, cbb);
+		if(gain_e > best){best = gain_e; rotation = 2;}
+	}
+	
+	if(!NodeIsLeaf(nodes + c)){
+		cpFloat area = cpBBArea(nodes[c].bb);
+		cpBB f = nodes[nodes[c].a].bb, g = nodes[nodes[c].b].bb, bbb = nodes[b].bb;
+		
+		cpFloat gain_f = area - cpBBMergedArea(bbb, g);
+		if(gain_f > best){best = gain_f; rotation = 3;}
+		
+		cpFloat gain_g = area - cpBBMergedArea(f, bbb);
+		if(gain_g > best){best = gain_g; rotation = 4;}
+	}
+	
+	switch(rotation){
+		case 1: {
+			int d = nodes[b].a;
+			NodeSetB(tree, node, d);
+			NodeSetA(tree, b, c);
+			nodes[b].bb = cpBBMerge(nodes[c].bb, nodes[nodes[b].b].bb);
+		} break;
+		case 2: {
+			int e = nodes[b].b;
+			NodeSetB(tree, node, e);
+			NodeSetB(tree, b, c);
+			nodes[b].bb = cpBBMerge(nodes[nodes[b].a].bb, nodes[c].bb);
+		} break;
+		case 3: {
+			int f = nodes[c].a;
+			NodeSetA(tree, node, f);
+			NodeSetA(tree, c, b);
+			nodes[c].bb = cpBBMerge(nodes[b].bb, nodes[nodes[c].b].bb);
+		} break;
+		case 4: {
+			int g = nodes[c].b;
+			NodeSetA(tree, node, g);
+			NodeSetB(tree, c, b);
+			nodes[c].bb = cpBBMerge(nodes[nodes[c].a].bb, nodes[b].bb);
+		} break;
+	}
 }
 
 static inline void
-NodeReplaceChild(Node *parent, Node *child, Node *value, cpBBTree *tree)
+NodeReplaceChild(cpBBTree *tree, int parent, int child, int value)
 {
-	cpAssertSoft(!NodeIsLeaf(parent), "Internal Error: Cannot replace child of a leaf.");
-	cpAssertSoft(child == parent->A || child == parent->B, "Internal Error: Node is not a child of parent.");
+	Node *nodes = tree->nodes;
+	cpAssertSoft(!NodeIsLeaf(nodes + parent), "Internal Error: Cannot replace child of a leaf.");
+	cpAssertSoft(child == nodes[parent].a || child == nodes[parent].b, "Internal Error: Node is not a child of parent.");
 	
-	if(parent->A == child){
-		NodeRecycle(tree, parent->A);
-		NodeSetA(parent, value);
+	if(nodes[parent].a == child){
+		NodeRecycle(tree, child);
+		NodeSetA(tree, parent, value);
 	} else {
-		NodeRecycle(tree, parent->B);
-		NodeSetB(parent, value);
+		NodeRecycle(tree, child);
+		NodeSetB(tree, parent, value);
 	}
 	
-	for(Node *node=parent; node; node = node->parent){
-		node->bb = cpBBMerge(node->A->bb, node->B->bb);
+	for(int node=parent; node != NULL_NODE; node = tree->links[node].parent){
+		nodes[node].bb = cpBBMerge(nodes[nodes[node].a].bb, nodes[nodes[node].b].bb);
+		NodeRotate(tree, node);
 	}
 }
 
@@ -322,141 +476,454 @@ cpBBProximity(cpBB a, cpBB b)
 	return cpfabs(a.l + a.r - b.l - b.r) + cpfabs(a.b + a.t - b.b - b.t);
 }
 
-static Node *
-SubtreeInsert(Node *subtree, Node *leaf, cpBBTree *tree)
+static int
+SubtreeInsert(cpBBTree *tree, int subtree, int leaf)
 {
-	if(subtree == NULL){
+	if(subtree == NULL_NODE){
 		return leaf;
-	} else if(NodeIsLeaf(subtree)){
+	} else if(NodeIsLeaf(tree->nodes + subtree)){
 		return NodeNew(tree, leaf, subtree);
 	} else {
-		cpFloat cost_a = cpBBArea(subtree->B->bb) + cpBBMergedArea(subtree->A->bb, leaf->bb);
-		cpFloat cost_b = cpBBArea(subtree->A->bb) + cpBBMergedArea(subtree->B->bb, leaf->bb);
+		Node *nodes = tree->nodes;
+		int a = nodes[subtree].a, b = nodes[subtree].b;
+		cpBB bb = nodes[leaf].bb;
+		
+		cpFloat cost_a = cpBBArea(nodes[b].bb) + cpBBMergedArea(nodes[a].bb, bb);
+		cpFloat cost_b = cpBBArea(nodes[a].bb) + cpBBMergedArea(nodes[b].bb, bb);
 		
 		if(cost_a == cost_b){
-			cost_a = cpBBProximity(subtree->A->bb, leaf->bb);
-			cost_b = cpBBProximity(subtree->B->bb, leaf->bb);
+			cost_a = cpBBProximity(nodes[a].bb, bb);
+			cost_b = cpBBProximity(nodes[b].bb, bb);
 		}
 		
+		// The recursive insert may move the node arrays.
 		if(cost_b < cost_a){
-			NodeSetB(subtree, SubtreeInsert(subtree->B, leaf, tree));
+			NodeSetB(tree, subtree, SubtreeInsert(tree, b, leaf));
 		} else {
-			NodeSetA(subtree, SubtreeInsert(subtree->A, leaf, tree));
+			NodeSetA(tree, subtree, SubtreeInsert(tree, a, leaf));
 		}
 		
-		subtree->bb = cpBBMerge(subtree->bb, leaf->bb);
+		tree->nodes[subtree].bb = cpBBMerge(tree->nodes[subtree].bb, bb);
+		NodeRotate(tree, subtree);
 		return subtree;
 	}
 }
 
 static void
-SubtreeQuery(Node *subtree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+SubtreeQuery(cpBBTree *tree, int subtree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
 {
-	if(cpBBIntersects(subtree->bb, bb)){
-		if(NodeIsLeaf(subtree)){
-			func(obj, subtree->obj, 0, data);
+	Node *node = tree->nodes + subtree;
+	if(cpBBIntersects(node->bb, bb)){
+		if(NodeIsLeaf(node)){
+			func(obj, tree->links[subtree].leaf->obj, 0, data);
 		} else {
-			SubtreeQuery(subtree->A, obj, bb, func, data);
-			SubtreeQuery(subtree->B, obj, bb, func, data);
+			int b = node->b;
+			SubtreeQuery(tree, node->a, obj, bb, func, data);
+			SubtreeQuery(tree, b, obj, bb, func, data);
 		}
 	}
 }
 
 
 static cpFloat
-SubtreeSegmentQuery(Node *subtree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+SubtreeSegmentQuery(cpBBTree *tree, int subtree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
 {
-	if(NodeIsLeaf(subtree)){
-		return func(obj, subtree->obj, data);
+	Node *node = tree->nodes + subtree;
+	if(NodeIsLeaf(node)){
+		return func(obj, tree->links[subtree].leaf->obj, data);
 	} else {
-		cpFloat t_a = cpBBSegmentQuery(subtree->A->bb, a, b);
-		cpFloat t_b = cpBBSegmentQuery(subtree->B->bb, a, b);
+		int node_a = node->a, node_b = node->b;
+		cpFloat t_a = cpBBSegmentQuery(tree->nodes[node_a].bb, a, b);
+		cpFloat t_b = cpBBSegmentQuery(tree->nodes[node_b].bb, a, b);
 		
 		if(t_a < t_b){
-			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->A, obj, a, b, t_exit, func, data));
-			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->B, obj, a, b, t_exit, func, data));
+			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node_a, obj, a, b, t_exit, func, data));
+			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node_b, obj, a, b, t_exit, func, data));
 		} else {
-			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->B, obj, a, b, t_exit, func, data));
-			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(subtree->A, obj, a, b, t_exit, func, data));
+			if(t_b < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node_b, obj, a, b, t_exit, func, data));
+			if(t_a < t_exit) t_exit = cpfmin(t_exit, SubtreeSegmentQuery(tree, node_a, obj, a, b, t_exit, func, data));
 		}
 		
 		return t_exit;
 	}
 }
 
-static void
-SubtreeRecycle(cpBBTree *tree, Node *node)
-{
-	if(!NodeIsLeaf(node)){
-		SubtreeRecycle(tree, node->A);
-		SubtreeRecycle(tree, node->B);
-		NodeRecycle(tree, node);
-	}
-}
-
-static inline Node *
-SubtreeRemove(Node *subtree, Node *leaf, cpBBTree *tree)
+static inline int
+SubtreeRemove(cpBBTree *tree, int subtree, int leaf)
 {
 	if(leaf == subtree){
-		return NULL;
+		return NULL_NODE;
 	} else {
-		Node *parent = leaf->parent;
+		int parent = tree->links[leaf].parent;
 		if(parent == subtree){
-			Node *other = NodeOther(subtree, leaf);
-			other->parent = subtree->parent;
+			int other = NodeOther(tree, subtree, leaf);
+			tree->links[other].parent = tree->links[subtree].parent;
 			NodeRecycle(tree, subtree);
 			return other;
 		} else {
-			NodeReplaceChild(parent->parent, parent, NodeOther(parent, leaf), tree);
+			NodeReplaceChild(tree, tree->links[parent].parent, parent, NodeOther(tree, parent, leaf));
 			return subtree;
 		}
 	}
 }
 
+//MARK: Wide Node Functions
+
+// Wide nodes test the bounds of all four children with a single SIMD comparison.
+#if __ARM_NEON__
+	#include <arm_neon.h>
+	
+	typedef float32x4_t Wide4;
+	typedef uint32x4_t WideMask4;
+	
+	static inline Wide4 WideLoad(const float *p){return vld1q_f32(p);}
+	static inline void WideStore(float *p, Wide4 v){vst1q_f32(p, v);}
+	static inline Wide4 WideSplat(float x){return vdupq_n_f32(x);}
+	static inline Wide4 WideSub(Wide4 a, Wide4 b){return vsubq_f32(a, b);}
+	static inline Wide4 WideMul(Wide4 a, Wide4 b){return vmulq_f32(a, b);}
+	static inline Wide4 WideMin(Wide4 a, Wide4 b){return vminq_f32(a, b);}
+	static inline Wide4 WideMax(Wide4 a, Wide4 b){return vmaxq_f32(a, b);}
+	static inline WideMask4 WideLE(Wide4 a, Wide4 b){return vcleq_f32(a, b);}
+	static inline WideMask4 WideAnd(WideMask4 a, WideMask4 b){return vandq_u32(a, b);}
+	
+	static inline int
+	WideBits(WideMask4 mask)
+	{
+		static const uint32_t bits[4] = {1, 2, 4, 8};
+		uint32x4_t v = vandq_u32(mask, vld1q_u32(bits));
+		uint32x2_t sum = vadd_u32(vget_low_u32(v), vget_high_u32(v));
+		return (int)(vget_lane_u32(sum, 0) | vget_lane_u32(sum, 1));
+	}
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	
+	typedef __m128 Wide4;
+	typedef __m128 WideMask4;
+	
+	static inline Wide4 WideLoad(const float *p){return _mm_loadu_ps(p);}
+	static inline void WideStore(float *p, Wide4 v){_mm_storeu_ps(p, v);}
+	static inline Wide4 WideSplat(float x){return _mm_set1_ps(x);}
+	static inline Wide4 WideSub(Wide4 a, Wide4 b){return _mm_sub_ps(a, b);}
+	static inline Wide4 WideMul(Wide4 a, Wide4 b){return _mm_mul_ps(a, b);}
+	static inline Wide4 WideMin(Wide4 a, Wide4 b){return _mm_min_ps(a, b);}
+	static inline Wide4 WideMax(Wide4 a, Wide4 b){return _mm_max_ps(a, b);}
+	static inline WideMask4 WideLE(Wide4 a, Wide4 b){return _mm_cmple_ps(a, b);}
+	static inline WideMask4 WideAnd(WideMask4 a, WideMask4 b){return _mm_and_ps(a, b);}
+	static inline int WideBits(WideMask4 mask){return _mm_movemask_ps(mask);}
+#else
+	// Plain C fallback. The loops are simple enough for the compiler to vectorize on its own.
+	typedef struct Wide4 {float v[4];} Wide4;
+	typedef struct WideMask4 {int v[4];} WideMask4;
+	
+	static inline Wide4 WideLoad(const float *p){Wide4 r = {{p[0], p[1], p[2], p[3]}}; return r;}
+	static inline void WideStore(float *p, Wide4 v){for(int i=0; i<4; i++) p[i] = v.v[i];}
+	static inline Wide4 WideSplat(float x){Wide4 r = {{x, x, x, x}}; return r;}
+	static inline Wide4 WideSub(Wide4 a, Wide4 b){for(int i=0; i<4; i++) a.v[i] -= b.v[i]; return a;}
+	static inline Wide4 WideMul(Wide4 a, Wide4 b){for(int i=0; i<4; i++) a.v[i] *= b.v[i]; return a;}
+	static inline Wide4 WideMin(Wide4 a, Wide4 b){for(int i=0; i<4; i++) a.v[i] = (a.v[i] < b.v[i] ? a.v[i] : b.v[i]); return a;}
+	static inline Wide4 WideMax(Wide4 a, Wide4 b){for(int i=0; i<4; i++) a.v[i] = (a.v[i] > b.v[i] ? a.v[i] : b.v[i]); return a;}
+	static inline WideMask4 WideLE(Wide4 a, Wide4 b){WideMask4 r; for(int i=0; i<4; i++) r.v[i] = (a.v[i] <= b.v[i]); return r;}
+	static inline WideMask4 WideAnd(WideMask4 a, WideMask4 b){for(int i=0; i<4; i++) a.v[i] &= b.v[i]; return a;}
+	static inline int WideBits(WideMask4 mask){return mask.v[0] | mask.v[1]<<1 | mask.v[2]<<2 | mask.v[3]<<3;}
+#endif
+
+// Segments are tested against bounds padded by this fraction of the coordinate magnitude
+// to cover the error of converting the segment to single precision.
+#define WIDE_SEGMENT_PADDING (1.0f/(1 << 20))
+// Widens the exit distance of the slab test to cover the rounding of the slab distances.
+#define WIDE_SEGMENT_SLACK (1.0f + 1.0f/(1 << 20))
+
+static inline float FloatDown(cpFloat x){float f = (float)x; return (f > x ? nextafterf(f, -FLT_MAX) : f);}
+static inline float FloatUp(cpFloat x){float f = (float)x; return (f < x ? nextafterf(f, FLT_MAX) : f);}
+
+// Bounding box splatted across all four lanes.
+typedef struct WideBB {
+	Wide4 l, b, r, t;
+} WideBB;
+
+static inline WideBB
+WideBBNew(cpBB bb)
+{
+	WideBB wide = {WideSplat(FloatDown(bb.l)), WideSplat(FloatDown(bb.b)), WideSplat(FloatUp(bb.r)), WideSplat(FloatUp(bb.t))};
+	return wide;
+}
+
+// Returns a bitmask of the children whose bounds overlap 'bb'.
+static inline int
+WideOverlaps(const WideNode *node, const WideBB *bb)
+{
+	WideMask4 x = WideAnd(WideLE(WideLoad(node->l), bb->r), WideLE(bb->l, WideLoad(node->r)));
+	WideMask4 y = WideAnd(WideLE(WideLoad(node->b), bb->t), WideLE(bb->b, WideLoad(node->t)));
+	return WideBits(WideAnd(x, y)) & ((1 << node->count) - 1);
+}
+
+typedef struct WideSegment {
+	// Start of the segment offset by the padding for each side of the bounds.
+	Wide4 originL, originB, originR, originT;
+	Wide4 invX, invY;
+	
+	cpVect a, b;
+} WideSegment;
+
+static inline float
+WideInverse(cpFloat d)
+{
+	// Keep the inverse finite so that a zero slab distance never multiplies to NaN.
+	return (cpfabs(d) > 1e-30f ? (float)(1.0f/d) : 1e30f);
+}
+
+static WideSegment
+WideSegmentNew(cpVect a, cpVect b)
+{
+	cpVect delta = cpvsub(b, a);
+	cpFloat pad = (cpfmax(cpfabs(a.x), cpfabs(a.y)) + cpfmax(cpfabs(delta.x), cpfabs(delta.y)))*WIDE_SEGMENT_PADDING;
+	
+	WideSegment segment = {
+		WideSplat((float)(a.x + pad)), WideSplat((float)(a.y + pad)),
+		WideSplat((float)(a.x - pad)), WideSplat((float)(a.y - pad)),
+		WideSplat(WideInverse(delta.x)), WideSplat(WideInverse(delta.y)),
+		a, b,
+	};
+	return segment;
+}
+
+// Returns a bitmask of the children the segment hits before 't_exit' and stores where it enters them.
+static inline int
+WideSegmentHits(const WideNode *node, const WideSegment *segment, cpFloat t_exit, float *t_enter)
+{
+	Wide4 tx1 = WideMul(WideSub(WideLoad(node->l), segment->originL), segment->invX);
+	Wide4 tx2 = WideMul(WideSub(WideLoad(node->r), segment->originR), segment->invX);
+	Wide4 ty1 = WideMul(WideSub(WideLoad(node->b), segment->originB), segment->invY);
+	Wide4 ty2 = WideMul(WideSub(WideLoad(node->t), segment->originT), segment->invY);
+	
+	Wide4 tmin = WideMax(WideMax(WideMin(tx1, tx2), WideMin(ty1, ty2)), WideSplat(0.0f));
+	Wide4 tmax = WideMin(WideMax(tx1, tx2), WideMax(ty1, ty2));
+	tmax = WideMin(WideMul(tmax, WideSplat(WIDE_SEGMENT_SLACK)), WideSplat(FloatUp(cpfmin(t_exit, 1.0f))));
+	
+	WideStore(t_enter, tmin);
+	return WideBits(WideLE(tmin, tmax)) & ((1 << node->count) - 1);
+}
+
+// Collapse 'subtree' (an internal node) into a wide node and return its index.
+static int
+WideBuild(cpBBTree *tree, int subtree)
+{
+	Node *nodes = tree->nodes;
+	int index = tree->wideCount++;
+	
+	int children[4] = {nodes[subtree].a, nodes[subtree].b};
+	int count = 2;
+	
+	// Pull up the children of the largest internal child until all four slots are used.
+	while(count < 4){
+		int best = -1;
+		cpFloat bestArea = -1.0f;
+		
+		for(int i=0; i<count; i++){
+			Node *node = nodes + children[i];
+			if(!NodeIsLeaf(node) && cpBBArea(node->bb) > bestArea){
+				best = i;
+				bestArea = cpBBArea(node->bb);
+			}
+		}
+		
+		if(best == -1) break;
+		
+		Node *node = nodes + children[best];
+		children[best] = node->a;
+		children[count++] = node->b;
+	}
+	
+	WideNode *wide = tree->wideNodes + index;
+	wide->count = count;
+	
+	for(int i=0; i<4; i++){
+		if(i < count){
+			cpBB bb = nodes[children[i]].bb;
+			wide->l[i] = FloatDown(bb.l);
+			wide->b[i] = FloatDown(bb.b);
+			wide->r[i] = FloatUp(bb.r);
+			wide->t[i] = FloatUp(bb.t);
+		} else {
+			// Unused slots are masked out by the child count.
+			wide->l[i] = wide->b[i] = FLT_MAX;
+			wide->r[i] = wide->t[i] = -FLT_MAX;
+			wide->child[i] = 0;
+		}
+	}
+	
+	for(int i=0; i<count; i++){
+		int child = children[i];
+		tree->wideNodes[index].child[i] = (NodeIsLeaf(nodes + child) ? ~child : WideBuild(tree, child));
+	}
+	
+	return index;
+}
+
+// Returns true if the wide nodes can be used, rebuilding them first if the tree has changed.
+// The root wide node is always at index 0.
+static inline cpBool
+WideReady(cpBBTree *tree)
+{
+	int root = tree->root;
+	if(!tree->wideEnabled || root == NULL_NODE || NodeIsLeaf(tree->nodes + root)) return cpFalse;
+	
+	if(tree->wideDirty){
+		// Every wide node replaces at least one of the (leaves - 1) internal nodes.
+		int count = cpHashSetCount(tree->leaves);
+		if(tree->wideCapacity < count){
+			tree->wideCapacity = (count > 2*tree->wideCapacity ? count : 2*tree->wideCapacity);
+			tree->wideNodes = (WideNode *)cprealloc(tree->wideNodes, tree->wideCapacity*sizeof(WideNode));
+		}
+		
+		tree->wideCount = 0;
+		WideBuild(tree, root);
+		tree->wideDirty = cpFalse;
+	}
+	
+	return cpTrue;
+}
+
+static void
+WideQuery(cpBBTree *tree, int index, void *obj, cpBB bb, const WideBB *wideBB, cpSpatialIndexQueryFunc func, void *data)
+{
+	int hits = WideOverlaps(tree->wideNodes + index, wideBB);
+	
+	for(int i=0; hits; i++, hits >>= 1){
+		if(hits & 1){
+			int child = tree->wideNodes[index].child[i];
+			if(child < 0){
+				int node = ~child;
+				if(cpBBIntersects(tree->nodes[node].bb, bb)) func(obj, tree->links[node].leaf->obj, 0, data);
+			} else {
+				WideQuery(tree, child, obj, bb, wideBB, func, data);
+			}
+		}
+	}
+}
+
+static cpFloat
+WideSegmentQuery(cpBBTree *tree, int index, void *obj, const WideSegment *segment, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	float t_enter[4];
+	int hits = WideSegmentHits(tree->wideNodes + index, segment, t_exit, t_enter);
+	
+	// Visit the children in the order the segment enters them.
+	int order[4], count = 0;
+	for(int i=0; i<4; i++){
+		if(hits & (1<<i)){
+			int j = count++;
+			for(; j > 0 && t_enter[order[j - 1]] > t_enter[i]; j--) order[j] = order[j - 1];
+			order[j] = i;
+		}
+	}
+	
+	for(int k=0; k<count; k++){
+		int i = order[k];
+		if(t_enter[i] >= t_exit) break;
+		
+		int child = tree->wideNodes[index].child[i];
+		if(child < 0){
+			int node = ~child;
+			if(cpBBSegmentQuery(tree->nodes[node].bb, segment->a, segment->b) < t_exit){
+				t_exit = cpfmin(t_exit, func(obj, tree->links[node].leaf->obj, data));
+			}
+		} else {
+			t_exit = cpfmin(t_exit, WideSegmentQuery(tree, child, obj, segment, t_exit, func, data));
+		}
+	}
+	
+	return t_exit;
+}
+
 //MARK: Marking Functions
 
 typedef struct MarkContext {
 	cpBBTree *tree;
-	Node *staticRoot;
+	cpBBTree *staticTree;
 	cpSpatialIndexQueryFunc func;
 	void *data;
+	// Only insert the pairs. They are reported when the pair table is swept.
+	cpBool pairTable;
 } MarkContext;
 
+static inline void
+MarkLeafPair(Leaf *leaf, Leaf *other, cpBool left, MarkContext *context)
+{
+	if(left || context->pairTable){
+		PairInsert(leaf, other, context->tree);
+	} else {
+		if(other->stamp < leaf->stamp) PairInsert(other, leaf, context->tree);
+		context->func(leaf->obj, other->obj, 0, context->data);
+	}
+}
+
+// Find the leaves of 'subtree' (a node of 'tree') that overlap 'leaf', which may belong to a different tree.
+static void
+MarkLeafQuery(cpBBTree *tree, int subtree, Leaf *leaf, cpBB bb, cpBool left, MarkContext *context)
+{
+	Node *node = tree->nodes + subtree;
+	if(cpBBIntersects(bb, node->bb)){
+		if(NodeIsLeaf(node)){
+			MarkLeafPair(leaf, tree->links[subtree].leaf, left, context);
+		} else {
+			int b = node->b;
+			MarkLeafQuery(tree, node->a, leaf, bb, left, context);
+			MarkLeafQuery(tree, b, leaf, bb, left, context);
+		}
+	}
+}
+
+// Same as MarkLeafQuery() for a static tree using its wide nodes.
 static void
-MarkLeafQuery(Node *subtree, Node *leaf, cpBool left, MarkContext *context)
+WideMarkLeafQuery(cpBBTree *tree, int index, Leaf *leaf, cpBB bb, const WideBB *wideBB, MarkContext *context)
 {
-	if(cpBBIntersects(leaf->bb, subtree->bb)){
-		if(NodeIsLeaf(subtree)){
-			if(left){
-				PairInsert(leaf, subtree, context->tree);
+	int hits = WideOverlaps(tree->wideNodes + index, wideBB);
+	
+	for(int i=0; hits; i++, hits >>= 1){
+		if(hits & 1){
+			int child = tree->wideNodes[index].child[i];
+			if(child < 0){
+				int node = ~child;
+				if(cpBBIntersects(bb, tree->nodes[node].bb)) MarkLeafPair(leaf, tree->links[node].leaf, cpFalse, context);
 			} else {
-				if(subtree->STAMP < leaf->STAMP) PairInsert(subtree, leaf, context->tree);
-				context->func(leaf->obj, subtree->obj, 0, context->data);
+				WideMarkLeafQuery(tree, child, leaf, bb, wideBB, context);
 			}
+		}
+	}
+}
+
+static void
+MarkLeafStatic(Leaf *leaf, cpBB bb, MarkContext *context)
+{
+	cpBBTree *staticTree = context->staticTree;
+	if(staticTree){
+		if(WideReady(staticTree)){
+			WideBB wideBB = WideBBNew(bb);
+			WideMarkLeafQuery(staticTree, 0, leaf, bb, &wideBB, context);
 		} else {
-			MarkLeafQuery(subtree->A, leaf, left, context);
-			MarkLeafQuery(subtree->B, leaf, left, context);
+			MarkLeafQuery(staticTree, staticTree->root, leaf, bb, cpFalse, context);
 		}
 	}
 }
 
 static void
-MarkLeaf(Node *leaf, MarkContext *context)
+MarkLeaf(Leaf *leaf, MarkContext *context)
 {
 	cpBBTree *tree = context->tree;
-	if(leaf->STAMP == GetMasterTree(tree)->stamp){
-		Node *staticRoot = context->staticRoot;
-		if(staticRoot) MarkLeafQuery(staticRoot, leaf, cpFalse, context);
+	if(leaf->stamp == GetMasterTree(tree)->stamp){
+		cpBB bb = tree->nodes[leaf->node].bb;
+		MarkLeafStatic(leaf, bb, context);
 		
-		for(Node *node = leaf; node->parent; node = node->parent){
-			if(node == node->parent->A){
-				MarkLeafQuery(node->parent->B, leaf, cpTrue, context);
+		for(int node = leaf->node, parent; (parent = tree->links[node].parent) != NULL_NODE; node = parent){
+			if(node == tree->nodes[parent].a){
+				MarkLeafQuery(tree, tree->nodes[parent].b, leaf, bb, cpTrue, context);
 			} else {
-				MarkLeafQuery(node->parent->A, leaf, cpFalse, context);
+				MarkLeafQuery(tree, tree->nodes[parent].a, leaf, bb, cpFalse, context);
 			}
 		}
-	} else {
-		Pair *pair = leaf->PAIRS;
+	} else if(!context->pairTable){
+		Pair *pair = leaf->pairs;
 		while(pair){
 			if(leaf == pair->b.leaf){
 				pair->id = context->func(pair->a.leaf->obj, leaf->obj, pair->id, context->data);
@@ -469,46 +936,124 @@ MarkLeaf(Node *leaf, MarkContext *context)
 }
 
 static void
-MarkSubtree(Node *subtree, MarkContext *context)
+MarkSubtree(int subtree, MarkContext *context)
 {
-	if(NodeIsLeaf(subtree)){
-		MarkLeaf(subtree, context);
+	cpBBTree *tree = context->tree;
+	Node *node = tree->nodes + subtree;
+	
+	if(NodeIsLeaf(node)){
+		MarkLeaf(tree->links[subtree].leaf, context);
 	} else {
-		MarkSubtree(subtree->A, context);
-		MarkSubtree(subtree->B, context); // TODO: Force TCO here?
+		int b = node->b;
+		MarkSubtree(node->a, context);
+		MarkSubtree(b, context); // TODO: Force TCO here?
+	}
+}
+
+// Find the overlapping leaves of two subtrees where at least one of the leaves has the given stamp.
+static void
+MarkSubtreePairs(cpBBTree *tree, int a, int b, cpTimestamp stamp)
+{
+	Node *nodeA = tree->nodes + a, *nodeB = tree->nodes + b;
+	if(!cpBBIntersects(nodeA->bb, nodeB->bb)) return;
+	
+	cpBool leafA = NodeIsLeaf(nodeA), leafB = NodeIsLeaf(nodeB);
+	if(leafA && leafB){
+		Leaf *leaf = tree->links[a].leaf, *other = tree->links[b].leaf;
+		if(leaf->stamp == stamp || other->stamp == stamp) PairInsert(leaf, other, tree);
+	} else if(leafB || (!leafA && cpBBArea(nodeA->bb) > cpBBArea(nodeB->bb))){
+		// Descend into the larger subtree.
+		int childB = nodeA->b;
+		MarkSubtreePairs(tree, nodeA->a, b, stamp);
+		MarkSubtreePairs(tree, childB, b, stamp);
+	} else {
+		int childB = nodeB->b;
+		MarkSubtreePairs(tree, a, nodeB->a, stamp);
+		MarkSubtreePairs(tree, a, childB, stamp);
+	}
+}
+
+// Find all of the overlapping leaves within a subtree by colliding the children of each node with each other.
+static void
+MarkSelfPairs(cpBBTree *tree, int subtree, cpTimestamp stamp)
+{
+	Node *node = tree->nodes + subtree;
+	if(!NodeIsLeaf(node)){
+		int a = node->a, b = node->b;
+		MarkSelfPairs(tree, a, stamp);
+		MarkSelfPairs(tree, b, stamp);
+		MarkSubtreePairs(tree, a, b, stamp);
 	}
 }
 
 //MARK: Leaf Functions
 
-static Node *
+static void
+LeafRecycle(cpBBTree *tree, Leaf *leaf)
+{
+	// Pooled leaves are linked through their obj pointers.
+	leaf->obj = tree->pooledLeaves;
+	tree->pooledLeaves = leaf;
+}
+
+static Leaf *
+LeafFromPool(cpBBTree *tree)
+{
+	Leaf *leaf = tree->pooledLeaves;
+	
+	if(leaf){
+		tree->pooledLeaves = (Leaf *)leaf->obj;
+		return leaf;
+	} else {
+		// Pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(Leaf);
+		cpAssertHard(count, "Internal Error: Buffer size is too small.");
+		
+		Leaf *buffer = (Leaf *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpArrayPush(tree->allocatedBuffers, buffer);
+		
+		// push all but the first one, return the first instead
+		for(int i=1; i<count; i++) LeafRecycle(tree, buffer + i);
+		return buffer;
+	}
+}
+
+static Leaf *
 LeafNew(cpBBTree *tree, void *obj, cpBB bb)
 {
-	Node *node = NodeFromPool(tree);
-	node->obj = obj;
-	node->bb = GetBB(tree, obj);
+	Leaf *leaf = LeafFromPool(tree);
+	int node = NodeFromPool(tree);
 	
-	node->parent = NULL;
-	node->STAMP = 0;
-	node->PAIRS = NULL;
+	leaf->obj = obj;
+	leaf->tree = tree;
+	leaf->node = node;
+	leaf->stamp = 0;
+	leaf->pairs = NULL;
 	
-	return node;
+	tree->nodes[node].bb = GetBB(tree, obj);
+	tree->nodes[node].a = tree->nodes[node].b = NULL_NODE;
+	tree->links[node].parent = NULL_NODE;
+	tree->links[node].leaf = leaf;
+	
+	return leaf;
 }
 
 static cpBool
-LeafUpdate(Node *leaf, cpBBTree *tree)
+LeafUpdate(Leaf *leaf, cpBBTree *tree)
 {
-	Node *root = tree->root;
+	int root = tree->root;
+	int node = leaf->node;
 	cpBB bb = tree->spatialIndex.bbfunc(leaf->obj);
 	
-	if(!cpBBContainsBB(leaf->bb, bb)){
-		leaf->bb = GetBB(tree, leaf->obj);
+	if(!cpBBContainsBB(tree->nodes[node].bb, bb)){
+		tree->nodes[node].bb = GetBB(tree, leaf->obj);
 		
-		root = SubtreeRemove(root, leaf, tree);
-		tree->root = SubtreeInsert(root, leaf, tree);
+		root = SubtreeRemove(tree, root, node);
+		tree->root = SubtreeInsert(tree, root, node);
+		tree->wideDirty = cpTrue;
 		
 		PairsClear(leaf, tree);
-		leaf->STAMP = GetMasterTree(tree)->stamp;
+		leaf->stamp = GetMasterTree(tree)->stamp;
 		
 		return cpTrue;
 	} else {
@@ -519,19 +1064,18 @@ LeafUpdate(Node *leaf, cpBBTree *tree)
 static cpCollisionID VoidQueryFunc(void *obj1, void *obj2, cpCollisionID id, void *data){return id;}
 
 static void
-LeafAddPairs(Node *leaf, cpBBTree *tree)
+LeafAddPairs(Leaf *leaf, cpBBTree *tree)
 {
 	cpSpatialIndex *dynamicIndex = tree->spatialIndex.dynamicIndex;
 	if(dynamicIndex){
-		Node *dynamicRoot = GetRootIfTree(dynamicIndex);
-		if(dynamicRoot){
-			cpBBTree *dynamicTree = GetTree(dynamicIndex);
-			MarkContext context = {dynamicTree, NULL, NULL, NULL};
-			MarkLeafQuery(dynamicRoot, leaf, cpTrue, &context);
+		cpBBTree *dynamicTree = GetTreeIfRoot(dynamicIndex);
+		if(dynamicTree){
+			MarkContext context = {dynamicTree, NULL, NULL, NULL, dynamicTree->pairTable};
+			MarkLeafQuery(dynamicTree, dynamicTree->root, leaf, tree->nodes[leaf->node].bb, cpTrue, &context);
 		}
 	} else {
-		Node *staticRoot = GetRootIfTree(tree->spatialIndex.staticIndex);
-		MarkContext context = {tree, staticRoot, VoidQueryFunc, NULL};
+		cpBBTree *staticTree = GetTreeIfRoot(tree->spatialIndex.staticIndex);
+		MarkContext context = {tree, staticTree, VoidQueryFunc, NULL, tree->pairTable};
 		MarkLeaf(leaf, &context);
 	}
 }
@@ -545,9 +1089,9 @@ cpBBTreeAlloc(void)
 }
 
 static int
-leafSetEql(void *obj, Node *node)
+leafSetEql(void *obj, Leaf *leaf)
 {
-	return (obj == node->obj);
+	return (obj == leaf->obj);
 }
 
 static void *
@@ -564,12 +1108,29 @@ cpBBTreeInit(cpBBTree *tree, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *static
 	tree->velocityFunc = NULL;
 	
 	tree->leaves = cpHashSetNew(0, (cpHashSetEqlFunc)leafSetEql);
-	tree->root = NULL;
+	tree->root = NULL_NODE;
+	
+	tree->nodes = NULL;
+	tree->links = NULL;
+	tree->nodeCount = tree->nodeCapacity = 0;
+	tree->pooledNodes = NULL_NODE;
 	
-	tree->pooledNodes = NULL;
+	tree->pooledLeaves = NULL;
+	tree->pooledPairs = NULL;
 	tree->allocatedBuffers = cpArrayNew(0);
 	
 	tree->stamp = 0;
+	tree->version = 0;
+	
+	tree->pairTable = cpFalse;
+	cpPairTableInit(&tree->tablePairs);
+	tree->deadLeaves = cpArrayNew(0);
+	tree->sweepStamp = 0;
+	
+	tree->wideEnabled = cpFalse;
+	tree->wideDirty = cpTrue;
+	tree->wideNodes = NULL;
+	tree->wideCount = tree->wideCapacity = 0;
 	
 	return (cpSpatialIndex *)tree;
 }
@@ -585,6 +1146,32 @@ cpBBTreeSetVelocityFunc(cpSpatialIndex *index, cpBBTreeVelocityFunc func)
 	((cpBBTree *)index)->velocityFunc = func;
 }
 
+void
+cpBBTreeSetPairTable(cpSpatialIndex *index, cpBool enabled)
+{
+	cpBBTree *tree = GetTree(index);
+	if(!tree || tree->spatialIndex.dynamicIndex){
+		cpAssertWarn(cpFalse, "Ignoring cpBBTreeSetPairTable() call to a non-tree or static spatial index.");
+		return;
+	}
+	
+	cpAssertHard(cpHashSetCount(tree->leaves) == 0, "The pair table can only be enabled or disabled while the tree is empty.");
+	tree->pairTable = enabled;
+}
+
+void
+cpBBTreeSetWideNodes(cpSpatialIndex *index, cpBool enabled)
+{
+	cpBBTree *tree = GetTree(index);
+	if(!tree){
+		cpAssertWarn(cpFalse, "Ignoring cpBBTreeSetWideNodes() call to non-tree spatial index.");
+		return;
+	}
+	
+	tree->wideEnabled = enabled;
+	tree->wideDirty = cpTrue;
+}
+
 cpSpatialIndex *
 cpBBTreeNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
 {
@@ -598,6 +1185,14 @@ cpBBTreeDestroy(cpBBTree *tree)
 	
 	if(tree->allocatedBuffers) cpArrayFreeEach(tree->allocatedBuffers, cpfree);
 	cpArrayFree(tree->allocatedBuffers);
+	
+	cpfree(tree->nodes);
+	cpfree(tree->links);
+	
+	cpPairTableDestroy(&tree->tablePairs);
+	cpArrayFree(tree->deadLeaves);
+	
+	cpfree(tree->wideNodes);
 }
 
 //MARK: Insert/Remove
@@ -605,24 +1200,79 @@ cpBBTreeDestroy(cpBBTree *tree)
 static void
 cpBBTreeInsert(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
-	Node *leaf = (Node *)cpHashSetInsert(tree->leaves, hashid, obj, (cpHashSetTransFunc)leafSetTrans, tree);
+	Leaf *leaf = (Leaf *)cpHashSetInsert(tree->leaves, hashid, obj, (cpHashSetTransFunc)leafSetTrans, tree);
 	
-	Node *root = tree->root;
-	tree->root = SubtreeInsert(root, leaf, tree);
+	int root = tree->root;
+	tree->root = SubtreeInsert(tree, root, leaf->node);
 	
-	leaf->STAMP = GetMasterTree(tree)->stamp;
+	leaf->stamp = GetMasterTree(tree)->stamp;
 	LeafAddPairs(leaf, tree);
 	IncrementStamp(tree);
+	tree->version++;
+	tree->wideDirty = cpTrue;
+}
+
+// Batches smaller than this are inserted one at a time.
+#define BATCH_REBUILD_MIN 16
+
+static void
+cpBBTreeInsertBatch(cpBBTree *tree, void **objs, cpHashValue *hashids, int count)
+{
+	// Rebuilding the whole tree only pays off when the batch is at least as large as the tree.
+	if(count < BATCH_REBUILD_MIN || count < cpHashSetCount(tree->leaves)){
+		for(int i=0; i<count; i++) cpBBTreeInsert(tree, objs[i], hashids[i]);
+		return;
+	}
+	
+	Leaf **leaves = (Leaf **)cpcalloc(count, sizeof(Leaf *));
+	for(int i=0; i<count; i++){
+		leaves[i] = (Leaf *)cpHashSetInsert(tree->leaves, hashids[i], objs[i], (cpHashSetTransFunc)leafSetTrans, tree);
+	}
+	
+	// Build the tree top down from all of the leaves instead of inserting the new ones one at a time.
+	cpSpatialIndex *index = (cpSpatialIndex *)tree;
+	cpBBTreeRebuild *rebuild = cpBBTreeRebuildNew(index);
+	cpBBTreeRebuildRun(rebuild);
+	cpBBTreeRebuildFinish(index, rebuild);
+	
+	cpTimestamp stamp = GetMasterTree(tree)->stamp;
+	for(int i=0; i<count; i++) leaves[i]->stamp = stamp;
+	
+	if(tree->spatialIndex.dynamicIndex){
+		for(int i=0; i<count; i++) LeafAddPairs(leaves[i], tree);
+	} else {
+		// Collide the whole tree with itself once instead of querying it for each new leaf.
+		MarkSelfPairs(tree, tree->root, stamp);
+		
+		MarkContext context = {tree, GetTreeIfRoot(tree->spatialIndex.staticIndex), VoidQueryFunc, NULL, tree->pairTable};
+		for(int i=0; i<count; i++) MarkLeafStatic(leaves[i], tree->nodes[leaves[i]->node].bb, &context);
+	}
+	
+	IncrementStamp(tree);
+	tree->version++;
+	
+	cpfree(leaves);
 }
 
 static void
 cpBBTreeRemove(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
-	Node *leaf = (Node *)cpHashSetRemove(tree->leaves, hashid, obj);
+	Leaf *leaf = (Leaf *)cpHashSetRemove(tree->leaves, hashid, obj);
 	
-	tree->root = SubtreeRemove(tree->root, leaf, tree);
+	tree->root = SubtreeRemove(tree, tree->root, leaf->node);
 	PairsClear(leaf, tree);
-	NodeRecycle(tree, leaf);
+	NodeRecycle(tree, leaf->node);
+	tree->version++;
+	tree->wideDirty = cpTrue;
+	
+	cpBBTree *master = GetMasterTree(tree);
+	if(master->pairTable && master->tablePairs.count > 0){
+		// Table pairs may still reference the leaf until they are swept.
+		leaf->node = NULL_NODE;
+		cpArrayPush(master->deadLeaves, leaf);
+	} else {
+		LeafRecycle(tree, leaf);
+	}
 }
 
 static cpBool
@@ -633,24 +1283,39 @@ cpBBTreeContains(cpBBTree *tree, void *obj, cpHashValue hashid)
 
 //MARK: Reindex
 
-static void LeafUpdateWrap(Node *leaf, cpBBTree *tree) {LeafUpdate(leaf, tree);}
+static void LeafUpdateWrap(Leaf *leaf, cpBBTree *tree) {LeafUpdate(leaf, tree);}
+static void LeafUpdateAddPairs(Leaf *leaf, cpBBTree *tree) {if(LeafUpdate(leaf, tree)) LeafAddPairs(leaf, tree);}
 
 static void
 cpBBTreeReindexQuery(cpBBTree *tree, cpSpatialIndexQueryFunc func, void *data)
 {
-	if(!tree->root) return;
+	cpBBTree *master = GetMasterTree(tree);
+	if(master->pairTable && master != tree){
+		// Only pairs with the dynamic tree are tracked, so moved static leaves just need to find their new pairs.
+		cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)LeafUpdateAddPairs, tree);
+		IncrementStamp(tree);
+		return;
+	}
+	
+	if(tree->root == NULL_NODE){
+		// Drop any pairs left over from removed leaves.
+		if(tree->pairTable) PairTableSweep(tree, func, data);
+		return;
+	}
 	
 	// LeafUpdate() may modify tree->root. Don't cache it.
 	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)LeafUpdateWrap, tree);
 	
 	cpSpatialIndex *staticIndex = tree->spatialIndex.staticIndex;
-	Node *staticRoot = (staticIndex && staticIndex->klass == Klass() ? ((cpBBTree *)staticIndex)->root : NULL);
+	cpBBTree *staticTree = GetTreeIfRoot(staticIndex);
 	
-	MarkContext context = {tree, staticRoot, func, data};
+	MarkContext context = {tree, staticTree, func, data, tree->pairTable};
 	MarkSubtree(tree->root, &context);
-	if(staticIndex && !staticRoot) cpSpatialIndexCollideStatic((cpSpatialIndex *)tree, staticIndex, func, data);
+	if(tree->pairTable) PairTableSweep(tree, func, data);
+	if(staticIndex && !staticTree) cpSpatialIndexCollideStatic((cpSpatialIndex *)tree, staticIndex, func, data);
 	
 	IncrementStamp(tree);
+	tree->sweepStamp = tree->stamp;
 }
 
 static void
@@ -662,7 +1327,7 @@ cpBBTreeReindex(cpBBTree *tree)
 static void
 cpBBTreeReindexObject(cpBBTree *tree, void *obj, cpHashValue hashid)
 {
-	Node *leaf = (Node *)cpHashSetFind(tree->leaves, hashid, obj);
+	Leaf *leaf = (Leaf *)cpHashSetFind(tree->leaves, hashid, obj);
 	if(leaf){
 		if(LeafUpdate(leaf, tree)) LeafAddPairs(leaf, tree);
 		IncrementStamp(tree);
@@ -674,14 +1339,24 @@ cpBBTreeReindexObject(cpBBTree *tree, void *obj, cpHashValue hashid)
 static void
 cpBBTreeSegmentQuery(cpBBTree *tree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
 {
-	Node *root = tree->root;
-	if(root) SubtreeSegmentQuery(root, obj, a, b, t_exit, func, data);
+	if(WideReady(tree)){
+		WideSegment segment = WideSegmentNew(a, b);
+		WideSegmentQuery(tree, 0, obj, &segment, t_exit, func, data);
+	} else {
+		int root = tree->root;
+		if(root != NULL_NODE) SubtreeSegmentQuery(tree, root, obj, a, b, t_exit, func, data);
+	}
 }
 
 static void
 cpBBTreeQuery(cpBBTree *tree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
 {
-	if(tree->root) SubtreeQuery(tree->root, obj, bb, func, data);
+	if(WideReady(tree)){
+		WideBB wideBB = WideBBNew(bb);
+		WideQuery(tree, 0, obj, bb, &wideBB, func, data);
+	} else {
+		if(tree->root != NULL_NODE) SubtreeQuery(tree, tree->root, obj, bb, func, data);
+	}
 }
 
 //MARK: Misc
@@ -697,7 +1372,7 @@ typedef struct eachContext {
 	void *data;
 } eachContext;
 
-static void each_helper(Node *node, eachContext *context){context->func(node->obj, context->data);}
+static void each_helper(Leaf *leaf, eachContext *context){context->func(leaf->obj, context->data);}
 
 static void
 cpBBTreeEach(cpBBTree *tree, cpSpatialIndexIteratorFunc func, void *data)
@@ -722,6 +1397,8 @@ static cpSpatialIndexClass klass = {
 	
 	(cpSpatialIndexQueryImpl)cpBBTreeQuery,
 	(cpSpatialIndexSegmentQueryImpl)cpBBTreeSegmentQuery,
+	
+	(cpSpatialIndexInsertBatchImpl)cpBBTreeInsertBatch,
 };
 
 static inline cpSpatialIndexClass *Klass(){return &klass;}
@@ -729,80 +1406,305 @@ static inline cpSpatialIndexClass *Klass(){return &klass;}
 
 //MARK: Tree Optimization
 
+struct cpBBTreeRebuild {
+	unsigned int version;
+	
+	// Snapshot of the leaves and their bounds.
+	int count;
+	Leaf **leaves;
+	cpBB *bbs;
+	
+	// The rebuilt tree. The leaves come first followed by the internal nodes in post order.
+	Node *nodes;
+	NodeLink *links;
+	int nodeCount;
+	int root;
+};
+
+// Number of candidate split planes per axis evaluated by the SAH builder.
+#define SAH_BINS 16
+
+// Half the perimeter is the 2D equivalent of the surface area.
+static inline cpFloat
+BBCost(cpBB bb)
+{
+	return (bb.r - bb.l) + (bb.t - bb.b);
+}
+
+// Leaves are copied into an array that is partitioned in place so that each level is built from sequential memory.
+typedef struct RebuildItem {
+	cpBB bb;
+	cpVect center;
+	int node;
+} RebuildItem;
+
+static inline int
+BinIndex(cpFloat center, cpFloat min, cpFloat scale)
+{
+	int bin = (int)((center - min)*scale);
+	return (bin < SAH_BINS ? bin : SAH_BINS - 1);
+}
+
+static int RebuildSubtree(cpBBTreeRebuild *rebuild, RebuildItem *items, int count);
+
 static int
-cpfcompare(const cpFloat *a, const cpFloat *b){
-	return (*a < *b ? -1 : (*b < *a ? 1 : 0));
+RebuildNode(cpBBTreeRebuild *rebuild, int a, int b)
+{
+	Node *nodes = rebuild->nodes;
+	int node = rebuild->nodeCount++;
+	nodes[node].bb = cpBBMerge(nodes[a].bb, nodes[b].bb);
+	nodes[node].a = a;
+	nodes[node].b = b;
+	rebuild->links[node].parent = NULL_NODE;
+	rebuild->links[node].leaf = NULL;
+	rebuild->links[a].parent = rebuild->links[b].parent = node;
+	
+	return node;
 }
 
-static void
-fillNodeArray(Node *node, Node ***cursor){
-	(**cursor) = node;
-	(*cursor)++;
+// Subtrees with this many leaves or fewer are split without binning.
+#define SMALL_SUBTREE 6
+
+static int
+RebuildSmallSubtree(cpBBTreeRebuild *rebuild, RebuildItem *items, int count, cpBB centers)
+{
+	if(count == 2) return RebuildNode(rebuild, items[0].node, items[1].node);
+	
+	cpBool xAxis = (centers.r - centers.l >= centers.t - centers.b);
+	cpFloat split = (xAxis ? centers.l + centers.r : centers.b + centers.t)*0.5f;
+	
+	int right = count;
+	for(int left=0; left < right;){
+		if((xAxis ? items[left].center.x : items[left].center.y) > split){
+			right--;
+			RebuildItem temp = items[left];
+			items[left] = items[right];
+			items[right] = temp;
+		} else {
+			left++;
+		}
+	}
+	
+	// All of the centers are the same.
+	if(right == 0 || right == count) right = count/2;
+	
+	int a = RebuildSubtree(rebuild, items, right);
+	int b = RebuildSubtree(rebuild, items + right, count - right);
+	return RebuildNode(rebuild, a, b);
 }
 
-static Node *
-partitionNodes(cpBBTree *tree, Node **nodes, int count)
+static int
+RebuildSubtree(cpBBTreeRebuild *rebuild, RebuildItem *items, int count)
 {
-	if(count == 1){
-		return nodes[0];
-	} else if(count == 2) {
-		return NodeNew(tree, nodes[0], nodes[1]);
+	if(count == 1) return items[0].node;
+	
+	// Find the range of the leaf centers.
+	cpBB centers = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+	for(int i=0; i<count; i++) centers = cpBBExpand(centers, items[i].center);
+	
+	// Binning has a fixed cost that dominates for the many tiny subtrees near the leaves.
+	// Split those at the middle of the longest axis instead.
+	if(count <= SMALL_SUBTREE) return RebuildSmallSubtree(rebuild, items, count, centers);
+	
+	cpFloat min[2] = {centers.l, centers.b};
+	cpFloat scale[2] = {
+		(centers.r > centers.l ? SAH_BINS/(centers.r - centers.l) : 0.0f),
+		(centers.t > centers.b ? SAH_BINS/(centers.t - centers.b) : 0.0f),
+	};
+	
+	// Bin the leaves along both axes in a single pass.
+	cpBB binBB[2][SAH_BINS];
+	int binCount[2][SAH_BINS] = {{0}};
+	for(int i=0; i<SAH_BINS; i++){
+		binBB[0][i] = binBB[1][i] = cpBBNew(INFINITY, INFINITY, -INFINITY, -INFINITY);
 	}
 	
-	// Find the AABB for these nodes
-	cpBB bb = nodes[0]->bb;
-	for(int i=1; i<count; i++) bb = cpBBMerge(bb, nodes[i]->bb);
+	for(int i=0; i<count; i++){
+		cpBB bb = items[i].bb;
+		int x = BinIndex(items[i].center.x, min[0], scale[0]);
+		int y = BinIndex(items[i].center.y, min[1], scale[1]);
+		
+		binBB[0][x] = cpBBMerge(binBB[0][x], bb);
+		binCount[0][x]++;
+		binBB[1][y] = cpBBMerge(binBB[1][y], bb);
+		binCount[1][y]++;
+	}
 	
-	// Split it on it's longest axis
-	cpBool splitWidth = (bb.r - bb.l > bb.t - bb.b);
+	int bestAxis = -1, bestSplit = 0;
+	cpFloat bestCost = INFINITY;
 	
-	// Sort the bounds and use the median as the splitting point
-	cpFloat *bounds = (cpFloat *)cpcalloc(count*2, sizeof(cpFloat));
-	if(splitWidth){
-		for(int i=0; i<count; i++){
-			bounds[2*i + 0] = nodes[i]->bb.l;
-			bounds[2*i + 1] = nodes[i]->bb.r;
+	for(int axis=0; axis<2; axis++){
+		if(scale[axis] == 0.0f) continue;
+		
+		// Sweep from the right to find the cost of everything to the right of each split.
+		cpFloat rightCost[SAH_BINS];
+		cpBB bb = {0.0f, 0.0f, 0.0f, 0.0f};
+		for(int i=SAH_BINS - 1, n=0; i>0; i--){
+			if(binCount[axis][i]){
+				bb = (n ? cpBBMerge(bb, binBB[axis][i]) : binBB[axis][i]);
+				n += binCount[axis][i];
+			}
+			
+			rightCost[i] = BBCost(bb)*n;
 		}
-	} else {
-		for(int i=0; i<count; i++){
-			bounds[2*i + 0] = nodes[i]->bb.b;
-			bounds[2*i + 1] = nodes[i]->bb.t;
+		
+		// Then sweep from the left and combine them.
+		for(int i=0, n=0; i<SAH_BINS - 1; i++){
+			if(binCount[axis][i]){
+				bb = (n ? cpBBMerge(bb, binBB[axis][i]) : binBB[axis][i]);
+				n += binCount[axis][i];
+			}
+			
+			cpFloat cost = BBCost(bb)*n + rightCost[i + 1];
+			if(n > 0 && n < count && cost < bestCost){
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i + 1;
+			}
 		}
 	}
 	
-	qsort(bounds, count*2, sizeof(cpFloat), (int (*)(const void *, const void *))cpfcompare);
-	cpFloat split = (bounds[count - 1] + bounds[count])*0.5f; // use the medain as the split
-	cpfree(bounds);
+	// Partition the leaves.
+	int right = count/2;
+	if(bestAxis >= 0){
+		right = count;
+		for(int left=0; left < right;){
+			cpFloat center = (bestAxis == 0 ? items[left].center.x : items[left].center.y);
+			
+			if(BinIndex(center, min[bestAxis], scale[bestAxis]) >= bestSplit){
+				right--;
+				RebuildItem temp = items[left];
+				items[left] = items[right];
+				items[right] = temp;
+			} else {
+				left++;
+			}
+		}
+	}
+	
+	// Recurse and build the node!
+	int a = RebuildSubtree(rebuild, items, right);
+	int b = RebuildSubtree(rebuild, items + right, count - right);
+	return RebuildNode(rebuild, a, b);
+}
+
+typedef struct rebuildContext {
+	cpBBTree *tree;
+	cpBBTreeRebuild *rebuild;
+} rebuildContext;
 
-	// Generate the child BBs
-	cpBB a = bb, b = bb;
-	if(splitWidth) a.r = b.l = split; else a.t = b.b = split;
+static void
+fillRebuild(Leaf *leaf, rebuildContext *context){
+	cpBBTree *tree = context->tree;
+	cpBBTreeRebuild *rebuild = context->rebuild;
 	
-	// Partition the nodes
-	int right = count;
-	for(int left=0; left < right;){
-		Node *node = nodes[left];
-		if(cpBBMergedArea(node->bb, b) < cpBBMergedArea(node->bb, a)){
-//		if(cpBBProximity(node->bb, b) < cpBBProximity(node->bb, a)){
-			right--;
-			nodes[left] = nodes[right];
-			nodes[right] = node;
-		} else {
-			left++;
-		}
+	rebuild->leaves[rebuild->count] = leaf;
+	rebuild->bbs[rebuild->count] = tree->nodes[leaf->node].bb;
+	rebuild->count++;
+}
+
+cpBBTreeRebuild *
+cpBBTreeRebuildNew(cpSpatialIndex *index)
+{
+	cpAssertHard(index->klass == &klass, "Index is not a cpBBTree.");
+	cpBBTree *tree = (cpBBTree *)index;
+	
+	int count = cpBBTreeCount(tree);
+	cpBBTreeRebuild *rebuild = (cpBBTreeRebuild *)cpcalloc(1, sizeof(cpBBTreeRebuild));
+	rebuild->version = tree->version;
+	rebuild->leaves = (Leaf **)cpcalloc(count ? count : 1, sizeof(Leaf *));
+	rebuild->bbs = (cpBB *)cpcalloc(count ? count : 1, sizeof(cpBB));
+	rebuild->root = NULL_NODE;
+	
+	rebuildContext context = {tree, rebuild};
+	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)fillRebuild, &context);
+	
+	return rebuild;
+}
+
+void
+cpBBTreeRebuildRun(cpBBTreeRebuild *rebuild)
+{
+	int count = rebuild->count;
+	if(count == 0 || rebuild->nodes) return;
+	
+	rebuild->nodes = (Node *)cpcalloc(2*count - 1, sizeof(Node));
+	rebuild->links = (NodeLink *)cpcalloc(2*count - 1, sizeof(NodeLink));
+	
+	RebuildItem *items = (RebuildItem *)cpcalloc(count, sizeof(RebuildItem));
+	for(int i=0; i<count; i++){
+		cpBB bb = rebuild->bbs[i];
+		rebuild->nodes[i].bb = bb;
+		rebuild->nodes[i].a = rebuild->nodes[i].b = NULL_NODE;
+		rebuild->links[i].parent = NULL_NODE;
+		rebuild->links[i].leaf = rebuild->leaves[i];
+		
+		RebuildItem item = {bb, cpBBCenter(bb), i};
+		items[i] = item;
 	}
 	
-	if(right == count){
-		Node *node = NULL;
-		for(int i=0; i<count; i++) node = SubtreeInsert(node, nodes[i], tree);
-		return node;
+	rebuild->nodeCount = count;
+	rebuild->root = RebuildSubtree(rebuild, items, count);
+	cpfree(items);
+}
+
+static void
+cpBBTreeRebuildFree(cpBBTreeRebuild *rebuild)
+{
+	cpfree(rebuild->leaves);
+	cpfree(rebuild->bbs);
+	cpfree(rebuild->nodes);
+	cpfree(rebuild->links);
+	cpfree(rebuild);
+}
+
+cpBool
+cpBBTreeRebuildFinish(cpSpatialIndex *index, cpBBTreeRebuild *rebuild)
+{
+	cpAssertHard(index->klass == &klass, "Index is not a cpBBTree.");
+	cpBBTree *tree = (cpBBTree *)index;
+	
+	if(rebuild->version != tree->version){
+		cpBBTreeRebuildFree(rebuild);
+		return cpFalse;
 	}
 	
-	// Recurse and build the node!
-	return NodeNew(tree,
-		partitionNodes(tree, nodes, right),
-		partitionNodes(tree, nodes + right, count - right)
-	);
+	if(rebuild->count == 0){
+		cpBBTreeRebuildFree(rebuild);
+		return cpTrue;
+	}
+	
+	cpAssertHard(rebuild->nodes, "cpBBTreeRebuildRun() was not called.");
+	Node *nodes = rebuild->nodes;
+	int count = rebuild->count;
+	
+	// Objects may have moved since the snapshot was taken. Refit the new tree to their current bounds.
+	for(int i=0; i<count; i++){
+		Leaf *leaf = rebuild->leaves[i];
+		nodes[i].bb = tree->nodes[leaf->node].bb;
+		leaf->node = i;
+	}
+	
+	// Internal nodes are stored after their children.
+	for(int i=count; i<rebuild->nodeCount; i++){
+		nodes[i].bb = cpBBMerge(nodes[nodes[i].a].bb, nodes[nodes[i].b].bb);
+	}
+	
+	cpfree(tree->nodes);
+	cpfree(tree->links);
+	
+	tree->nodes = rebuild->nodes;
+	tree->links = rebuild->links;
+	tree->nodeCount = tree->nodeCapacity = rebuild->nodeCount;
+	tree->pooledNodes = NULL_NODE;
+	tree->root = rebuild->root;
+	tree->wideDirty = cpTrue;
+	
+	rebuild->nodes = NULL;
+	rebuild->links = NULL;
+	cpBBTreeRebuildFree(rebuild);
+	
+	return cpTrue;
 }
 
 //static void
@@ -832,19 +1734,9 @@ cpBBTreeOptimize(cpSpatialIndex *index)
 		return;
 	}
 	
-	cpBBTree *tree = (cpBBTree *)index;
-	Node *root = tree->root;
-	if(!root) return;
-	
-	int count = cpBBTreeCount(tree);
-	Node **nodes = (Node **)cpcalloc(count, sizeof(Node *));
-	Node **cursor = nodes;
-	
-	cpHashSetEach(tree->leaves, (cpHashSetIteratorFunc)fillNodeArray, &cursor);
-	
-	SubtreeRecycle(tree, root);
-	tree->root = partitionNodes(tree, nodes, count);
-	cpfree(nodes);
+	cpBBTreeRebuild *rebuild = cpBBTreeRebuildNew(index);
+	cpBBTreeRebuildRun(rebuild);
+	cpBBTreeRebuildFinish(index, rebuild);
 }
 
 //MARK: Debug Draw
@@ -856,14 +1748,15 @@ cpBBTreeOptimize(cpSpatialIndex *index)
 #include <GLUT/glut.h>
 
 static void
-NodeRender(Node *node, int depth)
+NodeRender(cpBBTree *tree, int node, int depth)
 {
-	if(!NodeIsLeaf(node) && depth <= 10){
-		NodeRender(node->a, depth + 1);
-		NodeRender(node->b, depth + 1);
+	Node *n = tree->nodes + node;
+	if(!NodeIsLeaf(n) && depth <= 10){
+		NodeRender(tree, n->a, depth + 1);
+		NodeRender(tree, n->b, depth + 1);
 	}
 	
-	cpBB bb = node->bb;
+	cpBB bb = tree->nodes[node].bb;
 	
 //	GLfloat v = depth/2.0f;	
 //	glColor3f(1.0f - v, v, 0.0f);
@@ -891,6 +1784,6 @@ cpBBTreeRenderDebug(cpSpatialIndex *index){
 	}
 	
 	cpBBTree *tree = (cpBBTree *)index;
-	if(tree->root) NodeRender(tree->root, 0);
+	if(tree->root != NULL_NODE) NodeRender(tree, tree->root, 0);
 }
 #endif
@@ -45,6 +45,12 @@ cpBodyInit(cpBody *body, cpFloat mass, cpFloat moment)
 	body->sleeping.next = NULL;
 	body->sleeping.idleTime = 0.0f;
 	
+	body->solver.colors = 0;
+	body->solver.index = -1;
+	body->solver.island = -1;
+	body->solver.dp = cpvzero;
+	body->solver.da = 0.0f;
+	
 	body->p = cpvzero;
 	body->v = cpvzero;
 	body->f = cpvzero;
@@ -393,6 +399,11 @@ cpBodySetCenterOfGravity(cpBody *body, cpVect cog)
 	cpBodyActivate(body);
 	body->cog = cog;
 	cpAssertSaneBody(body);
+	
+	// Moving the center of gravity moves the shapes relative to the body's position.
+	CP_BODY_FOREACH_SHAPE(body, shape){
+		if(shape->space) cpSpaceFilterSeparations(shape->space, shape);
+	}
 }
 
 cpVect
@@ -521,6 +532,16 @@ cpBodyUpdatePosition(cpBody *body, cpFloat dt)
 	cpAssertSaneBody(body);
 }
 
+void
+cpBodyCorrectPosition(cpBody *body, cpVect dp, cpFloat da)
+{
+	cpVect p = body->p = cpvadd(body->p, dp);
+	cpFloat a = SetAngle(body, body->a + da);
+	SetTransform(body, p, a);
+	
+	cpAssertSaneBody(body);
+}
+
 cpVect
 cpBodyLocalToWorld(const cpBody *body, const cpVect point)
 {
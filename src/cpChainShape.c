@@ -0,0 +1,332 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// Maximum number of edges in a leaf node of a chain's bounding volume hierarchy.
+#define CHAIN_LEAF_EDGES 4
+
+cpChainShape *
+cpChainShapeAlloc(void)
+{
+	return (cpChainShape *)cpcalloc(1, sizeof(cpChainShape));
+}
+
+static void
+cpChainShapeDestroy(cpChainShape *chain)
+{
+	cpfree(chain->verts);
+	cpfree(chain->normals);
+	cpfree(chain->nodes);
+}
+
+static cpBB
+cpChainShapeCacheData(cpChainShape *chain, cpTransform transform)
+{
+	chain->transform = transform;
+	return cpTransformbBB(transform, chain->nodes[0].bb);
+}
+
+static inline cpBool
+NodeIsLeaf(const struct cpChainNode *node)
+{
+	return (node->end - node->start <= CHAIN_LEAF_EDGES);
+}
+
+void
+cpChainShapeGetEdge(const cpChainShape *chain, int edge, cpSegmentShape *seg)
+{
+	int count = chain->count;
+	const cpVect *verts = chain->verts;
+	cpTransform transform = chain->transform;
+	
+	int i = edge, j = (edge + 1)%count;
+	seg->shape.klass = &cpSegmentShapeClass;
+	seg->shape.body = chain->shape.body;
+	
+	seg->a = verts[i];
+	seg->b = verts[j];
+	seg->n = chain->normals[edge];
+	seg->r = chain->r;
+	
+	// Point the tangents at the neighboring vertexes so the edges are smooth where they meet.
+	cpBool hasPrev = (chain->loop || i > 0);
+	cpBool hasNext = (chain->loop || j < count - 1);
+	seg->a_tangent = (hasPrev ? cpvsub(verts[(i - 1 + count)%count], seg->a) : cpvzero);
+	seg->b_tangent = (hasNext ? cpvsub(verts[(j + 1)%count], seg->b) : cpvzero);
+	
+	cpVect ta = seg->ta = cpTransformPoint(transform, seg->a);
+	cpVect tb = seg->tb = cpTransformPoint(transform, seg->b);
+	seg->tn = cpTransformVect(transform, seg->n);
+	
+	cpFloat r = seg->r;
+	seg->shape.bb = cpBBNew(cpfmin(ta.x, tb.x) - r, cpfmin(ta.y, tb.y) - r, cpfmax(ta.x, tb.x) + r, cpfmax(ta.y, tb.y) + r);
+}
+
+void
+cpChainShapeQueryEdges(const cpChainShape *chain, cpBB bb, cpChainEdgeIteratorFunc func, void *data)
+{
+	// Walk the hierarchy in body coordinates.
+	bb = cpTransformbBB(cpTransformInverse(chain->transform), bb);
+	
+	const struct cpChainNode *nodes = chain->nodes;
+	int i = 0, nodeCount = chain->nodeCount;
+	
+	while(i < nodeCount){
+		const struct cpChainNode *node = nodes + i;
+		
+		if(!cpBBIntersects(node->bb, bb)){
+			i = node->skip;
+		} else if(NodeIsLeaf(node)){
+			for(int edge=node->start; edge<node->end; edge++) func(chain, edge, data);
+			i = node->skip;
+		} else {
+			i++;
+		}
+	}
+}
+
+// Distance from a point to the outside of a bounding box.
+static inline cpFloat
+BBDistance(cpBB bb, cpVect p)
+{
+	cpFloat dx = cpfmax(cpfmax(bb.l - p.x, p.x - bb.r), 0.0f);
+	cpFloat dy = cpfmax(cpfmax(bb.b - p.y, p.y - bb.t), 0.0f);
+	return cpfsqrt(dx*dx + dy*dy);
+}
+
+static void
+cpChainShapePointQuery(cpChainShape *chain, cpVect p, cpPointQueryInfo *info)
+{
+	cpVect lp = cpTransformPoint(cpTransformInverse(chain->transform), p);
+	cpFloat r = chain->r;
+	
+	cpPointQueryInfo closest = {NULL, cpvzero, INFINITY, cpvzero};
+	
+	const struct cpChainNode *nodes = chain->nodes;
+	int i = 0, nodeCount = chain->nodeCount;
+	
+	while(i < nodeCount){
+		const struct cpChainNode *node = nodes + i;
+		
+		// Skip nodes that can't contain an edge closer than the best one so far.
+		if(BBDistance(node->bb, lp) - r >= closest.distance){
+			i = node->skip;
+		} else if(NodeIsLeaf(node)){
+			for(int edge=node->start; edge<node->end; edge++){
+				cpSegmentShape seg;
+				cpChainShapeGetEdge(chain, edge, &seg);
+				
+				cpPointQueryInfo edge_info;
+				cpSegmentShapeClass.pointQuery((cpShape *)&seg, p, &edge_info);
+				if(edge_info.distance < closest.distance) closest = edge_info;
+			}
+			
+			i = node->skip;
+		} else {
+			i++;
+		}
+	}
+	
+	(*info) = closest;
+	info->shape = (cpShape *)chain;
+}
+
+static void
+cpChainShapeSegmentQuery(cpChainShape *chain, cpVect a, cpVect b, cpFloat r2, cpSegmentQueryInfo *info)
+{
+	cpTransform inverse = cpTransformInverse(chain->transform);
+	cpVect la = cpTransformPoint(inverse, a);
+	cpVect lb = cpTransformPoint(inverse, b);
+	
+	const struct cpChainNode *nodes = chain->nodes;
+	int i = 0, nodeCount = chain->nodeCount;
+	
+	while(i < nodeCount){
+		const struct cpChainNode *node = nodes + i;
+		cpBB bb = node->bb;
+		
+		// Skip nodes the query misses, or only hits after the closest edge found so far.
+		if(cpBBSegmentQuery(cpBBNew(bb.l - r2, bb.b - r2, bb.r + r2, bb.t + r2), la, lb) > info->alpha){
+			i = node->skip;
+		} else if(NodeIsLeaf(node)){
+			for(int edge=node->start; edge<node->end; edge++){
+				cpSegmentShape seg;
+				cpChainShapeGetEdge(chain, edge, &seg);
+				
+				cpSegmentQueryInfo edge_info = {NULL, b, cpvzero, 1.0f};
+				cpSegmentShapeClass.segmentQuery((cpShape *)&seg, a, b, r2, &edge_info);
+				if(edge_info.shape && edge_info.alpha < info->alpha){
+					(*info) = edge_info;
+					info->shape = (cpShape *)chain;
+				}
+			}
+			
+			i = node->skip;
+		} else {
+			i++;
+		}
+	}
+}
+
+static struct cpShapeMassInfo
+cpChainShapeMassInfo(cpFloat mass, int count, const cpVect *verts, cpBool loop, cpFloat r)
+{
+	int edgeCount = (loop ? count : count - 1);
+	
+	// Weight each edge by its area, or by its length if the chain has no thickness.
+	cpFloat total = 0.0f;
+	cpVect cog = cpvzero;
+	for(int i=0; i<edgeCount; i++){
+		cpVect a = verts[i], b = verts[(i + 1)%count];
+		cpFloat w = (r > 0.0f ? cpAreaForSegment(a, b, r) : cpvdist(a, b));
+		
+		total += w;
+		cog = cpvadd(cog, cpvmult(cpvlerp(a, b, 0.5f), w));
+	}
+	
+	cog = (total > 0.0f ? cpvmult(cog, 1.0f/total) : verts[0]);
+	
+	cpFloat moment = 0.0f;
+	for(int i=0; i<edgeCount; i++){
+		cpVect a = verts[i], b = verts[(i + 1)%count];
+		cpFloat w = (r > 0.0f ? cpAreaForSegment(a, b, r) : cpvdist(a, b));
+		
+		// TODO is an approximation like the segment shape's moment.
+		cpFloat edgeMoment = cpMomentForBox(1.0f, cpvdist(a, b) + 2.0f*r, 2.0f*r);
+		moment += w*(edgeMoment + cpvdistsq(cpvlerp(a, b, 0.5f), cog));
+	}
+	
+	struct cpShapeMassInfo info = {
+		mass, (total > 0.0f ? moment/total : 0.0f),
+		cog,
+		(r > 0.0f ? total : 0.0f),
+	};
+	
+	return info;
+}
+
+static const cpShapeClass cpChainShapeClass = {
+	CP_CHAIN_SHAPE,
+	(cpShapeCacheDataImpl)cpChainShapeCacheData,
+	(cpShapeDestroyImpl)cpChainShapeDestroy,
+	(cpShapePointQueryImpl)cpChainShapePointQuery,
+	(cpShapeSegmentQueryImpl)cpChainShapeSegmentQuery,
+};
+
+// Build the subtree for the edges in [start, end) starting at 'index'.
+// Returns the index after the last node of the subtree.
+static int
+BuildNodes(cpChainShape *chain, int start, int end, int index)
+{
+	struct cpChainNode *node = chain->nodes + index;
+	node->start = start;
+	node->end = end;
+	
+	if(NodeIsLeaf(node)){
+		int count = chain->count;
+		const cpVect *verts = chain->verts;
+		cpFloat r = chain->r;
+		
+		cpBB bb = cpBBNewForCircle(verts[start], r);
+		for(int i=start; i<end; i++) bb = cpBBMerge(bb, cpBBNewForCircle(verts[(i + 1)%count], r));
+		
+		node->bb = bb;
+		return (node->skip = index + 1);
+	} else {
+		// Consecutive edges are usually close to each other, so splitting the range in half gives a good hierarchy.
+		int mid = (start + end)/2;
+		int right = BuildNodes(chain, start, mid, index + 1);
+		int next = BuildNodes(chain, mid, end, right);
+		
+		node = chain->nodes + index;
+		node->bb = cpBBMerge(chain->nodes[index + 1].bb, chain->nodes[right].bb);
+		return (node->skip = next);
+	}
+}
+
+cpChainShape *
+cpChainShapeInit(cpChainShape *chain, cpBody *body, int count, const cpVect *verts, cpBool loop, cpFloat radius)
+{
+	cpAssertHard(count >= (loop ? 3 : 2), "A chain shape needs at least 2 vertexes, or 3 if it loops.");
+	
+	cpShapeInit((cpShape *)chain, &cpChainShapeClass, body, cpChainShapeMassInfo(0.0f, count, verts, loop, radius));
+	
+	chain->r = radius;
+	chain->count = count;
+	chain->loop = loop;
+	chain->transform = cpTransformIdentity;
+	
+	chain->verts = (cpVect *)cpcalloc(count, sizeof(cpVect));
+	memcpy(chain->verts, verts, count*sizeof(cpVect));
+	
+	int edgeCount = (loop ? count : count - 1);
+	chain->normals = (cpVect *)cpcalloc(edgeCount, sizeof(cpVect));
+	for(int i=0; i<edgeCount; i++){
+		chain->normals[i] = cpvrperp(cpvnormalize(cpvsub(verts[(i + 1)%count], verts[i])));
+	}
+	
+	// Halving the edge ranges produces fewer than 2*edgeCount nodes.
+	chain->nodes = (struct cpChainNode *)cpcalloc(2*edgeCount, sizeof(struct cpChainNode));
+	chain->nodeCount = BuildNodes(chain, 0, edgeCount, 0);
+	
+	return chain;
+}
+
+cpShape *
+cpChainShapeNew(cpBody *body, int count, const cpVect *verts, cpBool loop, cpFloat radius)
+{
+	return (cpShape *)cpChainShapeInit(cpChainShapeAlloc(), body, count, verts, loop, radius);
+}
+
+int
+cpChainShapeGetCount(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpChainShapeClass, "Shape is not a chain shape.");
+	return ((cpChainShape *)shape)->count;
+}
+
+cpVect
+cpChainShapeGetVert(const cpShape *shape, int i)
+{
+	cpAssertHard(shape->klass == &cpChainShapeClass, "Shape is not a chain shape.");
+	
+	int count = cpChainShapeGetCount(shape);
+	cpAssertHard(0 <= i && i < count, "Index out of range.");
+	
+	return ((cpChainShape *)shape)->verts[i];
+}
+
+cpBool
+cpChainShapeGetLoop(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpChainShapeClass, "Shape is not a chain shape.");
+	return ((cpChainShape *)shape)->loop;
+}
+
+cpFloat
+cpChainShapeGetRadius(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpChainShapeClass, "Shape is not a chain shape.");
+	return ((cpChainShape *)shape)->r;
+}
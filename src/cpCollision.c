@@ -533,6 +533,8 @@ CircleToCircle(const cpCircleShape *c1, const cpCircleShape *c2, struct cpCollis
 		cpFloat dist = cpfsqrt(distsq);
 		cpVect n = info->n = (dist ? cpvmult(delta, 1.0f/dist) : cpv(1.0f, 0.0f));
 		cpCollisionInfoPushContact(info, cpvadd(c1->tc, cpvmult(n, c1->r)), cpvadd(c2->tc, cpvmult(n, -c2->r)), 0);
+	} else {
+		info->d = cpfsqrt(distsq) - mindist;
 	}
 }
 
@@ -565,6 +567,8 @@ CircleToSegment(const cpCircleShape *circle, const cpSegmentShape *segment, stru
 		){
 			cpCollisionInfoPushContact(info, cpvadd(center, cpvmult(n, circle->r)), cpvadd(closest, cpvmult(n, -segment->r)), 0);
 		}
+	} else {
+		info->d = cpfsqrt(distsq) - mindist;
 	}
 }
 
@@ -585,6 +589,8 @@ SegmentToSegment(const cpSegmentShape *seg1, const cpSegmentShape *seg2, struct
 	ChipmunkDebugDrawSegment(points.a, cpvadd(points.a, cpvmult(points.n, 10.0)), RGBAColor(1, 0, 0, 1));
 #endif
 	
+	info->d = points.d - (seg1->r + seg2->r);
+	
 	cpVect n = points.n;
 	cpVect rot1 = cpBodyGetRotation(seg1->shape.body);
 	cpVect rot2 = cpBodyGetRotation(seg2->shape.body);
@@ -603,9 +609,117 @@ SegmentToSegment(const cpSegmentShape *seg1, const cpSegmentShape *seg2, struct
 	}
 }
 
+// Collision ids cached by the separating axis test have this bit set.
+// GJK ids never do since polygons collided with SAT have fewer than 128 vertexes, which chipmunk.h enforces.
+#define SAT_ID_FLAG 0x80000000
+// Set when the cached axis is an edge of the second polygon.
+#define SAT_ID_POLY2 0x100
+
+// Distance between the edge of 'poly1' ending at vertex 'i' and the nearest vertex of 'poly2' along the edge's normal.
+static inline cpFloat
+EdgeSeparation(const cpPolyShape *poly1, const int i, const cpPolyShape *poly2)
+{
+	const struct cpSplittingPlane plane = poly1->planes[i];
+	const struct cpSplittingPlane *planes2 = poly2->planes;
+	
+	cpFloat min = INFINITY;
+	for(int j=0, count=poly2->count; j<count; j++){
+		min = cpfmin(min, cpvdot(plane.n, planes2[j].v0));
+	}
+	
+	return min - cpvdot(plane.n, plane.v0);
+}
+
+// Find the edge of 'poly1' with the largest separation from 'poly2'.
+// Returns early once an edge is found with a separation larger than 'mindist'.
+static inline cpFloat
+PolyMaxSeparation(const cpPolyShape *poly1, const cpPolyShape *poly2, const cpFloat mindist, int *edge)
+{
+	cpFloat max = -INFINITY;
+	
+	for(int i=0, count=poly1->count; i<count; i++){
+		cpFloat d = EdgeSeparation(poly1, i, poly2);
+		if(d > max){
+			max = d;
+			*edge = i;
+			if(d > mindist) break;
+		}
+	}
+	
+	return max;
+}
+
+// Collide small polygons by testing each of their edge normals as a separating axis.
+// Returns false if the shapes are rounded and close enough that GJK is needed to find their closest points.
+static cpBool
+PolyToPolySAT(const cpPolyShape *poly1, const cpPolyShape *poly2, struct cpCollisionInfo *info)
+{
+	cpFloat mindist = poly1->r + poly2->r;
+	cpCollisionID id = info->id;
+	
+	// Most pairs that were separated last step are still separated by the same axis.
+	if(id & SAT_ID_FLAG){
+		int i = (int)(id & 0xFF);
+		cpFloat d = -INFINITY;
+		if(id & SAT_ID_POLY2){
+			if(i < poly2->count) d = EdgeSeparation(poly2, i, poly1);
+		} else {
+			if(i < poly1->count) d = EdgeSeparation(poly1, i, poly2);
+		}
+		
+		if(d > mindist){
+			// The separation along any axis is a lower bound on the distance between the shapes.
+			info->d = d - mindist;
+			return cpTrue;
+		}
+	}
+	
+	int edge1 = 0, edge2 = 0;
+	cpFloat d1 = PolyMaxSeparation(poly1, poly2, mindist, &edge1);
+	if(d1 > mindist){
+		info->id = SAT_ID_FLAG | edge1;
+		info->d = d1 - mindist;
+		return cpTrue;
+	}
+	
+	cpFloat d2 = PolyMaxSeparation(poly2, poly1, mindist, &edge2);
+	if(d2 > mindist){
+		info->id = SAT_ID_FLAG | SAT_ID_POLY2 | edge2;
+		info->d = d2 - mindist;
+		return cpTrue;
+	}
+	
+	// The cores don't overlap. The closest points might not lie along an edge normal.
+	if(d1 > 0.0f || d2 > 0.0f) return cpFalse;
+	
+	// The edge with the least penetration is the minimum separating axis.
+	// Prefer the first polygon's edges unless the second is clearly better so the normal doesn't flip between steps.
+	struct ClosestPoints points = {cpvzero, cpvzero, poly1->planes[edge1].n, d1, 0};
+	info->id = SAT_ID_FLAG | edge1;
+	
+	if(d2 > 0.98f*d1 + 0.001f){
+		points.n = cpvneg(poly2->planes[edge2].n);
+		points.d = d2;
+		info->id = SAT_ID_FLAG | SAT_ID_POLY2 | edge2;
+	}
+	
+	ContactPoints(SupportEdgeForPoly(poly1, points.n), SupportEdgeForPoly(poly2, cpvneg(points.n)), points, info);
+	return cpTrue;
+}
+
 static void
 PolyToPoly(const cpPolyShape *poly1, const cpPolyShape *poly2, struct cpCollisionInfo *info)
 {
+	if(
+		3 <= poly1->count && poly1->count <= CP_SAT_MAX_VERTEXES &&
+		3 <= poly2->count && poly2->count <= CP_SAT_MAX_VERTEXES
+	){
+		if(PolyToPolySAT(poly1, poly2, info)) return;
+	}
+	
+	// The separating axis test's ids are not valid starting points for GJK.
+	if(info->id & SAT_ID_FLAG) info->id = 0;
+	
 	struct SupportContext context = {(cpShape *)poly1, (cpShape *)poly2, (SupportPointFunc)PolySupportPoint, (SupportPointFunc)PolySupportPoint};
 	struct ClosestPoints points = GJK(&context, &info->id);
 	
@@ -620,8 +734,10 @@ PolyToPoly(const cpPolyShape *poly1, const cpPolyShape *poly2, struct cpCollisio
 	ChipmunkDebugDrawSegment(points.a, cpvadd(points.a, cpvmult(points.n, 10.0)), RGBAColor(1, 0, 0, 1));
 #endif
 	
+	info->d = points.d - poly1->r - poly2->r;
+	
 	// If the closest points are nearer than the sum of the radii...
-	if(points.d - poly1->r - poly2->r <= 0.0){
+	if(info->d <= 0.0){
 		ContactPoints(SupportEdgeForPoly(poly1, points.n), SupportEdgeForPoly(poly2, cpvneg(points.n)), points, info);
 	}
 }
@@ -643,12 +759,14 @@ SegmentToPoly(const cpSegmentShape *seg, const cpPolyShape *poly, struct cpColli
 	ChipmunkDebugDrawSegment(points.a, cpvadd(points.a, cpvmult(points.n, 10.0)), RGBAColor(1, 0, 0, 1));
 #endif
 	
+	info->d = points.d - seg->r - poly->r;
+	
 	cpVect n = points.n;
 	cpVect rot = cpBodyGetRotation(seg->shape.body);
 	
 	if(
 		// If the closest points are nearer than the sum of the radii...
-		points.d - seg->r - poly->r <= 0.0 && (
+		info->d <= 0.0 && (
 			// Reject endcap collisions if tangents are provided.
 			(!cpveql(points.a, seg->ta) || cpvdot(n, cpvrotate(seg->a_tangent, rot)) <= 0.0) &&
 			(!cpveql(points.a, seg->tb) || cpvdot(n, cpvrotate(seg->b_tangent, rot)) <= 0.0)
@@ -675,9 +793,201 @@ CircleToPoly(const cpCircleShape *circle, const cpPolyShape *poly, struct cpColl
 	if(points.d <= circle->r + poly->r){
 		cpVect n = info->n = points.n;
 		cpCollisionInfoPushContact(info, cpvadd(points.a, cpvmult(n, circle->r)), cpvadd(points.b, cpvmult(n, poly->r)), 0);
+	} else {
+		info->d = points.d - (circle->r + poly->r);
+	}
+}
+
+//MARK: Merged Manifolds
+
+// Chain, heightfield and compound shapes are made of many parts.
+// The contacts against each part are gathered and merged into a single manifold.
+
+// Maximum number of part contacts kept while building a merged manifold.
+#define MERGE_MAX_CONTACTS 16
+
+struct MergeContact {
+	cpVect p1, p2, n;
+	cpFloat dist;
+	cpHashValue hash;
+};
+
+struct MergeContext {
+	const cpShape *shape, *container;
+	int count;
+	struct MergeContact contacts[MERGE_MAX_CONTACTS];
+};
+
+// Gather the contacts from colliding the shape with a part of the container.
+// If 'flip' is true, the info's normal and contacts point from the part to the shape instead.
+static void
+MergePushContacts(struct MergeContext *context, const struct cpCollisionInfo *info, cpBool flip, int part)
+{
+	const struct cpContact *contacts = info->arr;
+	
+	for(int i=0; i<info->count; i++){
+		cpVect p1 = (flip ? contacts[i].r2 : contacts[i].r1);
+		cpVect p2 = (flip ? contacts[i].r1 : contacts[i].r2);
+		cpVect n = (flip ? cpvneg(info->n) : info->n);
+		cpFloat dist = cpvdot(cpvsub(p2, p1), n);
+		
+		int index = context->count;
+		if(index == MERGE_MAX_CONTACTS){
+			// Replace the shallowest contact if this one is deeper.
+			index = 0;
+			for(int j=1; j<MERGE_MAX_CONTACTS; j++){
+				if(context->contacts[j].dist > context->contacts[index].dist) index = j;
+			}
+			
+			if(dist >= context->contacts[index].dist) continue;
+		} else {
+			context->count++;
+		}
+		
+		struct MergeContact *contact = context->contacts + index;
+		contact->p1 = p1;
+		contact->p2 = p2;
+		contact->n = n;
+		contact->dist = dist;
+		contact->hash = CP_HASH_PAIR((cpHashValue)part, contacts[i].hash);
 	}
 }
 
+// Merge the gathered contacts into a single manifold.
+static void
+MergeManifold(const struct MergeContext *context, struct cpCollisionInfo *info)
+{
+	int count = context->count;
+	if(count == 0) return;
+	
+	const struct MergeContact *contacts = context->contacts;
+	
+	// Blend the edge normals weighted by their penetration depth.
+	cpVect n = cpvzero;
+	int deepest = 0;
+	for(int i=0; i<count; i++){
+		n = cpvadd(n, cpvmult(contacts[i].n, cpfmax(-contacts[i].dist, 0.0f)));
+		if(contacts[i].dist < contacts[deepest].dist) deepest = i;
+	}
+	
+	n = (cpvlengthsq(n) > 0.0f ? cpvnormalize(n) : contacts[deepest].n);
+	
+	// Keep the deepest contact along the blended normal, and the contact farthest away from it along the surface.
+	int first = 0;
+	cpFloat min = INFINITY;
+	for(int i=0; i<count; i++){
+		cpFloat dist = cpvdot(cpvsub(contacts[i].p2, contacts[i].p1), n);
+		if(dist < min){
+			min = dist;
+			first = i;
+		}
+	}
+	
+	int second = -1;
+	cpFloat max = 0.0f;
+	cpVect tangent = cpvperp(n);
+	cpFloat base = cpvdot(contacts[first].p1, tangent);
+	for(int i=0; i<count; i++){
+		cpFloat spread = cpfabs(cpvdot(contacts[i].p1, tangent) - base);
+		if(spread > max && contacts[i].hash != contacts[first].hash){
+			max = spread;
+			second = i;
+		}
+	}
+	
+	info->n = n;
+	cpCollisionInfoPushContact(info, contacts[first].p1, contacts[first].p2, contacts[first].hash);
+	if(second >= 0) cpCollisionInfoPushContact(info, contacts[second].p1, contacts[second].p2, contacts[second].hash);
+}
+
+//MARK: Terrain Shapes
+
+// Collide a shape with a single edge of a chain or column of a heightfield and gather the contacts.
+static void
+TerrainEdgeCollide(cpSegmentShape *seg, int edge, struct MergeContext *context)
+{
+	const cpShape *shape = context->shape;
+	if(!cpBBIntersects(seg->shape.bb, shape->bb)) return;
+	
+	seg->shape.hashid = CP_HASH_PAIR(context->container->hashid, edge);
+	struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+	struct cpCollisionInfo info = {shape, (cpShape *)seg, 0, cpvzero, 0, contacts, 0.0f};
+	
+	// There is only a segment to poly function, so the results need to be flipped to point from the shape to the terrain.
+	cpBool flip = cpFalse;
+	switch(shape->klass->type){
+		case CP_CIRCLE_SHAPE: CircleToSegment((cpCircleShape *)shape, seg, &info); break;
+		case CP_SEGMENT_SHAPE: SegmentToSegment((cpSegmentShape *)shape, seg, &info); break;
+		case CP_POLY_SHAPE: SegmentToPoly(seg, (cpPolyShape *)shape, &info); flip = cpTrue; break;
+		default: break;
+	}
+	
+	MergePushContacts(context, &info, flip, edge);
+}
+
+static void
+ChainEdgeCollide(const cpChainShape *chain, int edge, struct MergeContext *context)
+{
+	cpSegmentShape seg;
+	cpChainShapeGetEdge(chain, edge, &seg);
+	TerrainEdgeCollide(&seg, edge, context);
+}
+
+// Collide a shape against the edges of a chain and merge the contacts into a single manifold.
+static void
+ShapeToChain(const cpShape *shape, const cpChainShape *chain, struct cpCollisionInfo *info)
+{
+	struct MergeContext context = {shape, (cpShape *)chain, 0};
+	cpChainShapeQueryEdges(chain, shape->bb, (cpChainEdgeIteratorFunc)ChainEdgeCollide, &context);
+	MergeManifold(&context, info);
+}
+
+// Collide a shape against the columns of a heightfield under it and merge the contacts into a single manifold.
+static void
+ShapeToHeightfield(const cpShape *shape, const cpHeightfieldShape *heightfield, struct cpCollisionInfo *info)
+{
+	struct MergeContext context = {shape, (cpShape *)heightfield, 0};
+	
+	int first, last;
+	cpHeightfieldShapeColumnRange(heightfield, shape->bb, &first, &last);
+	for(int i=first; i<last; i++){
+		cpSegmentShape seg;
+		cpHeightfieldShapeGetColumn(heightfield, i, &seg);
+		TerrainEdgeCollide(&seg, i, &context);
+	}
+	
+	MergeManifold(&context, info);
+}
+
+// Chain and heightfield shapes are meant for static terrain and don't collide with each other.
+static void
+TerrainToTerrain(const cpShape *terrain1, const cpShape *terrain2, struct cpCollisionInfo *info){}
+
+//MARK: Compound Shapes
+
+static void
+CompoundChildCollide(cpShape *child, int index, struct MergeContext *context)
+{
+	const cpShape *shape = context->shape;
+	if(!cpBBIntersects(child->bb, shape->bb)) return;
+	
+	struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+	struct cpCollisionInfo info = cpCollide(shape, child, 0, contacts);
+	
+	// cpCollide() sorts the shapes by type, so the results need to be flipped if it put the child first.
+	MergePushContacts(context, &info, info.a != shape, index);
+}
+
+// Collide a shape against the children of a compound and merge the contacts into a single manifold.
+// The space collides the children separately so they each get their own arbiter, so this is only used by queries.
+static void
+ShapeToCompound(const cpShape *shape, const cpCompoundShape *compound, struct cpCollisionInfo *info)
+{
+	struct MergeContext context = {shape, (cpShape *)compound, 0};
+	cpCompoundShapeQueryShapes(compound, shape->bb, (cpCompoundShapeIteratorFunc)CompoundChildCollide, &context);
+	MergeManifold(&context, info);
+}
+
 static void
 CollisionError(const cpShape *circle, const cpShape *poly, struct cpCollisionInfo *info)
 {
@@ -685,23 +995,50 @@ CollisionError(const cpShape *circle, const cpShape *poly, struct cpCollisionInf
 }
 
 
-static const CollisionFunc BuiltinCollisionFuncs[9] = {
+static const CollisionFunc BuiltinCollisionFuncs[CP_NUM_SHAPES*CP_NUM_SHAPES] = {
 	(CollisionFunc)CircleToCircle,
 	CollisionError,
 	CollisionError,
+	CollisionError,
+	CollisionError,
+	CollisionError,
 	(CollisionFunc)CircleToSegment,
 	(CollisionFunc)SegmentToSegment,
 	CollisionError,
+	CollisionError,
+	CollisionError,
+	CollisionError,
 	(CollisionFunc)CircleToPoly,
 	(CollisionFunc)SegmentToPoly,
 	(CollisionFunc)PolyToPoly,
+	CollisionError,
+	CollisionError,
+	CollisionError,
+	(CollisionFunc)ShapeToChain,
+	(CollisionFunc)ShapeToChain,
+	(CollisionFunc)ShapeToChain,
+	(CollisionFunc)TerrainToTerrain,
+	CollisionError,
+	CollisionError,
+	(CollisionFunc)ShapeToHeightfield,
+	(CollisionFunc)ShapeToHeightfield,
+	(CollisionFunc)ShapeToHeightfield,
+	(CollisionFunc)TerrainToTerrain,
+	(CollisionFunc)TerrainToTerrain,
+	CollisionError,
+	(CollisionFunc)ShapeToCompound,
+	(CollisionFunc)ShapeToCompound,
+	(CollisionFunc)ShapeToCompound,
+	(CollisionFunc)ShapeToCompound,
+	(CollisionFunc)ShapeToCompound,
+	(CollisionFunc)ShapeToCompound,
 };
 static const CollisionFunc *CollisionFuncs = BuiltinCollisionFuncs;
 
 struct cpCollisionInfo
 cpCollide(const cpShape *a, const cpShape *b, cpCollisionID id, struct cpContact *contacts)
 {
-	struct cpCollisionInfo info = {a, b, id, cpvzero, 0, contacts};
+	struct cpCollisionInfo info = {a, b, id, cpvzero, 0, contacts, 0.0f};
 	
 	// Make sure the shape types are in order.
 	if(a->klass->type > b->klass->type){
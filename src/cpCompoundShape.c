@@ -0,0 +1,313 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// Maximum number of children in a leaf node of a compound's bounding volume hierarchy.
+#define COMPOUND_LEAF_SHAPES 2
+
+cpCompoundShape *
+cpCompoundShapeAlloc(void)
+{
+	return (cpCompoundShape *)cpcalloc(1, sizeof(cpCompoundShape));
+}
+
+static void
+cpCompoundShapeDestroy(cpCompoundShape *compound)
+{
+	for(int i=0; i<compound->count; i++) cpShapeFree(compound->shapes[i]);
+	
+	cpfree(compound->shapes);
+	cpfree(compound->nodes);
+}
+
+static cpBB
+cpCompoundShapeCacheData(cpCompoundShape *compound, cpTransform transform)
+{
+	compound->transform = transform;
+	
+	// The children are updated all at once here instead of each being reindexed by the space.
+	cpBody *body = compound->shape.body;
+	cpShape **shapes = compound->shapes;
+	
+	cpBB bb = cpShapeUpdate(shapes[0], transform);
+	shapes[0]->body = body;
+	
+	for(int i=1; i<compound->count; i++){
+		bb = cpBBMerge(bb, cpShapeUpdate(shapes[i], transform));
+		shapes[i]->body = body;
+	}
+	
+	return bb;
+}
+
+static inline cpBool
+NodeIsLeaf(const struct cpCompoundNode *node)
+{
+	return (node->end - node->start <= COMPOUND_LEAF_SHAPES);
+}
+
+void
+cpCompoundShapeQueryShapes(const cpCompoundShape *compound, cpBB bb, cpCompoundShapeIteratorFunc func, void *data)
+{
+	// Walk the hierarchy in body coordinates.
+	bb = cpTransformbBB(cpTransformInverse(compound->transform), bb);
+	
+	const struct cpCompoundNode *nodes = compound->nodes;
+	int i = 0, nodeCount = compound->nodeCount;
+	
+	while(i < nodeCount){
+		const struct cpCompoundNode *node = nodes + i;
+		
+		if(!cpBBIntersects(node->bb, bb)){
+			i = node->skip;
+		} else if(NodeIsLeaf(node)){
+			for(int j=node->start; j<node->end; j++) func(compound->shapes[j], j, data);
+			i = node->skip;
+		} else {
+			i++;
+		}
+	}
+}
+
+// Distance from a point to the outside of a bounding box.
+static inline cpFloat
+BBDistance(cpBB bb, cpVect p)
+{
+	cpFloat dx = cpfmax(cpfmax(bb.l - p.x, p.x - bb.r), 0.0f);
+	cpFloat dy = cpfmax(cpfmax(bb.b - p.y, p.y - bb.t), 0.0f);
+	return cpfsqrt(dx*dx + dy*dy);
+}
+
+static void
+cpCompoundShapePointQuery(cpCompoundShape *compound, cpVect p, cpPointQueryInfo *info)
+{
+	cpVect lp = cpTransformPoint(cpTransformInverse(compound->transform), p);
+	
+	cpPointQueryInfo closest = {NULL, cpvzero, INFINITY, cpvzero};
+	
+	const struct cpCompoundNode *nodes = compound->nodes;
+	int i = 0, nodeCount = compound->nodeCount;
+	
+	while(i < nodeCount){
+		const struct cpCompoundNode *node = nodes + i;
+		
+		// Skip nodes that can't contain a child closer than the best one so far.
+		if(BBDistance(node->bb, lp) >= closest.distance){
+			i = node->skip;
+		} else if(NodeIsLeaf(node)){
+			for(int j=node->start; j<node->end; j++){
+				cpPointQueryInfo child_info;
+				cpShapePointQuery(compound->shapes[j], p, &child_info);
+				if(child_info.distance < closest.distance) closest = child_info;
+			}
+			
+			i = node->skip;
+		} else {
+			i++;
+		}
+	}
+	
+	(*info) = closest;
+	info->shape = (cpShape *)compound;
+}
+
+static void
+cpCompoundShapeSegmentQuery(cpCompoundShape *compound, cpVect a, cpVect b, cpFloat r2, cpSegmentQueryInfo *info)
+{
+	cpTransform inverse = cpTransformInverse(compound->transform);
+	cpVect la = cpTransformPoint(inverse, a);
+	cpVect lb = cpTransformPoint(inverse, b);
+	
+	const struct cpCompoundNode *nodes = compound->nodes;
+	int i = 0, nodeCount = compound->nodeCount;
+	
+	while(i < nodeCount){
+		const struct cpCompoundNode *node = nodes + i;
+		cpBB bb = node->bb;
+		
+		// Skip nodes the query misses, or only hits after the closest child found so far.
+		if(cpBBSegmentQuery(cpBBNew(bb.l - r2, bb.b - r2, bb.r + r2, bb.t + r2), la, lb) > info->alpha){
+			i = node->skip;
+		} else if(NodeIsLeaf(node)){
+			for(int j=node->start; j<node->end; j++){
+				cpSegmentQueryInfo child_info;
+				if(cpShapeSegmentQuery(compound->shapes[j], a, b, r2, &child_info) && child_info.alpha < info->alpha){
+					(*info) = child_info;
+					info->shape = (cpShape *)compound;
+				}
+			}
+			
+			i = node->skip;
+		} else {
+			i++;
+		}
+	}
+}
+
+static struct cpShapeMassInfo
+cpCompoundShapeMassInfo(int count, cpShape **shapes)
+{
+	cpFloat mass = 0.0f, area = 0.0f;
+	for(int i=0; i<count; i++){
+		mass += shapes[i]->massInfo.m;
+		area += shapes[i]->massInfo.area;
+	}
+	
+	// Weight the children by their mass if they have one, or by their area otherwise.
+	cpBool useMass = (mass > 0.0f);
+	cpFloat total = (useMass ? mass : area);
+	
+	cpVect cog = cpvzero;
+	for(int i=0; i<count; i++){
+		struct cpShapeMassInfo *child = &shapes[i]->massInfo;
+		cog = cpvadd(cog, cpvmult(child->cog, useMass ? child->m : child->area));
+	}
+	
+	cog = (total > 0.0f ? cpvmult(cog, 1.0f/total) : shapes[0]->massInfo.cog);
+	
+	// Moments are stored per unit of mass, so combine them with the parallel axis theorem and divide by the total again.
+	cpFloat moment = 0.0f;
+	for(int i=0; i<count; i++){
+		struct cpShapeMassInfo *child = &shapes[i]->massInfo;
+		moment += (useMass ? child->m : child->area)*(child->i + cpvdistsq(child->cog, cog));
+	}
+	
+	struct cpShapeMassInfo info = {
+		mass, (total > 0.0f ? moment/total : 0.0f),
+		cog,
+		area,
+	};
+	
+	return info;
+}
+
+static const cpShapeClass cpCompoundShapeClass = {
+	CP_COMPOUND_SHAPE,
+	(cpShapeCacheDataImpl)cpCompoundShapeCacheData,
+	(cpShapeDestroyImpl)cpCompoundShapeDestroy,
+	(cpShapePointQueryImpl)cpCompoundShapePointQuery,
+	(cpShapeSegmentQueryImpl)cpCompoundShapeSegmentQuery,
+};
+
+// While building the hierarchy, the children's bounding boxes are still in body coordinates.
+static int
+CompareX(const void *a, const void *b)
+{
+	cpBB bb1 = (*(cpShape **)a)->bb, bb2 = (*(cpShape **)b)->bb;
+	cpFloat x1 = bb1.l + bb1.r, x2 = bb2.l + bb2.r;
+	return (x1 < x2 ? -1 : (x1 > x2 ? 1 : 0));
+}
+
+static int
+CompareY(const void *a, const void *b)
+{
+	cpBB bb1 = (*(cpShape **)a)->bb, bb2 = (*(cpShape **)b)->bb;
+	cpFloat y1 = bb1.b + bb1.t, y2 = bb2.b + bb2.t;
+	return (y1 < y2 ? -1 : (y1 > y2 ? 1 : 0));
+}
+
+// Build the subtree for the children in [start, end) starting at 'index'.
+// Returns the index after the last node of the subtree.
+static int
+BuildNodes(cpCompoundShape *compound, int start, int end, int index)
+{
+	cpShape **shapes = compound->shapes;
+	
+	cpBB bb = shapes[start]->bb;
+	for(int i=start + 1; i<end; i++) bb = cpBBMerge(bb, shapes[i]->bb);
+	
+	struct cpCompoundNode *node = compound->nodes + index;
+	node->bb = bb;
+	node->start = start;
+	node->end = end;
+	
+	if(NodeIsLeaf(node)){
+		return (node->skip = index + 1);
+	} else {
+		// Split the children in half along the longest axis of the node.
+		cpBool splitX = (bb.r - bb.l > bb.t - bb.b);
+		qsort(shapes + start, end - start, sizeof(cpShape *), splitX ? CompareX : CompareY);
+		
+		int mid = (start + end)/2;
+		int right = BuildNodes(compound, start, mid, index + 1);
+		int next = BuildNodes(compound, mid, end, right);
+		
+		return (compound->nodes[index].skip = next);
+	}
+}
+
+cpCompoundShape *
+cpCompoundShapeInit(cpCompoundShape *compound, cpBody *body, int count, cpShape **shapes)
+{
+	cpAssertHard(count > 0, "A compound shape needs at least 1 child shape.");
+	
+	compound->count = count;
+	compound->transform = cpTransformIdentity;
+	
+	compound->shapes = (cpShape **)cpcalloc(count, sizeof(cpShape *));
+	memcpy(compound->shapes, shapes, count*sizeof(cpShape *));
+	
+	for(int i=0; i<count; i++){
+		cpShape *child = shapes[i];
+		cpAssertHard(child->klass->type != CP_COMPOUND_SHAPE, "Compound shapes cannot be nested.");
+		cpAssertHard(!child->space && !cpShapeActive(child), "The children of a compound shape must not be added to a space.");
+		
+		child->body = body;
+		// The hierarchy is built in body coordinates.
+		cpShapeUpdate(child, cpTransformIdentity);
+	}
+	
+	// Halving the child ranges produces fewer than 2*count nodes.
+	compound->nodes = (struct cpCompoundNode *)cpcalloc(2*count, sizeof(struct cpCompoundNode));
+	compound->nodeCount = BuildNodes(compound, 0, count, 0);
+	
+	cpShapeInit((cpShape *)compound, &cpCompoundShapeClass, body, cpCompoundShapeMassInfo(count, compound->shapes));
+	
+	return compound;
+}
+
+cpShape *
+cpCompoundShapeNew(cpBody *body, int count, cpShape **shapes)
+{
+	return (cpShape *)cpCompoundShapeInit(cpCompoundShapeAlloc(), body, count, shapes);
+}
+
+int
+cpCompoundShapeGetCount(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpCompoundShapeClass, "Shape is not a compound shape.");
+	return ((cpCompoundShape *)shape)->count;
+}
+
+cpShape *
+cpCompoundShapeGetShape(const cpShape *shape, int i)
+{
+	cpAssertHard(shape->klass == &cpCompoundShapeClass, "Shape is not a compound shape.");
+	
+	int count = cpCompoundShapeGetCount(shape);
+	cpAssertHard(0 <= i && i < count, "Index out of range.");
+	
+	return ((cpCompoundShape *)shape)->shapes[i];
+}
@@ -49,8 +49,8 @@ preStep(cpDampedRotarySpring *spring, cpFloat dt)
 
 static void applyCachedImpulse(cpDampedRotarySpring *spring, cpFloat dt_coef){}
 
-static void
-applyImpulse(cpDampedRotarySpring *spring, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpDampedRotarySpring *spring, cpFloat dt)
 {
 	cpBody *a = spring->constraint.a;
 	cpBody *b = spring->constraint.b;
@@ -69,6 +69,8 @@ applyImpulse(cpDampedRotarySpring *spring, cpFloat dt)
 	
 	a->w += j_damp*a->i_inv;
 	b->w -= j_damp*b->i_inv;
+	
+	return cpfabs(j_damp);
 }
 
 static cpFloat
@@ -77,11 +79,17 @@ getImpulse(cpDampedRotarySpring *spring)
 	return spring->jAcc;
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpDampedRotarySpring)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpDampedRotarySpring *
@@ -54,8 +54,8 @@ preStep(cpDampedSpring *spring, cpFloat dt)
 
 static void applyCachedImpulse(cpDampedSpring *spring, cpFloat dt_coef){}
 
-static void
-applyImpulse(cpDampedSpring *spring, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpDampedSpring *spring, cpFloat dt)
 {
 	cpBody *a = spring->constraint.a;
 	cpBody *b = spring->constraint.b;
@@ -74,6 +74,8 @@ applyImpulse(cpDampedSpring *spring, cpFloat dt)
 	cpFloat j_damp = v_damp*spring->nMass;
 	spring->jAcc += j_damp;
 	apply_impulses(a, b, spring->r1, spring->r2, cpvmult(spring->n, j_damp));
+	
+	return cpfabs(j_damp);
 }
 
 static cpFloat
@@ -82,11 +84,17 @@ getImpulse(cpDampedSpring *spring)
 	return spring->jAcc;
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpDampedSpring)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpDampedSpring *
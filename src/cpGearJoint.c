@@ -46,8 +46,8 @@ applyCachedImpulse(cpGearJoint *joint, cpFloat dt_coef)
 	b->w += j*b->i_inv;
 }
 
-static void
-applyImpulse(cpGearJoint *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpGearJoint *joint, cpFloat dt)
 {
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -66,6 +66,8 @@ applyImpulse(cpGearJoint *joint, cpFloat dt)
 	// apply impulse
 	a->w -= j*a->i_inv*joint->ratio_inv;
 	b->w += j*b->i_inv;
+	
+	return cpfabs(j);
 }
 
 static cpFloat
@@ -74,11 +76,17 @@ getImpulse(cpGearJoint *joint)
 	return cpfabs(joint->jAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpGearJoint)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpGearJoint *
@@ -76,8 +76,8 @@ grooveConstrain(cpGrooveJoint *joint, cpVect j, cpFloat dt){
 	return cpvclamp(jClamp, joint->constraint.maxForce*dt);
 }
 
-static void
-applyImpulse(cpGrooveJoint *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpGrooveJoint *joint, cpFloat dt)
 {
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -95,6 +95,8 @@ applyImpulse(cpGrooveJoint *joint, cpFloat dt)
 	
 	// apply impulse
 	apply_impulses(a, b, joint->r1, joint->r2, j);
+	
+	return cpvlength(j);
 }
 
 static cpFloat
@@ -103,11 +105,17 @@ getImpulse(cpGrooveJoint *joint)
 	return cpvlength(joint->jAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpGrooveJoint)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpGrooveJoint *
@@ -3,13 +3,18 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 //TODO: Move all the thread stuff to another file
 
 //#include <sys/param.h >
 #ifndef _WIN32
+#ifdef __APPLE__
 #include <sys/sysctl.h>
+#endif
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 #else
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -286,6 +291,12 @@ vmake(cpFloat_t x, cpFloat_t y)
 static void
 cpArbiterApplyImpulse_NEON(cpArbiter *arb)
 {
+	// Manifolds solved as a 2x2 block don't have a vectorized version.
+	if(arb->blockSolve){
+		cpArbiterApplyImpulse(arb);
+		return;
+	}
+	
 	cpBody *a = arb->body_a;
 	cpBody *b = arb->body_b;
 	cpFloatx2_t surface_vr = vld((cpFloat_t *)&arb->surface_vr);
@@ -374,41 +385,400 @@ cpArbiterApplyImpulse_NEON(cpArbiter *arb)
 
 #endif
 
+//MARK: x86 SSE Solver
+
+#if !__ARM_NEON__ && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CP_HASTY_USE_SSE 1
+#include <emmintrin.h>
+
+#if defined(__GNUC__)
+	#define CP_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+	#define CP_ALWAYS_INLINE inline
+#endif
+
+// These mirror the NEON intrinsics used above so the two kernels can be compared line by line.
+// Single precision only uses the lower two lanes of each register.
+#if CP_USE_DOUBLES
+	typedef double cpFloat_t;
+	typedef __m128d cpFloatx2_t;
+	
+	static CP_ALWAYS_INLINE cpFloatx2_t vld(const cpFloat_t *p){return _mm_loadu_pd(p);}
+	static CP_ALWAYS_INLINE void vst(cpFloat_t *p, cpFloatx2_t v){_mm_storeu_pd(p, v);}
+	static CP_ALWAYS_INLINE void vst_lane0(cpFloat_t *p, cpFloatx2_t v){_mm_store_sd(p, v);}
+	static CP_ALWAYS_INLINE void vst_lane1(cpFloat_t *p, cpFloatx2_t v){_mm_storeh_pd(p, v);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmake(cpFloat_t x, cpFloat_t y){return _mm_set_pd(y, x);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vdup_n(cpFloat_t x){return _mm_set1_pd(x);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vadd(cpFloatx2_t a, cpFloatx2_t b){return _mm_add_pd(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vsub(cpFloatx2_t a, cpFloatx2_t b){return _mm_sub_pd(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmul(cpFloatx2_t a, cpFloatx2_t b){return _mm_mul_pd(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmin(cpFloatx2_t a, cpFloatx2_t b){return _mm_min_pd(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmax(cpFloatx2_t a, cpFloatx2_t b){return _mm_max_pd(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vrev(cpFloatx2_t a){return _mm_shuffle_pd(a, a, 1);}
+	static CP_ALWAYS_INLINE cpFloat_t vget_lane0(cpFloatx2_t a){return _mm_cvtsd_f64(a);}
+	static CP_ALWAYS_INLINE cpFloat_t vget_lane1(cpFloatx2_t a){return _mm_cvtsd_f64(_mm_unpackhi_pd(a, a));}
+	
+	// {a0 + a1, b0 + b1}
+	static CP_ALWAYS_INLINE cpFloatx2_t vpadd(cpFloatx2_t a, cpFloatx2_t b){
+		return _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b));
+	}
+#else
+	typedef float cpFloat_t;
+	typedef __m128 cpFloatx2_t;
+	
+	static CP_ALWAYS_INLINE cpFloatx2_t vld(const cpFloat_t *p){return _mm_castpd_ps(_mm_load_sd((const double *)p));}
+	static CP_ALWAYS_INLINE void vst(cpFloat_t *p, cpFloatx2_t v){_mm_store_sd((double *)p, _mm_castps_pd(v));}
+	static CP_ALWAYS_INLINE void vst_lane0(cpFloat_t *p, cpFloatx2_t v){_mm_store_ss(p, v);}
+	static CP_ALWAYS_INLINE void vst_lane1(cpFloat_t *p, cpFloatx2_t v){_mm_store_ss(p, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)));}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmake(cpFloat_t x, cpFloat_t y){return _mm_setr_ps(x, y, 0.0f, 0.0f);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vdup_n(cpFloat_t x){return _mm_set1_ps(x);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vadd(cpFloatx2_t a, cpFloatx2_t b){return _mm_add_ps(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vsub(cpFloatx2_t a, cpFloatx2_t b){return _mm_sub_ps(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmul(cpFloatx2_t a, cpFloatx2_t b){return _mm_mul_ps(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmin(cpFloatx2_t a, cpFloatx2_t b){return _mm_min_ps(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vmax(cpFloatx2_t a, cpFloatx2_t b){return _mm_max_ps(a, b);}
+	static CP_ALWAYS_INLINE cpFloatx2_t vrev(cpFloatx2_t a){return _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 2, 0, 1));}
+	static CP_ALWAYS_INLINE cpFloat_t vget_lane0(cpFloatx2_t a){return _mm_cvtss_f32(a);}
+	static CP_ALWAYS_INLINE cpFloat_t vget_lane1(cpFloatx2_t a){return _mm_cvtss_f32(_mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 1, 1, 1)));}
+	
+	// {a0 + a1, b0 + b1}
+	static CP_ALWAYS_INLINE cpFloatx2_t vpadd(cpFloatx2_t a, cpFloatx2_t b){
+		__m128 ab = _mm_movelh_ps(a, b);
+		return _mm_add_ps(_mm_shuffle_ps(ab, ab, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(ab, ab, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+#endif
+
+static CP_ALWAYS_INLINE cpFloatx2_t vmul_n(cpFloatx2_t a, cpFloat_t n){return vmul(a, vdup_n(n));}
+static CP_ALWAYS_INLINE cpFloatx2_t vneg(cpFloatx2_t a){return vsub(vdup_n(0.0), a);}
+
+// Applies both the contact impulses and the bias impulses for an arbiter.
+static void
+cpArbiterApplyImpulse_SSE2(cpArbiter *arb)
+{
+	// Manifolds solved as a 2x2 block don't have a vectorized version.
+	if(arb->blockSolve){
+		cpArbiterApplyImpulse(arb);
+		return;
+	}
+	
+	cpBody *a = arb->body_a;
+	cpBody *b = arb->body_b;
+	cpFloatx2_t surface_vr = vld((cpFloat_t *)&arb->surface_vr);
+	cpFloatx2_t n = vld((cpFloat_t *)&arb->n);
+	cpFloat_t friction = arb->u;
+	
+	cpFloatx2_t perp = vmake(-1.0, 1.0);
+	cpFloatx2_t nperp = vmake(1.0, -1.0);
+	cpFloatx2_t t = vmul(vrev(n), perp);
+	cpFloatx2_t i_inv = vmake(-a->i_inv, b->i_inv);
+	
+	int numContacts = arb->count;
+	struct cpContact *contacts = arb->contacts;
+	for(int i=0; i<numContacts; i++){
+		struct cpContact *con = contacts + i;
+		cpFloatx2_t r1 = vld((cpFloat_t *)&con->r1);
+		cpFloatx2_t r2 = vld((cpFloat_t *)&con->r2);
+		
+		cpFloatx2_t r1p = vmul(vrev(r1), perp);
+		cpFloatx2_t r2p = vmul(vrev(r2), perp);
+		
+		cpFloatx2_t vBias_a = vld((cpFloat_t *)&a->v_bias);
+		cpFloatx2_t vBias_b = vld((cpFloat_t *)&b->v_bias);
+		cpFloatx2_t wBias = vmake(a->w_bias, b->w_bias);
+		
+		cpFloatx2_t vb1 = vadd(vBias_a, vmul_n(r1p, vget_lane0(wBias)));
+		cpFloatx2_t vb2 = vadd(vBias_b, vmul_n(r2p, vget_lane1(wBias)));
+		cpFloatx2_t vbr = vsub(vb2, vb1);
+		
+		cpFloatx2_t v_a = vld((cpFloat_t *)&a->v);
+		cpFloatx2_t v_b = vld((cpFloat_t *)&b->v);
+		cpFloatx2_t w = vmake(a->w, b->w);
+		cpFloatx2_t v1 = vadd(v_a, vmul_n(r1p, vget_lane0(w)));
+		cpFloatx2_t v2 = vadd(v_b, vmul_n(r2p, vget_lane1(w)));
+		cpFloatx2_t vr = vsub(v2, v1);
+		
+		cpFloatx2_t vbn_vrn = vpadd(vmul(vbr, n), vmul(vr, n));
+		
+		cpFloatx2_t v_offset = vmake(con->bias, -con->bounce);
+		cpFloatx2_t jOld = vmake(con->jBias, con->jnAcc);
+		cpFloatx2_t jbn_jn = vmul_n(vsub(v_offset, vbn_vrn), con->nMass);
+		jbn_jn = vmax(vadd(jOld, jbn_jn), vdup_n(0.0));
+		cpFloatx2_t jApply = vsub(jbn_jn, jOld);
+		
+		cpFloatx2_t vrt_tmp = vmul(vadd(vr, surface_vr), t);
+		cpFloatx2_t vrt = vpadd(vrt_tmp, vrt_tmp);
+		
+		cpFloatx2_t jtOld = vmake(con->jtAcc, 0.0);
+		cpFloatx2_t jtMax = vrev(vmul_n(jbn_jn, friction));
+		cpFloatx2_t jt = vmul_n(vrt, -con->tMass);
+		jt = vmax(vneg(jtMax), vmin(vadd(jtOld, jt), jtMax));
+		cpFloatx2_t jtApply = vsub(jt, jtOld);
+		
+		cpFloatx2_t jBias = vmul_n(n, vget_lane0(jApply));
+		cpFloatx2_t jBiasCross = vmul(vrev(jBias), nperp);
+		cpFloatx2_t biasCrosses = vpadd(vmul(r1, jBiasCross), vmul(r2, jBiasCross));
+		wBias = vadd(wBias, vmul(i_inv, biasCrosses));
+		
+		vBias_a = vsub(vBias_a, vmul_n(jBias, a->m_inv));
+		vBias_b = vadd(vBias_b, vmul_n(jBias, b->m_inv));
+		
+		cpFloatx2_t j = vadd(vmul_n(n, vget_lane1(jApply)), vmul_n(t, vget_lane0(jtApply)));
+		cpFloatx2_t jCross = vmul(vrev(j), nperp);
+		cpFloatx2_t crosses = vpadd(vmul(r1, jCross), vmul(r2, jCross));
+		w = vadd(w, vmul(i_inv, crosses));
+		
+		v_a = vsub(v_a, vmul_n(j, a->m_inv));
+		v_b = vadd(v_b, vmul_n(j, b->m_inv));
+		
+		vst((cpFloat_t *)&a->v_bias, vBias_a);
+		vst((cpFloat_t *)&b->v_bias, vBias_b);
+		vst_lane0((cpFloat_t *)&a->w_bias, wBias);
+		vst_lane1((cpFloat_t *)&b->w_bias, wBias);
+		
+		vst((cpFloat_t *)&a->v, v_a);
+		vst((cpFloat_t *)&b->v, v_b);
+		vst_lane0((cpFloat_t *)&a->w, w);
+		vst_lane1((cpFloat_t *)&b->w, w);
+		
+		vst_lane0((cpFloat_t *)&con->jBias, jbn_jn);
+		vst_lane1((cpFloat_t *)&con->jnAcc, jbn_jn);
+		vst_lane0((cpFloat_t *)&con->jtAcc, jt);
+	}
+}
+
+#endif
+
+static inline void
+ApplyArbiterImpulse(cpArbiter *arb)
+{
+#if __ARM_NEON__
+	cpArbiterApplyImpulse_NEON(arb);
+#elif CP_HASTY_USE_SSE
+	cpArbiterApplyImpulse_SSE2(arb);
+#else
+	cpArbiterApplyImpulse(arb);
+#endif
+}
+
+// The vectorized solvers don't report how much the impulses changed, so compare the accumulated impulses instead.
+static inline cpFloat
+ArbiterApplyImpulseDelta(cpArbiter *arb)
+{
+	struct cpContact *contacts = arb->contacts;
+	cpFloat jBias[CP_MAX_CONTACTS_PER_ARBITER], jnAcc[CP_MAX_CONTACTS_PER_ARBITER], jtAcc[CP_MAX_CONTACTS_PER_ARBITER];
+	
+	for(int i=0; i<arb->count; i++){
+		jBias[i] = contacts[i].jBias;
+		jnAcc[i] = contacts[i].jnAcc;
+		jtAcc[i] = contacts[i].jtAcc;
+	}
+	
+	ApplyArbiterImpulse(arb);
+	
+	cpFloat delta = 0.0f;
+	for(int i=0; i<arb->count; i++){
+		delta = cpfmax(delta, cpfabs(contacts[i].jBias - jBias[i]));
+		delta = cpfmax(delta, cpfabs(contacts[i].jnAcc - jnAcc[i]));
+		delta = cpfmax(delta, cpfabs(contacts[i].jtAcc - jtAcc[i]));
+	}
+	
+	return delta;
+}
+
 //MARK: PThreads
 
-// Right now using more than 2 threads probably wont help your performance any.
-// If you are using a ridiculous number of iterations it could help though.
-#define MAX_THREADS 2
+// Maximum number of batches the colored solver will generate.
+// Anything that doesn't fit into a batch gets solved serially by the main thread.
+#define MAX_COLORS 64
+
+//MARK: Atomics
+
+#ifdef _WIN32
+	typedef volatile LONG cpAtomicInt;
+	
+	static inline long cpAtomicLoad(cpAtomicInt *ptr){return InterlockedCompareExchange(ptr, 0, 0);}
+	static inline void cpAtomicStore(cpAtomicInt *ptr, long value){InterlockedExchange(ptr, value);}
+	static inline long cpAtomicIncrement(cpAtomicInt *ptr){return InterlockedIncrement(ptr);}
+	static inline long cpAtomicDecrement(cpAtomicInt *ptr){return InterlockedDecrement(ptr);}
+	static inline void cpSpinPause(void){YieldProcessor();}
+	static inline void cpThreadYield(void){SwitchToThread();}
+#else
+	typedef volatile long cpAtomicInt;
+	
+	// Sequentially consistent to match the Interlocked functions. The thread pool relies on this for sleeping workers.
+	static inline long cpAtomicLoad(cpAtomicInt *ptr){return __atomic_load_n(ptr, __ATOMIC_SEQ_CST);}
+	static inline void cpAtomicStore(cpAtomicInt *ptr, long value){__atomic_store_n(ptr, value, __ATOMIC_SEQ_CST);}
+	static inline long cpAtomicIncrement(cpAtomicInt *ptr){return __atomic_add_fetch(ptr, 1, __ATOMIC_SEQ_CST);}
+	static inline long cpAtomicDecrement(cpAtomicInt *ptr){return __atomic_sub_fetch(ptr, 1, __ATOMIC_SEQ_CST);}
+	
+	static inline void cpSpinPause(void){
+	#if defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+	#elif defined(__aarch64__) || defined(__arm__)
+		__asm__ __volatile__("yield");
+	#endif
+	}
+	
+	static inline void cpThreadYield(void){sched_yield();}
+#endif
+
+// Number of times to spin before yielding the thread while waiting.
+#define SPIN_COUNT 1024
+
+// Number of times an idle worker yields before going to sleep on the condition variable.
+// Work is usually dispatched several times per step, so workers stay awake between the solver phases.
+#define YIELD_COUNT 256
+
+// Reusable spin barrier used to keep worker threads in lockstep.
+typedef struct cpBarrier {
+	cpAtomicInt count;
+	cpAtomicInt generation;
+} cpBarrier;
+
+static void
+cpBarrierWait(cpBarrier *barrier, unsigned long thread_count)
+{
+	if(thread_count <= 1) return;
+	
+	long generation = cpAtomicLoad(&barrier->generation);
+	
+	if((unsigned long)cpAtomicIncrement(&barrier->count) == thread_count){
+		// Last thread to arrive resets the count and releases everybody else.
+		cpAtomicStore(&barrier->count, 0);
+		cpAtomicIncrement(&barrier->generation);
+	} else {
+		for(unsigned long spins = 0; cpAtomicLoad(&barrier->generation) == generation; spins++){
+			if(spins < SPIN_COUNT){
+				cpSpinPause();
+			} else {
+				cpThreadYield();
+			}
+		}
+	}
+}
 
 struct ThreadContext {
 	pthread_t thread;
 	cpHastySpace *space;
 	unsigned long thread_num;
+	
+	// Work generation at the time the thread was created.
+	long generation;
 };
 
 typedef	void (*cpHastySpaceWorkFunction)(cpSpace *space, unsigned long worker, unsigned long worker_count);
 
+// Broadphase pair waiting for the narrowphase.
+// Each pair has its own contact storage so threads never write to shared memory.
+struct NarrowphasePair {
+	cpShape *a, *b;
+	cpCollisionID id;
+	struct cpSeparation *separation;
+	// Where the updated collision ID is kept for the next step.
+	struct cpPairID *pairID;
+	
+	struct cpCollisionInfo info;
+	struct cpContact contacts[CP_MAX_CONTACTS_PER_ARBITER];
+};
+
 struct cpHastySpace {
 	cpSpace space;
 	
 	// Number of worker threads (including the main thread)
 	unsigned long num_threads;
 	
-	// Number of worker threads currently executing. (also including the main thread)
-	unsigned long num_working;
+	// Number of worker threads still executing the current work function. (not including the main thread)
+	cpAtomicInt num_working;
+	
+	// Incremented each time work is dispatched. Workers spin on this to wait for work.
+	cpAtomicInt work_generation;
+	
+	// Number of worker threads blocked on cond_work.
+	cpAtomicInt num_sleeping;
 	
 	// Number of constraints (plus contacts) that must exist per step to start the worker threads.
 	unsigned long constraint_count_threshold;
 	
+	// Number of broadphase pairs that must exist per step to run the narrowphase on the worker threads.
+	unsigned long pair_count_threshold;
+	
+	// Only used to put idle workers to sleep so they don't burn CPU between steps.
 	pthread_mutex_t mutex;
-	pthread_cond_t cond_work, cond_resume;
+	pthread_cond_t cond_work;
 	
 	// Work function to invoke.
 	cpHastySpaceWorkFunction work;
 	
-	struct ThreadContext workers[MAX_THREADS - 1];
+	// Contexts for the (num_threads - 1) worker threads.
+	struct ThreadContext *workers;
+	
+	cpHastySpaceSolverMode solver_mode;
+	
+	// Barrier used to separate the batches in the colored solver.
+	cpBarrier barrier;
+	
+	// Arbiters and constraints sorted by color.
+	// The ranges for color i are [offsets[i], offsets[i + 1]).
+	// The extra color at index MAX_COLORS is the overflow batch.
+	cpArray *colored_arbiters;
+	cpArray *colored_constraints;
+	int arbiter_offsets[MAX_COLORS + 2];
+	int constraint_offsets[MAX_COLORS + 2];
+	
+	// Scratch array of the colors assigned to each arbiter and constraint.
+	int *colors;
+	int colors_capacity;
+	
+	// Pairs found by the broadphase this step, in the order they were found.
+	struct NarrowphasePair *pairs;
+	int pair_count, pair_capacity;
+	
+	// Arbiters and constraints sorted by island.
+	// The ranges for island i are [offsets[i], offsets[i + 1]).
+	cpArray *island_arbiters;
+	cpArray *island_constraints;
+	int *island_arbiter_offsets;
+	int *island_constraint_offsets;
+	int island_count, island_capacity;
+	
+	// Queue of bodies used while flood filling the islands.
+	cpBody **island_bodies;
+	int island_bodies_capacity;
+	
+	// Index of the next island for a worker to claim.
+	cpAtomicInt next_island;
+	
+	// Number of iterations each island needed to converge.
+	int *island_iterations;
 };
 
+static long
+WaitForWork(cpHastySpace *hasty, long generation)
+{
+	// Spin for a short while first since the next dispatch is usually only microseconds away.
+	for(unsigned long spins = 0; spins < SPIN_COUNT + YIELD_COUNT; spins++){
+		long next = cpAtomicLoad(&hasty->work_generation);
+		if(next != generation) return next;
+		
+		if(spins < SPIN_COUNT){
+			cpSpinPause();
+		} else {
+			cpThreadYield();
+		}
+	}
+	
+	// Nothing showed up, go to sleep until RunWorkers() wakes us.
+	pthread_mutex_lock(&hasty->mutex); {
+		cpAtomicIncrement(&hasty->num_sleeping);
+		while(cpAtomicLoad(&hasty->work_generation) == generation){
+			pthread_cond_wait(&hasty->cond_work, &hasty->mutex);
+		}
+		cpAtomicDecrement(&hasty->num_sleeping);
+	} pthread_mutex_unlock(&hasty->mutex);
+	
+	return cpAtomicLoad(&hasty->work_generation);
+}
+
 static void *
 WorkerThreadLoop(struct ThreadContext *context)
 {
@@ -417,18 +787,15 @@ WorkerThreadLoop(struct ThreadContext *context)
 	unsigned long thread = context->thread_num;
 	unsigned long num_threads = hasty->num_threads;
 	
+	long generation = context->generation;
+	
 	for(;;){
-		pthread_mutex_lock(&hasty->mutex); {
-			if(--hasty->num_working == 0){
-				pthread_cond_signal(&hasty->cond_resume);
-			}
-			
-			pthread_cond_wait(&hasty->cond_work, &hasty->mutex);
-		} pthread_mutex_unlock(&hasty->mutex);
+		generation = WaitForWork(hasty, generation);
 		
 		cpHastySpaceWorkFunction func = hasty->work;
 		if(func){
-			hasty->work(&hasty->space, thread, num_threads);
+			func(&hasty->space, thread, num_threads);
+			cpAtomicDecrement(&hasty->num_working);
 		} else {
 			break;
 		}
@@ -438,23 +805,35 @@ WorkerThreadLoop(struct ThreadContext *context)
 }
 
 static void
-RunWorkers(cpHastySpace *hasty, cpHastySpaceWorkFunction func)
+DispatchWork(cpHastySpace *hasty, cpHastySpaceWorkFunction func)
 {
-	hasty->num_working = hasty->num_threads - 1;
 	hasty->work = func;
+	cpAtomicStore(&hasty->num_working, hasty->num_threads - 1);
+	cpAtomicIncrement(&hasty->work_generation);
 	
-	if(hasty->num_working > 0){
+	// Only pay for the mutex when a worker actually went to sleep.
+	if(cpAtomicLoad(&hasty->num_sleeping) > 0){
 		pthread_mutex_lock(&hasty->mutex); {
 			pthread_cond_broadcast(&hasty->cond_work);
 		} pthread_mutex_unlock(&hasty->mutex);
-		
+	}
+}
+
+static void
+RunWorkers(cpHastySpace *hasty, cpHastySpaceWorkFunction func)
+{
+	if(hasty->num_threads > 1){
+		DispatchWork(hasty, func);
 		func((cpSpace *)hasty, 0, hasty->num_threads);
-			
-		pthread_mutex_lock(&hasty->mutex); {
-			if(hasty->num_working > 0){
-				pthread_cond_wait(&hasty->cond_resume, &hasty->mutex);
+		
+		// Wait for the workers to finish.
+		for(unsigned long spins = 0; cpAtomicLoad(&hasty->num_working) > 0; spins++){
+			if(spins < SPIN_COUNT){
+				cpSpinPause();
+			} else {
+				cpThreadYield();
 			}
-		} pthread_mutex_unlock(&hasty->mutex);
+		}
 	} else {
 		func((cpSpace *)hasty, 0, hasty->num_threads);
 	}
@@ -462,10 +841,10 @@ RunWorkers(cpHastySpace *hasty, cpHastySpaceWorkFunction func)
 	hasty->work = NULL;
 }
 
+
 static void
 Solver(cpSpace *space, unsigned long worker, unsigned long worker_count)
 {
-	cpArray *constraints = space->constraints;
 	cpArray *arbiters = space->arbiters;
 	
 	cpFloat dt = space->curr_dt;
@@ -473,35 +852,473 @@ Solver(cpSpace *space, unsigned long worker, unsigned long worker_count)
 	
 	for(unsigned long i=0; i<iterations; i++){
 		for(int j=0; j<arbiters->num; j++){
-			cpArbiter *arb = (cpArbiter *)arbiters->arr[j];
-			#ifdef __ARM_NEON__
-				cpArbiterApplyImpulse_NEON(arb);
-			#else
-				cpArbiterApplyImpulse(arb);
-			#endif
+			ApplyArbiterImpulse((cpArbiter *)arbiters->arr[j]);
+		}
+		
+		cpSpaceApplyConstraintImpulses(space, dt);
+	}
+}
+
+// Single threaded version of Solver() that stops once the impulses converge.
+static int
+ConvergingSolver(cpSpace *space)
+{
+	cpArray *arbiters = space->arbiters;
+	
+	cpFloat dt = space->curr_dt;
+	
+	int iterations = 0;
+	while(iterations < space->iterations){
+		cpFloat delta = 0.0f;
+		for(int j=0; j<arbiters->num; j++){
+			delta = cpfmax(delta, ArbiterApplyImpulseDelta((cpArbiter *)arbiters->arr[j]));
 		}
+		
+		delta = cpfmax(delta, cpSpaceApplyConstraintImpulses(space, dt));
+		iterations++;
+		
+		if(delta < space->solverTolerance) break;
+	}
+	
+	return iterations;
+}
+
+//MARK: Colored Solver
+
+static inline cpBool
+BodyIsColored(cpBody *body)
+{
+	// Only dynamic bodies have their velocities modified by the solver.
+	return (cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC);
+}
+
+static inline int
+ColorForBodies(cpBody *a, cpBody *b)
+{
+	cpBool colorA = BodyIsColored(a), colorB = BodyIsColored(b);
+	uint64_t used = (colorA ? a->solver.colors : 0) | (colorB ? b->solver.colors : 0);
+	
+	// Find the lowest color that neither body uses yet.
+	int color = 0;
+	while(color < MAX_COLORS && (used & ((uint64_t)1 << color))) color++;
+	
+	if(color < MAX_COLORS){
+		uint64_t bit = (uint64_t)1 << color;
+		if(colorA) a->solver.colors |= bit;
+		if(colorB) b->solver.colors |= bit;
+	}
+	
+	return color;
+}
+
+static void
+ColoredArraySort(cpArray *src, cpArray *dst, int *colors, int *offsets)
+{
+	if(dst->max < src->num){
+		dst->max = src->num;
+		dst->arr = (void **)cprealloc(dst->arr, dst->max*sizeof(void*));
+	}
+	dst->num = src->num;
+	
+	// Counting sort by color. Stable, so the order is deterministic.
+	for(int i=0; i<MAX_COLORS + 2; i++) offsets[i] = 0;
+	for(int i=0; i<src->num; i++) offsets[colors[i] + 1]++;
+	for(int i=0; i<MAX_COLORS + 1; i++) offsets[i + 1] += offsets[i];
+	
+	int cursor[MAX_COLORS + 1];
+	for(int i=0; i<MAX_COLORS + 1; i++) cursor[i] = offsets[i];
+	for(int i=0; i<src->num; i++) dst->arr[cursor[colors[i]]++] = src->arr[i];
+}
+
+// Partition the arbiters and constraints into batches where no two items share a dynamic body.
+// Items within a batch can then be solved concurrently without racing on body velocities.
+static void
+ColorSolverGraph(cpHastySpace *hasty)
+{
+	cpSpace *space = (cpSpace *)hasty;
+	cpArray *arbiters = space->arbiters;
+	cpArray *constraints = space->constraints;
+	
+	int count = arbiters->num + constraints->num;
+	if(hasty->colors_capacity < count){
+		hasty->colors_capacity = count;
+		hasty->colors = (int *)cprealloc(hasty->colors, count*sizeof(int));
+	}
+	
+	// Clear the color masks of all the bodies involved.
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		arb->body_a->solver.colors = arb->body_b->solver.colors = 0;
+	}
+	
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		constraint->a->solver.colors = constraint->b->solver.colors = 0;
+	}
+	
+	// Greedily assign colors in order. Arbiters and constraints share the body masks,
+	// so a batch's arbiters and constraints are also independent of each other.
+	int *arbiterColors = hasty->colors;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		arbiterColors[i] = ColorForBodies(arb->body_a, arb->body_b);
+	}
+	
+	int *constraintColors = hasty->colors + arbiters->num;
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		constraintColors[i] = ColorForBodies(constraint->a, constraint->b);
+	}
+	
+	ColoredArraySort(arbiters, hasty->colored_arbiters, arbiterColors, hasty->arbiter_offsets);
+	ColoredArraySort(constraints, hasty->colored_constraints, constraintColors, hasty->constraint_offsets);
+}
+
+static inline void
+RangeForWorker(int start, int end, unsigned long worker, unsigned long worker_count, int *range_start, int *range_end)
+{
+	int count = end - start;
+	*range_start = start + (int)((count*worker)/worker_count);
+	*range_end = start + (int)((count*(worker + 1))/worker_count);
+}
+
+static void
+ColoredSolver(cpSpace *space, unsigned long worker, unsigned long worker_count)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpArbiter **arbiters = (cpArbiter **)hasty->colored_arbiters->arr;
+	cpConstraint **constraints = (cpConstraint **)hasty->colored_constraints->arr;
+	int *arbiter_offsets = hasty->arbiter_offsets;
+	int *constraint_offsets = hasty->constraint_offsets;
+	
+	cpFloat dt = space->curr_dt;
+	
+	for(int i=0; i<space->iterations; i++){
+		for(int color=0; color<MAX_COLORS; color++){
+			int arbiters_start = arbiter_offsets[color], arbiters_end = arbiter_offsets[color + 1];
+			int constraints_start = constraint_offsets[color], constraints_end = constraint_offsets[color + 1];
 			
-		for(int j=0; j<constraints->num; j++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
-			constraint->klass->applyImpulse(constraint, dt);
+			// Colors are assigned lowest first, so the first empty one marks the end.
+			if(arbiters_start == arbiters_end && constraints_start == constraints_end) break;
+			
+			int start, end;
+			RangeForWorker(arbiters_start, arbiters_end, worker, worker_count, &start, &end);
+			for(int j=start; j<end; j++) ApplyArbiterImpulse(arbiters[j]);
+			
+			RangeForWorker(constraints_start, constraints_end, worker, worker_count, &start, &end);
+			for(int j=start; j<end; j++){
+				cpConstraint *constraint = constraints[j];
+				constraint->klass->applyImpulse(constraint, dt);
+			}
+			
+			cpBarrierWait(&hasty->barrier, worker_count);
 		}
+		
+		// Solve the overflow batch serially.
+		int arbiters_start = arbiter_offsets[MAX_COLORS], arbiters_end = arbiter_offsets[MAX_COLORS + 1];
+		int constraints_start = constraint_offsets[MAX_COLORS], constraints_end = constraint_offsets[MAX_COLORS + 1];
+		if(arbiters_start != arbiters_end || constraints_start != constraints_end){
+			if(worker == 0){
+				for(int j=arbiters_start; j<arbiters_end; j++) ApplyArbiterImpulse(arbiters[j]);
+				
+				for(int j=constraints_start; j<constraints_end; j++){
+					cpConstraint *constraint = constraints[j];
+					constraint->klass->applyImpulse(constraint, dt);
+				}
+			}
+			
+			cpBarrierWait(&hasty->barrier, worker_count);
+		}
+	}
+}
+
+//MARK: Island Solver
+
+static inline cpBool
+BodyIsIslandNode(cpBody *body)
+{
+	// Static and kinematic bodies aren't affected by impulses, so they don't join islands together.
+	return (cpBodyGetType(body) == CP_BODY_TYPE_DYNAMIC && !cpBodyIsSleeping(body));
+}
+
+static inline void
+IslandVisit(cpHastySpace *hasty, cpBody *body, int island, int *tail)
+{
+	if(BodyIsIslandNode(body) && body->solver.island < 0){
+		body->solver.island = island;
+		hasty->island_bodies[(*tail)++] = body;
 	}
 }
 
+// Flood fill the island containing root using a breadth first search of the contact graph.
+static void
+IslandFloodFill(cpHastySpace *hasty, cpBody *root, int island)
+{
+	int tail = 0;
+	IslandVisit(hasty, root, island, &tail);
+	
+	for(int head=0; head<tail; head++){
+		cpBody *body = hasty->island_bodies[head];
+		CP_BODY_FOREACH_ARBITER(body, arb) IslandVisit(hasty, (body == arb->body_a ? arb->body_b : arb->body_a), island, &tail);
+		CP_BODY_FOREACH_CONSTRAINT(body, constraint) IslandVisit(hasty, (body == constraint->a ? constraint->b : constraint->a), island, &tail);
+	}
+}
+
+static inline int
+IslandForBodies(cpHastySpace *hasty, cpBody *a, cpBody *b)
+{
+	cpBody *body = (BodyIsIslandNode(a) ? a : b);
+	if(!BodyIsIslandNode(body)) return hasty->island_count++;
+	
+	if(body->solver.island < 0) IslandFloodFill(hasty, body, hasty->island_count++);
+	return body->solver.island;
+}
+
+static void
+IslandArraySort(cpArray *src, cpArray *dst, int *islands, int *offsets, int island_count)
+{
+	if(dst->max < src->num){
+		dst->max = src->num;
+		dst->arr = (void **)cprealloc(dst->arr, dst->max*sizeof(void*));
+	}
+	dst->num = src->num;
+	
+	// Counting sort by island. Stable, so each island keeps the order of the space's arrays.
+	// offsets[i + 1] is used as the insertion cursor for island i while filling.
+	for(int i=0; i<island_count + 1; i++) offsets[i] = 0;
+	for(int i=0; i<src->num; i++) offsets[islands[i] + 1]++;
+	for(int i=0; i<island_count; i++) offsets[i + 1] += offsets[i];
+	
+	for(int i=island_count; i>0; i--) offsets[i] = offsets[i - 1];
+	for(int i=0; i<src->num; i++) dst->arr[offsets[islands[i] + 1]++] = src->arr[i];
+}
+
+// Partition the arbiters and constraints into islands that share no dynamic bodies.
+// Unlike cpSpaceProcessComponents(), this runs every step whether or not sleeping is enabled.
+static void
+BuildIslands(cpHastySpace *hasty)
+{
+	cpSpace *space = (cpSpace *)hasty;
+	cpArray *bodies = space->dynamicBodies;
+	cpArray *arbiters = space->arbiters;
+	cpArray *constraints = space->constraints;
+	
+	if(hasty->island_bodies_capacity < bodies->num){
+		hasty->island_bodies_capacity = bodies->num;
+		hasty->island_bodies = (cpBody **)cprealloc(hasty->island_bodies, bodies->num*sizeof(cpBody *));
+	}
+	
+	int count = arbiters->num + constraints->num;
+	if(hasty->colors_capacity < count){
+		hasty->colors_capacity = count;
+		hasty->colors = (int *)cprealloc(hasty->colors, count*sizeof(int));
+	}
+	
+	for(int i=0; i<bodies->num; i++) ((cpBody *)bodies->arr[i])->solver.island = -1;
+	hasty->island_count = 0;
+	
+	// Islands are numbered in the order they are first found so they are deterministic.
+	int *arbiterIslands = hasty->colors;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		arbiterIslands[i] = IslandForBodies(hasty, arb->body_a, arb->body_b);
+	}
+	
+	int *constraintIslands = hasty->colors + arbiters->num;
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		constraintIslands[i] = IslandForBodies(hasty, constraint->a, constraint->b);
+	}
+	
+	int island_count = hasty->island_count;
+	if(hasty->island_capacity < island_count + 1){
+		hasty->island_capacity = 2*(island_count + 1);
+		hasty->island_arbiter_offsets = (int *)cprealloc(hasty->island_arbiter_offsets, hasty->island_capacity*sizeof(int));
+		hasty->island_constraint_offsets = (int *)cprealloc(hasty->island_constraint_offsets, hasty->island_capacity*sizeof(int));
+		hasty->island_iterations = (int *)cprealloc(hasty->island_iterations, hasty->island_capacity*sizeof(int));
+	}
+	
+	IslandArraySort(arbiters, hasty->island_arbiters, arbiterIslands, hasty->island_arbiter_offsets, island_count);
+	IslandArraySort(constraints, hasty->island_constraints, constraintIslands, hasty->island_constraint_offsets, island_count);
+	
+	cpAtomicStore(&hasty->next_island, 0);
+}
+
+static void
+IslandSolver(cpSpace *space, unsigned long worker, unsigned long worker_count)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	cpArbiter **arbiters = (cpArbiter **)hasty->island_arbiters->arr;
+	cpConstraint **constraints = (cpConstraint **)hasty->island_constraints->arr;
+	
+	cpFloat dt = space->curr_dt;
+	
+	// Workers claim whole islands and run all of the iterations on them without synchronizing.
+	for(;;){
+		int island = (int)cpAtomicIncrement(&hasty->next_island) - 1;
+		if(island >= hasty->island_count) break;
+		
+		int arbiters_start = hasty->island_arbiter_offsets[island], arbiters_end = hasty->island_arbiter_offsets[island + 1];
+		int constraints_start = hasty->island_constraint_offsets[island], constraints_end = hasty->island_constraint_offsets[island + 1];
+		
+		if(space->solverTolerance > 0.0f){
+			// Each island stops iterating as soon as it converges on its own.
+			int iterations = 0;
+			while(iterations < space->iterations){
+				cpFloat delta = 0.0f;
+				for(int j=arbiters_start; j<arbiters_end; j++) delta = cpfmax(delta, ArbiterApplyImpulseDelta(arbiters[j]));
+				
+				for(int j=constraints_start; j<constraints_end; j++){
+					cpConstraint *constraint = constraints[j];
+					delta = cpfmax(delta, cpConstraintApplyImpulseDelta(constraint, dt));
+				}
+				
+				iterations++;
+				if(delta < space->solverTolerance) break;
+			}
+			
+			hasty->island_iterations[island] = iterations;
+		} else {
+			for(int i=0; i<space->iterations; i++){
+				for(int j=arbiters_start; j<arbiters_end; j++) ApplyArbiterImpulse(arbiters[j]);
+				
+				for(int j=constraints_start; j<constraints_end; j++){
+					cpConstraint *constraint = constraints[j];
+					constraint->klass->applyImpulse(constraint, dt);
+				}
+			}
+			
+			hasty->island_iterations[island] = space->iterations;
+		}
+	}
+}
+
+//MARK: Narrowphase
+
+static cpCollisionID QueuePair(cpShape *a, cpShape *b, cpCollisionID id, cpHastySpace *hasty);
+
+struct CompoundQueueContext {
+	cpShape *other;
+	cpHastySpace *hasty;
+};
+
+static void
+CompoundChildQueue(cpShape *child, int index, struct CompoundQueueContext *context)
+{
+	QueuePair(child, context->other, 0, context->hasty);
+}
+
+// Spatial index callback that queues up pairs instead of colliding them immediately.
+static cpCollisionID
+QueuePair(cpShape *a, cpShape *b, cpCollisionID id, cpHastySpace *hasty)
+{
+	// Reject any of the simple cases
+	if(cpSpaceQueryReject(a, b)) return id;
+	
+	// Queue the overlapping children of compound shapes individually so they each get their own arbiter.
+	if(a->klass->type == CP_COMPOUND_SHAPE || b->klass->type == CP_COMPOUND_SHAPE){
+		cpCompoundShape *compound = (cpCompoundShape *)(a->klass->type == CP_COMPOUND_SHAPE ? a : b);
+		struct CompoundQueueContext context = {(compound == (cpCompoundShape *)a ? b : a), hasty};
+		cpCompoundShapeQueryShapes(compound, context.other->bb, (cpCompoundShapeIteratorFunc)CompoundChildQueue, &context);
+		return id;
+	}
+	
+	cpSpace *space = (cpSpace *)hasty;
+	struct cpSeparation *separation = NULL;
+	if(space->cacheSeparations && cpSpaceSeparationHolds(space, a, b, &separation)) return id;
+	
+	if(hasty->pair_count == hasty->pair_capacity){
+		hasty->pair_capacity = (hasty->pair_capacity ? 2*hasty->pair_capacity : 256);
+		hasty->pairs = (struct NarrowphasePair *)cprealloc(hasty->pairs, hasty->pair_capacity*sizeof(struct NarrowphasePair));
+	}
+	
+	// The updated collision ID can't be handed back to the index once the narrowphase runs later,
+	// so the space keeps it and the pair starts from it on the next step instead.
+	struct cpPairID *pairID = cpSpacePairID(space, a, b, id);
+	
+	struct NarrowphasePair *pair = hasty->pairs + hasty->pair_count++;
+	pair->a = a;
+	pair->b = b;
+	pair->id = pairID->id;
+	pair->separation = separation;
+	pair->pairID = pairID;
+	
+	return id;
+}
+
+static void
+Narrowphase(cpSpace *space, unsigned long worker, unsigned long worker_count)
+{
+	cpHastySpace *hasty = (cpHastySpace *)space;
+	
+	int start, end;
+	RangeForWorker(0, hasty->pair_count, worker, worker_count, &start, &end);
+	
+	for(int i=start; i<end; i++){
+		struct NarrowphasePair *pair = hasty->pairs + i;
+		pair->info = cpCollide(pair->a, pair->b, pair->id, pair->contacts);
+	}
+}
+
+// Copy the narrowphase results into the contact buffer and update the arbiters.
+// This runs serially in broadphase order so arbiters and callbacks are processed deterministically.
+static void
+ProcessPairs(cpHastySpace *hasty)
+{
+	cpSpace *space = (cpSpace *)hasty;
+	
+	for(int i=0; i<hasty->pair_count; i++){
+		struct cpCollisionInfo info = hasty->pairs[i].info;
+		if(space->cacheSeparations) cpSpaceCacheSeparation(space, hasty->pairs[i].separation, &info);
+		hasty->pairs[i].pairID->id = info.id;
+		
+		if(info.count == 0) continue; // Shapes are not colliding.
+		
+		struct cpContact *contacts = cpContactBufferGetArray(space);
+		memcpy(contacts, info.arr, info.count*sizeof(struct cpContact));
+		info.arr = contacts;
+		cpSpacePushContacts(space, info.count);
+		
+		cpSpaceProcessCollision(space, &info);
+	}
+	
+	hasty->pair_count = 0;
+}
+
 //MARK: Thread Management Functions
 
 static void
 HaltThreads(cpHastySpace *hasty)
 {
-	pthread_mutex_t *mutex = &hasty->mutex;
-	pthread_mutex_lock(mutex); {
-		hasty->work = NULL; // NULL work function means break and exit
-		pthread_cond_broadcast(&hasty->cond_work);
-	} pthread_mutex_unlock(mutex);
+	// NULL work function means break and exit
+	DispatchWork(hasty, NULL);
 	
 	for(unsigned long i=0; i<(hasty->num_threads-1); i++){
 		pthread_join(hasty->workers[i].thread, NULL);
 	}
+	
+	cpfree(hasty->workers);
+	hasty->workers = NULL;
+}
+
+static unsigned long
+DetectThreadCount(void)
+{
+	unsigned long threads = 1;
+	
+#if defined(__APPLE__)
+	size_t size = sizeof(threads);
+	sysctlbyname("hw.ncpu", &threads, &size, NULL, 0);
+#elif defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	threads = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	if(count > 0) threads = (unsigned long)count;
+#endif
+	
+	return (threads > 0 ? threads : 1);
 }
 
 void
@@ -516,30 +1333,20 @@ cpHastySpaceSetThreads(cpSpace *space, unsigned long threads)
 	cpHastySpace *hasty = (cpHastySpace *)space;
 	HaltThreads(hasty);
 	
-#ifdef __APPLE__
-	if(threads == 0){
-		size_t size = sizeof(threads);
-		sysctlbyname("hw.ncpu", &threads, &size, NULL, 0);
-	}
-#else
-	if(threads == 0) threads = 1;
-#endif
-	
-	hasty->num_threads = (threads < MAX_THREADS ? threads : MAX_THREADS);
-	hasty->num_working = hasty->num_threads - 1;
+	if(threads == 0) threads = DetectThreadCount();
+	hasty->num_threads = threads;
 	
-	// Create the worker threads and wait for them to signal ready.
-	if(hasty->num_working > 0){
-		pthread_mutex_lock(&hasty->mutex);
-		for(unsigned long i=0; i<(hasty->num_threads-1); i++){
+	// Create the worker threads. They wait for the work generation to change before doing anything.
+	if(threads > 1){
+		hasty->workers = (struct ThreadContext *)cpcalloc(threads - 1, sizeof(struct ThreadContext));
+		
+		for(unsigned long i=0; i<(threads-1); i++){
 			hasty->workers[i].space = hasty;
 			hasty->workers[i].thread_num = i + 1;
+			hasty->workers[i].generation = cpAtomicLoad(&hasty->work_generation);
 			
 			pthread_create(&hasty->workers[i].thread, NULL, (void*(*)(void*))WorkerThreadLoop, &hasty->workers[i]);
 		}
-		
-		pthread_cond_wait(&hasty->cond_resume, &hasty->mutex);
-		pthread_mutex_unlock(&hasty->mutex);
 	}
 }
 
@@ -549,6 +1356,18 @@ cpHastySpaceGetThreads(cpSpace *space)
 	return ((cpHastySpace *)space)->num_threads;
 }
 
+void
+cpHastySpaceSetSolverMode(cpSpace *space, cpHastySpaceSolverMode mode)
+{
+	((cpHastySpace *)space)->solver_mode = mode;
+}
+
+cpHastySpaceSolverMode
+cpHastySpaceGetSolverMode(cpSpace *space)
+{
+	return ((cpHastySpace *)space)->solver_mode;
+}
+
 //MARK: Overriden cpSpace Functions.
 
 cpSpace *
@@ -559,10 +1378,16 @@ cpHastySpaceNew(void)
 	
 	pthread_mutex_init(&hasty->mutex, NULL);
 	pthread_cond_init(&hasty->cond_work, NULL);
-	pthread_cond_init(&hasty->cond_resume, NULL);
 	
 	// TODO magic number, should test this more thoroughly.
 	hasty->constraint_count_threshold = 50;
+	hasty->pair_count_threshold = 100;
+	
+	hasty->solver_mode = CP_HASTY_SOLVER_MODE_DEFAULT;
+	hasty->colored_arbiters = cpArrayNew(0);
+	hasty->colored_constraints = cpArrayNew(0);
+	hasty->island_arbiters = cpArrayNew(0);
+	hasty->island_constraints = cpArrayNew(0);
 	
 	// Default to 1 thread for determinism.
 	hasty->num_threads = 1;
@@ -580,7 +1405,17 @@ cpHastySpaceFree(cpSpace *space)
 	
 	pthread_mutex_destroy(&hasty->mutex);
 	pthread_cond_destroy(&hasty->cond_work);
-	pthread_cond_destroy(&hasty->cond_resume);
+	
+	cpArrayFree(hasty->colored_arbiters);
+	cpArrayFree(hasty->colored_constraints);
+	cpfree(hasty->colors);
+	cpfree(hasty->pairs);
+	cpArrayFree(hasty->island_arbiters);
+	cpArrayFree(hasty->island_constraints);
+	cpfree(hasty->island_arbiter_offsets);
+	cpfree(hasty->island_constraint_offsets);
+	cpfree(hasty->island_bodies);
+	cpfree(hasty->island_iterations);
 	
 	cpSpaceFree(space);
 }
@@ -622,21 +1457,40 @@ cpHastySpaceStep(cpSpace *space, cpFloat dt)
 		// Find colliding pairs.
 		cpSpacePushFreshContactBuffer(space);
 		cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)cpShapeUpdateFunc, NULL);
-		cpSpatialIndexReindexQuery(space->dynamicShapes, (cpSpatialIndexQueryFunc)cpSpaceCollideShapes, space);
+		// Pairs are always queued, even when the narrowphase runs on one thread,
+		// so they see the same collision IDs and give the same contacts regardless of the thread count.
+		cpSpatialIndexReindexQuery(space->dynamicShapes, (cpSpatialIndexQueryFunc)QueuePair, space);
+		
+		// Run the narrowphase on the queued pairs.
+		cpHastySpace *hasty = (cpHastySpace *)space;
+		if((unsigned long)hasty->pair_count > hasty->pair_count_threshold){
+			RunWorkers(hasty, Narrowphase);
+		} else {
+			Narrowphase(space, 0, 1);
+		}
+		
+		ProcessPairs(hasty);
 	} cpSpaceUnlock(space, cpFalse);
 	
 	// Rebuild the contact graph (and detect sleeping components if sleeping is enabled)
 	cpSpaceProcessComponents(space, dt);
 	
+	// The constraints array won't change again until the step is over.
+	cpSpaceSortConstraints(space);
+	
 	cpSpaceLock(space); {
 		// Clear out old cached arbiters and call separate callbacks
 		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cpSpaceArbiterSetFilter, space);
+		// Clear out separations for pairs that weren't found this step.
+		if(space->cacheSeparations) cpHashSetFilter(space->cachedSeparations, (cpHashSetFilterFunc)cpSpaceSeparationSetFilter, space);
+		// Clear out collision IDs for pairs that weren't found this step.
+		if(cpHashSetCount(space->cachedPairIDs)) cpHashSetFilter(space->cachedPairIDs, (cpHashSetFilterFunc)cpSpacePairIDSetFilter, space);
 
 		// Prestep the arbiters and constraints.
 		cpFloat slop = space->collisionSlop;
 		cpFloat biasCoef = 1.0f - cpfpow(space->collisionBias, dt);
 		for(int i=0; i<arbiters->num; i++){
-			cpArbiterPreStep((cpArbiter *)arbiters->arr[i], dt, slop, biasCoef);
+			cpArbiterPreStep((cpArbiter *)arbiters->arr[i], dt, slop, biasCoef, space->blockSolver);
 		}
 
 		for(int i=0; i<constraints->num; i++){
@@ -644,9 +1498,9 @@ cpHastySpaceStep(cpSpace *space, cpFloat dt)
 			
 			cpConstraintPreSolveFunc preSolve = constraint->preSolve;
 			if(preSolve) preSolve(constraint, space);
-			
-			constraint->klass->preStep(constraint, dt);
 		}
+		
+		cpSpacePreStepConstraints(space, dt);
 	
 		// Integrate velocities.
 		cpFloat damping = cpfpow(space->damping, dt);
@@ -662,14 +1516,39 @@ cpHastySpaceStep(cpSpace *space, cpFloat dt)
 			cpArbiterApplyCachedImpulse((cpArbiter *)arbiters->arr[i], dt_coef);
 		}
 		
-		for(int i=0; i<constraints->num; i++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
-			constraint->klass->applyCachedImpulse(constraint, dt_coef);
-		}
+		cpSpaceApplyCachedConstraintImpulses(space, dt_coef);
 		
 		// Run the impulse solver.
 		cpHastySpace *hasty = (cpHastySpace *)space;
-		if((unsigned long)(arbiters->num + constraints->num) > hasty->constraint_count_threshold){
+		cpBool threaded = ((unsigned long)(arbiters->num + constraints->num) > hasty->constraint_count_threshold);
+		
+		space->iterationsUsed = space->iterations;
+		
+		if(hasty->solver_mode == CP_HASTY_SOLVER_MODE_COLORED){
+			// The batches are solved in the same order regardless of the thread count.
+			ColorSolverGraph(hasty);
+			if(threaded){
+				RunWorkers(hasty, ColoredSolver);
+			} else {
+				ColoredSolver(space, 0, 1);
+			}
+		} else if(hasty->solver_mode == CP_HASTY_SOLVER_MODE_ISLANDS){
+			// Islands don't share any dynamic bodies, so the result doesn't depend on which thread solves them.
+			BuildIslands(hasty);
+			if(threaded && hasty->island_count > 1){
+				RunWorkers(hasty, IslandSolver);
+			} else {
+				IslandSolver(space, 0, 1);
+			}
+			
+			// Report the iterations used by the slowest island to converge.
+			space->iterationsUsed = 0;
+			for(int i=0; i<hasty->island_count; i++){
+				if(hasty->island_iterations[i] > space->iterationsUsed) space->iterationsUsed = hasty->island_iterations[i];
+			}
+		} else if(space->solverTolerance > 0.0f && hasty->num_threads == 1){
+			space->iterationsUsed = ConvergingSolver(space);
+		} else if(threaded){
 			RunWorkers(hasty, Solver);
 		} else {
 			Solver(space, 0, 1);
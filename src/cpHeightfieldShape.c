@@ -0,0 +1,289 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+cpHeightfieldShape *
+cpHeightfieldShapeAlloc(void)
+{
+	return (cpHeightfieldShape *)cpcalloc(1, sizeof(cpHeightfieldShape));
+}
+
+static void
+cpHeightfieldShapeDestroy(cpHeightfieldShape *heightfield)
+{
+	cpfree(heightfield->heights);
+}
+
+static cpBB
+cpHeightfieldShapeCacheData(cpHeightfieldShape *heightfield, cpTransform transform)
+{
+	heightfield->transform = transform;
+	return cpTransformbBB(transform, heightfield->bb);
+}
+
+// Position of a sample in body coordinates.
+static inline cpVect
+Sample(const cpHeightfieldShape *heightfield, int i)
+{
+	return cpv(heightfield->offset.x + i*heightfield->spacing, heightfield->offset.y + heightfield->heights[i]);
+}
+
+// Bounding box of a column in body coordinates.
+static inline cpBB
+ColumnBB(const cpHeightfieldShape *heightfield, int column)
+{
+	cpVect a = Sample(heightfield, column), b = Sample(heightfield, column + 1);
+	cpFloat r = heightfield->r;
+	return cpBBNew(a.x - r, cpfmin(a.y, b.y) - r, b.x + r, cpfmax(a.y, b.y) + r);
+}
+
+void
+cpHeightfieldShapeGetColumn(const cpHeightfieldShape *heightfield, int column, cpSegmentShape *seg)
+{
+	int count = heightfield->count;
+	cpTransform transform = heightfield->transform;
+	
+	seg->shape.klass = &cpSegmentShapeClass;
+	seg->shape.body = heightfield->shape.body;
+	
+	seg->a = Sample(heightfield, column);
+	seg->b = Sample(heightfield, column + 1);
+	seg->n = cpvrperp(cpvnormalize(cpvsub(seg->b, seg->a)));
+	seg->r = heightfield->r;
+	
+	// Point the tangents at the neighboring samples so the columns are smooth where they meet.
+	seg->a_tangent = (column > 0 ? cpvsub(Sample(heightfield, column - 1), seg->a) : cpvzero);
+	seg->b_tangent = (column + 2 < count ? cpvsub(Sample(heightfield, column + 2), seg->b) : cpvzero);
+	
+	cpVect ta = seg->ta = cpTransformPoint(transform, seg->a);
+	cpVect tb = seg->tb = cpTransformPoint(transform, seg->b);
+	seg->tn = cpTransformVect(transform, seg->n);
+	
+	cpFloat r = seg->r;
+	seg->shape.bb = cpBBNew(cpfmin(ta.x, tb.x) - r, cpfmin(ta.y, tb.y) - r, cpfmax(ta.x, tb.x) + r, cpfmax(ta.y, tb.y) + r);
+}
+
+// Index of the column containing 'x' (in body coordinates) clamped to the valid columns.
+static inline int
+ColumnIndex(const cpHeightfieldShape *heightfield, cpFloat x)
+{
+	cpFloat columns = cpHeightfieldShapeColumnCount(heightfield);
+	return (int)cpfclamp(cpffloor((x - heightfield->offset.x)/heightfield->spacing), 0.0f, columns - 1.0f);
+}
+
+void
+cpHeightfieldShapeColumnRange(const cpHeightfieldShape *heightfield, cpBB bb, int *first, int *last)
+{
+	bb = cpTransformbBB(cpTransformInverse(heightfield->transform), bb);
+	
+	if(cpBBIntersects(heightfield->bb, bb)){
+		cpFloat r = heightfield->r;
+		(*first) = ColumnIndex(heightfield, bb.l - r);
+		(*last) = ColumnIndex(heightfield, bb.r + r) + 1;
+	} else {
+		(*first) = (*last) = 0;
+	}
+}
+
+static void
+cpHeightfieldShapePointQuery(cpHeightfieldShape *heightfield, cpVect p, cpPointQueryInfo *info)
+{
+	cpVect lp = cpTransformPoint(cpTransformInverse(heightfield->transform), p);
+	cpFloat r = heightfield->r;
+	int columns = cpHeightfieldShapeColumnCount(heightfield);
+	
+	cpPointQueryInfo closest = {NULL, cpvzero, INFINITY, cpvzero};
+	
+	// Check the column below the point first, then work outwards in both directions
+	// until the columns are too far away horizontally to be closer than the best one so far.
+	int start = ColumnIndex(heightfield, lp.x);
+	for(int dir=-1; dir<=1; dir+=2){
+		for(int i=(dir < 0 ? start : start + 1); 0 <= i && i < columns; i+=dir){
+			cpFloat left = Sample(heightfield, i).x, right = Sample(heightfield, i + 1).x;
+			if(cpfmax(cpfmax(left - lp.x, lp.x - right), 0.0f) - r >= closest.distance) break;
+			
+			cpSegmentShape seg;
+			cpHeightfieldShapeGetColumn(heightfield, i, &seg);
+			
+			cpPointQueryInfo column_info;
+			cpSegmentShapeClass.pointQuery((cpShape *)&seg, p, &column_info);
+			if(column_info.distance < closest.distance) closest = column_info;
+		}
+	}
+	
+	(*info) = closest;
+	info->shape = (cpShape *)heightfield;
+}
+
+static void
+cpHeightfieldShapeSegmentQuery(cpHeightfieldShape *heightfield, cpVect a, cpVect b, cpFloat r2, cpSegmentQueryInfo *info)
+{
+	cpTransform inverse = cpTransformInverse(heightfield->transform);
+	cpVect la = cpTransformPoint(inverse, a);
+	cpVect lb = cpTransformPoint(inverse, b);
+	
+	cpFloat r = heightfield->r + r2;
+	cpFloat dx = lb.x - la.x;
+	int first = ColumnIndex(heightfield, cpfmin(la.x, lb.x) - r);
+	int last = ColumnIndex(heightfield, cpfmax(la.x, lb.x) + r) + 1;
+	
+	// Walk the columns in the direction of the query so it can stop after the first hit.
+	int step = (dx < 0.0f ? -1 : 1);
+	for(int i=(step > 0 ? first : last - 1); first <= i && i < last; i+=step){
+		cpBB bb = ColumnBB(heightfield, i);
+		
+		// Columns are sorted along the query, so once one starts after the closest hit so far, the rest do too.
+		if(dx != 0.0f && ((step > 0 ? bb.l - r2 : bb.r + r2) - la.x)/dx > info->alpha) break;
+		if(cpBBSegmentQuery(cpBBNew(bb.l - r2, bb.b - r2, bb.r + r2, bb.t + r2), la, lb) > info->alpha) continue;
+		
+		cpSegmentShape seg;
+		cpHeightfieldShapeGetColumn(heightfield, i, &seg);
+		
+		cpSegmentQueryInfo column_info = {NULL, b, cpvzero, 1.0f};
+		cpSegmentShapeClass.segmentQuery((cpShape *)&seg, a, b, r2, &column_info);
+		if(column_info.shape && column_info.alpha < info->alpha){
+			(*info) = column_info;
+			info->shape = (cpShape *)heightfield;
+		}
+	}
+}
+
+static struct cpShapeMassInfo
+cpHeightfieldShapeMassInfo(const cpHeightfieldShape *heightfield)
+{
+	int columns = cpHeightfieldShapeColumnCount(heightfield);
+	cpFloat r = heightfield->r;
+	
+	// Like chain shapes, weight each column by its area, or by its length if the heightfield has no thickness.
+	cpFloat total = 0.0f;
+	cpVect cog = cpvzero;
+	for(int i=0; i<columns; i++){
+		cpVect a = Sample(heightfield, i), b = Sample(heightfield, i + 1);
+		cpFloat w = (r > 0.0f ? cpAreaForSegment(a, b, r) : cpvdist(a, b));
+		
+		total += w;
+		cog = cpvadd(cog, cpvmult(cpvlerp(a, b, 0.5f), w));
+	}
+	
+	cog = (total > 0.0f ? cpvmult(cog, 1.0f/total) : Sample(heightfield, 0));
+	
+	cpFloat moment = 0.0f;
+	for(int i=0; i<columns; i++){
+		cpVect a = Sample(heightfield, i), b = Sample(heightfield, i + 1);
+		cpFloat w = (r > 0.0f ? cpAreaForSegment(a, b, r) : cpvdist(a, b));
+		
+		cpFloat columnMoment = cpMomentForBox(1.0f, cpvdist(a, b) + 2.0f*r, 2.0f*r);
+		moment += w*(columnMoment + cpvdistsq(cpvlerp(a, b, 0.5f), cog));
+	}
+	
+	struct cpShapeMassInfo info = {
+		0.0f, (total > 0.0f ? moment/total : 0.0f),
+		cog,
+		(r > 0.0f ? total : 0.0f),
+	};
+	
+	return info;
+}
+
+static const cpShapeClass cpHeightfieldShapeClass = {
+	CP_HEIGHTFIELD_SHAPE,
+	(cpShapeCacheDataImpl)cpHeightfieldShapeCacheData,
+	(cpShapeDestroyImpl)cpHeightfieldShapeDestroy,
+	(cpShapePointQueryImpl)cpHeightfieldShapePointQuery,
+	(cpShapeSegmentQueryImpl)cpHeightfieldShapeSegmentQuery,
+};
+
+cpHeightfieldShape *
+cpHeightfieldShapeInit(cpHeightfieldShape *heightfield, cpBody *body, int count, const cpFloat *heights, cpFloat spacing, cpVect offset, cpFloat radius)
+{
+	cpAssertHard(count >= 2, "A heightfield shape needs at least 2 samples.");
+	cpAssertHard(spacing > 0.0f, "A heightfield shape's spacing must be positive.");
+	
+	heightfield->r = radius;
+	heightfield->count = count;
+	heightfield->spacing = spacing;
+	heightfield->offset = offset;
+	heightfield->transform = cpTransformIdentity;
+	
+	heightfield->heights = (cpFloat *)cpcalloc(count, sizeof(cpFloat));
+	memcpy(heightfield->heights, heights, count*sizeof(cpFloat));
+	
+	cpFloat min = heights[0], max = heights[0];
+	for(int i=1; i<count; i++){
+		min = cpfmin(min, heights[i]);
+		max = cpfmax(max, heights[i]);
+	}
+	
+	cpVect first = Sample(heightfield, 0), last = Sample(heightfield, count - 1);
+	heightfield->bb = cpBBNew(first.x - radius, offset.y + min - radius, last.x + radius, offset.y + max + radius);
+	
+	cpShapeInit((cpShape *)heightfield, &cpHeightfieldShapeClass, body, cpHeightfieldShapeMassInfo(heightfield));
+	
+	return heightfield;
+}
+
+cpShape *
+cpHeightfieldShapeNew(cpBody *body, int count, const cpFloat *heights, cpFloat spacing, cpVect offset, cpFloat radius)
+{
+	return (cpShape *)cpHeightfieldShapeInit(cpHeightfieldShapeAlloc(), body, count, heights, spacing, offset, radius);
+}
+
+int
+cpHeightfieldShapeGetCount(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpHeightfieldShapeClass, "Shape is not a heightfield shape.");
+	return ((cpHeightfieldShape *)shape)->count;
+}
+
+cpFloat
+cpHeightfieldShapeGetHeight(const cpShape *shape, int i)
+{
+	cpAssertHard(shape->klass == &cpHeightfieldShapeClass, "Shape is not a heightfield shape.");
+	
+	int count = cpHeightfieldShapeGetCount(shape);
+	cpAssertHard(0 <= i && i < count, "Index out of range.");
+	
+	return ((cpHeightfieldShape *)shape)->heights[i];
+}
+
+cpFloat
+cpHeightfieldShapeGetSpacing(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpHeightfieldShapeClass, "Shape is not a heightfield shape.");
+	return ((cpHeightfieldShape *)shape)->spacing;
+}
+
+cpVect
+cpHeightfieldShapeGetOffset(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpHeightfieldShapeClass, "Shape is not a heightfield shape.");
+	return ((cpHeightfieldShape *)shape)->offset;
+}
+
+cpFloat
+cpHeightfieldShapeGetRadius(const cpShape *shape)
+{
+	cpAssertHard(shape->klass == &cpHeightfieldShapeClass, "Shape is not a heightfield shape.");
+	return ((cpHeightfieldShape *)shape)->r;
+}
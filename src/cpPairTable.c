@@ -0,0 +1,143 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chipmunk/chipmunk_private.h"
+
+// Pointers to pooled objects share their low bits. Mix the high bits down to spread the pairs over the slots.
+static inline cpHashValue
+PairHash(void *a, void *b)
+{
+	cpHashValue hash = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+	hash = (hash ^ (hash >> 16))*CP_HASH_COEF;
+	return hash ^ (hash >> 16);
+}
+
+// Returns the slot holding the pair (a, b) in either order, or the empty slot where it belongs.
+static int *
+Slot(cpPairTable *table, void *a, void *b)
+{
+	int mask = table->slotCount - 1;
+	
+	for(int i = (int)(PairHash(a, b)&mask);; i = (i + 1)&mask){
+		int index = table->slots[i];
+		if(index < 0) return table->slots + i;
+		
+		struct cpPair *pair = table->pairs + index;
+		if((pair->a == a && pair->b == b) || (pair->a == b && pair->b == a)) return table->slots + i;
+	}
+}
+
+static void
+Resize(cpPairTable *table, int slotCount)
+{
+	cpfree(table->slots);
+	table->slotCount = slotCount;
+	table->slots = (int *)cpcalloc(slotCount, sizeof(int));
+	for(int i=0; i<slotCount; i++) table->slots[i] = -1;
+	
+	for(int i=0; i<table->count; i++){
+		struct cpPair *pair = table->pairs + i;
+		(*Slot(table, pair->a, pair->b)) = i;
+	}
+}
+
+void
+cpPairTableInit(cpPairTable *table)
+{
+	table->pairs = NULL;
+	table->count = table->capacity = 0;
+	table->slots = NULL;
+	table->slotCount = 0;
+}
+
+void
+cpPairTableDestroy(cpPairTable *table)
+{
+	cpfree(table->pairs);
+	cpfree(table->slots);
+}
+
+int
+cpPairTableFind(cpPairTable *table, void *a, void *b)
+{
+	return (table->count ? *Slot(table, a, b) : -1);
+}
+
+int
+cpPairTableInsert(cpPairTable *table, void *a, void *b)
+{
+	// Keep the table at most half full.
+	if(2*(table->count + 1) > table->slotCount){
+		Resize(table, table->slotCount ? 2*table->slotCount : 64);
+	}
+	
+	int *slot = Slot(table, a, b);
+	if(*slot >= 0) return *slot;
+	
+	if(table->count == table->capacity){
+		table->capacity = (table->capacity ? 2*table->capacity : 32);
+		table->pairs = (struct cpPair *)cprealloc(table->pairs, table->capacity*sizeof(struct cpPair));
+	}
+	
+	int index = table->count++;
+	struct cpPair pair = {a, b, 0};
+	table->pairs[index] = pair;
+	(*slot) = index;
+	
+	return index;
+}
+
+void
+cpPairTableRemoveIndex(cpPairTable *table, int index)
+{
+	int mask = table->slotCount - 1;
+	struct cpPair *pairs = table->pairs;
+	
+	// Empty the pair's slot, shifting back any following entries that would become unreachable.
+	int i = (int)(Slot(table, pairs[index].a, pairs[index].b) - table->slots);
+	for(int j = (i + 1)&mask; table->slots[j] >= 0; j = (j + 1)&mask){
+		struct cpPair *pair = pairs + table->slots[j];
+		int home = (int)(PairHash(pair->a, pair->b)&mask);
+		
+		// Move the entry if its home is not cyclically within (i, j].
+		if(i <= j ? (home <= i || home > j) : (home <= i && home > j)){
+			table->slots[i] = table->slots[j];
+			i = j;
+		}
+	}
+	table->slots[i] = -1;
+	
+	// Move the last pair into the hole.
+	int last = --table->count;
+	if(index != last){
+		(*Slot(table, pairs[last].a, pairs[last].b)) = index;
+		pairs[index] = pairs[last];
+	}
+}
+
+cpBool
+cpPairTableRemove(cpPairTable *table, void *a, void *b)
+{
+	int index = cpPairTableFind(table, a, b);
+	if(index >= 0) cpPairTableRemoveIndex(table, index);
+	
+	return (index >= 0);
+}
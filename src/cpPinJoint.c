@@ -52,8 +52,8 @@ applyCachedImpulse(cpPinJoint *joint, cpFloat dt_coef)
 	apply_impulses(a, b, joint->r1, joint->r2, j);
 }
 
-static void
-applyImpulse(cpPinJoint *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpPinJoint *joint, cpFloat dt)
 {
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -72,6 +72,8 @@ applyImpulse(cpPinJoint *joint, cpFloat dt)
 	
 	// apply impulse
 	apply_impulses(a, b, joint->r1, joint->r2, cpvmult(n, jn));
+	
+	return cpfabs(jn);
 }
 
 static cpFloat
@@ -80,11 +82,17 @@ getImpulse(cpPinJoint *joint)
 	return cpfabs(joint->jnAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpPinJoint)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 
@@ -47,8 +47,8 @@ applyCachedImpulse(cpPivotJoint *joint, cpFloat dt_coef)
 	apply_impulses(a, b, joint->r1, joint->r2, cpvmult(joint->jAcc, dt_coef));
 }
 
-static void
-applyImpulse(cpPivotJoint *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpPivotJoint *joint, cpFloat dt)
 {
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -67,6 +67,8 @@ applyImpulse(cpPivotJoint *joint, cpFloat dt)
 	
 	// apply impulse
 	apply_impulses(a, b, joint->r1, joint->r2, j);
+	
+	return cpvlength(j);
 }
 
 static cpFloat
@@ -75,11 +77,17 @@ getImpulse(cpConstraint *joint)
 	return cpvlength(((cpPivotJoint *)joint)->jAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpPivotJoint)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpPivotJoint *
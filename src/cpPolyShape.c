@@ -306,6 +306,9 @@ cpPolyShapeSetVertsRaw(cpShape *shape, int count, cpVect *verts)
 	cpFloat mass = shape->massInfo.m;
 	shape->massInfo = cpPolyShapeMassInfo(shape->massInfo.m, count, verts, poly->r);
 	if(mass > 0.0f) cpBodyAccumulateMassFromShapes(shape->body);
+	
+	// The shape may have grown closer to its neighbors.
+	if(shape->space) cpSpaceFilterSeparations(shape->space, shape);
 }
 
 void
@@ -320,4 +323,7 @@ cpPolyShapeSetRadius(cpShape *shape, cpFloat radius)
 //	cpFloat mass = shape->massInfo.m;
 //	shape->massInfo = cpPolyShapeMassInfo(shape->massInfo.m, poly->count, poly->verts, poly->r);
 //	if(mass > 0.0f) cpBodyAccumulateMassFromShapes(shape->body);
+	
+	// The shape may have grown closer to its neighbors.
+	if(shape->space) cpSpaceFilterSeparations(shape->space, shape);
 }
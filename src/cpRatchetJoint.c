@@ -63,10 +63,10 @@ applyCachedImpulse(cpRatchetJoint *joint, cpFloat dt_coef)
 	b->w += j*b->i_inv;
 }
 
-static void
-applyImpulse(cpRatchetJoint *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpRatchetJoint *joint, cpFloat dt)
 {
-	if(!joint->bias) return; // early exit
+	if(!joint->bias) return 0.0f; // early exit
 
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -86,6 +86,8 @@ applyImpulse(cpRatchetJoint *joint, cpFloat dt)
 	// apply impulse
 	a->w -= j*a->i_inv;
 	b->w += j*b->i_inv;
+	
+	return cpfabs(j);
 }
 
 static cpFloat
@@ -94,11 +96,17 @@ getImpulse(cpRatchetJoint *joint)
 	return cpfabs(joint->jAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpRatchetJoint)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpRatchetJoint *
@@ -57,10 +57,10 @@ applyCachedImpulse(cpRotaryLimitJoint *joint, cpFloat dt_coef)
 	b->w += j*b->i_inv;
 }
 
-static void
-applyImpulse(cpRotaryLimitJoint *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpRotaryLimitJoint *joint, cpFloat dt)
 {
-	if(!joint->bias) return; // early exit
+	if(!joint->bias) return 0.0f; // early exit
 
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -83,6 +83,8 @@ applyImpulse(cpRotaryLimitJoint *joint, cpFloat dt)
 	// apply impulse
 	a->w -= j*a->i_inv;
 	b->w += j*b->i_inv;
+	
+	return cpfabs(j);
 }
 
 static cpFloat
@@ -91,11 +93,17 @@ getImpulse(cpRotaryLimitJoint *joint)
 	return cpfabs(joint->jAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpRotaryLimitJoint)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpRotaryLimitJoint *
@@ -476,7 +476,7 @@ cpSegmentShapeMassInfo(cpFloat mass, cpVect a, cpVect b, cpFloat r)
 	return info;
 }
 
-static const cpShapeClass cpSegmentShapeClass = {
+const cpShapeClass cpSegmentShapeClass = {
 	CP_SEGMENT_SHAPE,
 	(cpShapeCacheDataImpl)cpSegmentShapeCacheData,
 	NULL,
@@ -560,6 +560,9 @@ cpCircleShapeSetRadius(cpShape *shape, cpFloat radius)
 	cpFloat mass = shape->massInfo.m;
 	shape->massInfo = cpCircleShapeMassInfo(mass, circle->r, circle->c);
 	if(mass > 0.0f) cpBodyAccumulateMassFromShapes(shape->body);
+	
+	// The shape may have grown closer to its neighbors.
+	if(shape->space) cpSpaceFilterSeparations(shape->space, shape);
 }
 
 void
@@ -573,6 +576,9 @@ cpCircleShapeSetOffset(cpShape *shape, cpVect offset)
 	cpFloat mass = shape->massInfo.m;
 	shape->massInfo = cpCircleShapeMassInfo(shape->massInfo.m, circle->r, circle->c);
 	if(mass > 0.0f) cpBodyAccumulateMassFromShapes(shape->body);
+	
+	// The shape may have grown closer to its neighbors.
+	if(shape->space) cpSpaceFilterSeparations(shape->space, shape);
 }
 
 void
@@ -588,6 +594,9 @@ cpSegmentShapeSetEndpoints(cpShape *shape, cpVect a, cpVect b)
 	cpFloat mass = shape->massInfo.m;
 	shape->massInfo = cpSegmentShapeMassInfo(shape->massInfo.m, seg->a, seg->b, seg->r);
 	if(mass > 0.0f) cpBodyAccumulateMassFromShapes(shape->body);
+	
+	// The shape may have grown closer to its neighbors.
+	if(shape->space) cpSpaceFilterSeparations(shape->space, shape);
 }
 
 void
@@ -601,4 +610,7 @@ cpSegmentShapeSetRadius(cpShape *shape, cpFloat radius)
 	cpFloat mass = shape->massInfo.m;
 	shape->massInfo = cpSegmentShapeMassInfo(shape->massInfo.m, seg->a, seg->b, seg->r);
 	if(mass > 0.0f) cpBodyAccumulateMassFromShapes(shape->body);
+	
+	// The shape may have grown closer to its neighbors.
+	if(shape->space) cpSpaceFilterSeparations(shape->space, shape);
 }
@@ -42,8 +42,8 @@ applyCachedImpulse(cpSimpleMotor *joint, cpFloat dt_coef)
 	b->w += j*b->i_inv;
 }
 
-static void
-applyImpulse(cpSimpleMotor *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpSimpleMotor *joint, cpFloat dt)
 {
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -62,6 +62,8 @@ applyImpulse(cpSimpleMotor *joint, cpFloat dt)
 	// apply impulse
 	a->w -= j*a->i_inv;
 	b->w += j*b->i_inv;
+	
+	return cpfabs(j);
 }
 
 static cpFloat
@@ -70,11 +72,17 @@ getImpulse(cpSimpleMotor *joint)
 	return cpfabs(joint->jAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpSimpleMotor)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpSimpleMotor *
@@ -62,10 +62,10 @@ applyCachedImpulse(cpSlideJoint *joint, cpFloat dt_coef)
 	apply_impulses(a, b, joint->r1, joint->r2, j);
 }
 
-static void
-applyImpulse(cpSlideJoint *joint, cpFloat dt)
+static cpFloat
+applyImpulseDelta(cpSlideJoint *joint, cpFloat dt)
 {
-	if(cpveql(joint->n, cpvzero)) return;  // early exit
+	if(cpveql(joint->n, cpvzero)) return 0.0f;  // early exit
 
 	cpBody *a = joint->constraint.a;
 	cpBody *b = joint->constraint.b;
@@ -86,6 +86,8 @@ applyImpulse(cpSlideJoint *joint, cpFloat dt)
 	
 	// apply impulse
 	apply_impulses(a, b, joint->r1, joint->r2, cpvmult(n, jn));
+	
+	return cpfabs(jn);
 }
 
 static cpFloat
@@ -94,11 +96,17 @@ getImpulse(cpConstraint *joint)
 	return cpfabs(((cpSlideJoint *)joint)->jnAcc);
 }
 
+CP_DEFINE_CONSTRAINT_BATCH_FUNCS(cpSlideJoint)
+
 static const cpConstraintClass klass = {
 	(cpConstraintPreStepImpl)preStep,
 	(cpConstraintApplyCachedImpulseImpl)applyCachedImpulse,
 	(cpConstraintApplyImpulseImpl)applyImpulse,
 	(cpConstraintGetImpulseImpl)getImpulse,
+	preStepBatch,
+	applyCachedImpulseBatch,
+	applyImpulseBatch,
+	(cpConstraintApplyImpulseDeltaImpl)applyImpulseDelta,
 };
 
 cpSlideJoint *
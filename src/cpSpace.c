@@ -36,6 +36,26 @@ arbiterSetEql(cpShape **shapes, cpArbiter *arb)
 	return ((a == arb->a && b == arb->b) || (b == arb->a && a == arb->b));
 }
 
+// Equal function for separationSet.
+static cpBool
+separationSetEql(cpShape **shapes, struct cpSeparation *separation)
+{
+	cpShape *a = shapes[0];
+	cpShape *b = shapes[1];
+	
+	return ((a == separation->a && b == separation->b) || (b == separation->a && a == separation->b));
+}
+
+// Equal function for pairIDSet.
+static cpBool
+pairIDSetEql(cpShape **shapes, struct cpPairID *pairID)
+{
+	cpShape *a = shapes[0];
+	cpShape *b = shapes[1];
+	
+	return ((a == pairID->a && b == pairID->b) || (b == pairID->a && a == pairID->b));
+}
+
 //MARK: Collision Handler Set HelperFunctions
 
 // Equals function for collisionHandlers.
@@ -129,6 +149,10 @@ cpSpaceInit(cpSpace *space)
 #endif
 
 	space->iterations = 10;
+	space->solverTolerance = 0.0f;
+	space->iterationsUsed = 0;
+	space->blockSolver = cpFalse;
+	space->positionIterations = 0;
 	
 	space->gravity = cpvzero;
 	space->damping = 1.0f;
@@ -161,7 +185,17 @@ cpSpaceInit(cpSpace *space)
 	space->contactBuffersHead = NULL;
 	space->cachedArbiters = cpHashSetNew(0, (cpHashSetEqlFunc)arbiterSetEql);
 	
+	space->cacheSeparations = cpFalse;
+	space->cachedSeparations = cpHashSetNew(0, (cpHashSetEqlFunc)separationSetEql);
+	space->pooledSeparations = cpArrayNew(0);
+	
+	space->cachedPairIDs = cpHashSetNew(0, (cpHashSetEqlFunc)pairIDSetEql);
+	space->pooledPairIDs = cpArrayNew(0);
+	
 	space->constraints = cpArrayNew(0);
+	space->constraintBuckets = NULL;
+	space->constraintBucketCount = space->constraintBucketCapacity = 0;
+	space->sortedConstraints = cpArrayNew(0);
 	
 	space->usesWildcards = cpFalse;
 	memcpy(&space->defaultHandler, &cpCollisionHandlerDoNothing, sizeof(cpCollisionHandler));
@@ -170,6 +204,9 @@ cpSpaceInit(cpSpace *space)
 	space->postStepCallbacks = cpArrayNew(0);
 	space->skipPostStep = cpFalse;
 	
+	space->packedSolver = cpFalse;
+	memset(&space->contactSolver, 0, sizeof(struct cpContactSolver));
+	
 	cpBody *staticBody = cpBodyInit(&space->_staticBody, 0.0f, 0.0f);
 	cpBodySetType(staticBody, CP_BODY_TYPE_STATIC);
 	cpSpaceSetStaticBody(space, staticBody);
@@ -199,12 +236,21 @@ cpSpaceDestroy(cpSpace *space)
 	cpArrayFree(space->rousedBodies);
 	
 	cpArrayFree(space->constraints);
+	cpArrayFree(space->sortedConstraints);
+	cpfree(space->constraintBuckets);
 	
 	cpHashSetFree(space->cachedArbiters);
+	cpHashSetFree(space->cachedSeparations);
+	cpArrayFree(space->pooledSeparations);
+	
+	cpHashSetFree(space->cachedPairIDs);
+	cpArrayFree(space->pooledPairIDs);
 	
 	cpArrayFree(space->arbiters);
 	cpArrayFree(space->pooledArbiters);
 	
+	cpContactSolverDestroy(&space->contactSolver);
+	
 	if(space->allocatedBuffers){
 		cpArrayFreeEach(space->allocatedBuffers, cpfree);
 		cpArrayFree(space->allocatedBuffers);
@@ -244,6 +290,77 @@ cpSpaceSetIterations(cpSpace *space, int iterations)
 	space->iterations = iterations;
 }
 
+cpFloat
+cpSpaceGetSolverTolerance(const cpSpace *space)
+{
+	return space->solverTolerance;
+}
+
+void
+cpSpaceSetSolverTolerance(cpSpace *space, cpFloat solverTolerance)
+{
+	cpAssertHard(solverTolerance >= 0.0f, "Solver tolerance must be non-negative.");
+	space->solverTolerance = solverTolerance;
+}
+
+int
+cpSpaceGetIterationsUsed(const cpSpace *space)
+{
+	return space->iterationsUsed;
+}
+
+cpBool
+cpSpaceGetBlockSolver(const cpSpace *space)
+{
+	return space->blockSolver;
+}
+
+void
+cpSpaceSetBlockSolver(cpSpace *space, cpBool blockSolver)
+{
+	space->blockSolver = blockSolver;
+}
+
+int
+cpSpaceGetPositionIterations(const cpSpace *space)
+{
+	return space->positionIterations;
+}
+
+void
+cpSpaceSetPositionIterations(cpSpace *space, int positionIterations)
+{
+	cpAssertHard(positionIterations >= 0, "Position iterations must be non-negative.");
+	space->positionIterations = positionIterations;
+}
+
+cpBool
+cpSpaceGetPackedSolver(const cpSpace *space)
+{
+	return space->packedSolver;
+}
+
+void
+cpSpaceSetPackedSolver(cpSpace *space, cpBool packedSolver)
+{
+	space->packedSolver = packedSolver;
+}
+
+cpBool
+cpSpaceGetSeparationCaching(const cpSpace *space)
+{
+	return space->cacheSeparations;
+}
+
+void
+cpSpaceSetSeparationCaching(cpSpace *space, cpBool cacheSeparations)
+{
+	cpAssertSpaceUnlocked(space);
+	
+	space->cacheSeparations = cacheSeparations;
+	if(!cacheSeparations) cpSpaceFilterSeparations(space, NULL);
+}
+
 cpVect
 cpSpaceGetGravity(const cpSpace *space)
 {
@@ -414,6 +531,20 @@ cpSpaceAddWildcardHandler(cpSpace *space, cpCollisionType type)
 
 
 //MARK: Body, Shape, and Joint Management
+
+// Contact hashes are generated from the hashids, so every shape that collides needs a distinct one.
+static void
+cpSpaceAssignHashID(cpSpace *space, cpShape *shape)
+{
+	shape->hashid = space->shapeIDCounter++;
+	
+	if(shape->klass->type == CP_COMPOUND_SHAPE){
+		// The children collide as shapes of their own, but aren't added to the space.
+		cpCompoundShape *compound = (cpCompoundShape *)shape;
+		for(int i=0; i<compound->count; i++) compound->shapes[i]->hashid = CP_HASH_PAIR(shape->hashid, i);
+	}
+}
+
 cpShape *
 cpSpaceAddShape(cpSpace *space, cpShape *shape)
 {
@@ -428,7 +559,7 @@ cpSpaceAddShape(cpSpace *space, cpShape *shape)
 	if(!isStatic) cpBodyActivate(body);
 	cpBodyAddShape(body, shape);
 	
-	shape->hashid = space->shapeIDCounter++;
+	cpSpaceAssignHashID(space, shape);
 	cpShapeUpdate(shape, body->transform);
 	cpSpatialIndexInsert(isStatic ? space->staticShapes : space->dynamicShapes, shape, shape->hashid);
 	shape->space = space;
@@ -436,6 +567,43 @@ cpSpaceAddShape(cpSpace *space, cpShape *shape)
 	return shape;
 }
 
+void
+cpSpaceAddShapes(cpSpace *space, cpShape **shapes, int count)
+{
+	cpAssertSpaceUnlocked(space);
+	
+	// Static shapes fill the arrays from the front, dynamic shapes from the back.
+	void **objs = (void **)cpcalloc(count ? count : 1, sizeof(void *));
+	cpHashValue *hashids = (cpHashValue *)cpcalloc(count ? count : 1, sizeof(cpHashValue));
+	int staticCount = 0, dynamicStart = count;
+	
+	for(int i=0; i<count; i++){
+		cpShape *shape = shapes[i];
+		cpBody *body = shape->body;
+		
+		cpAssertHard(shape->space != space, "You have already added this shape to this space. You must not add it a second time.");
+		cpAssertHard(!shape->space, "You have already added this shape to another space. You cannot add it to a second.");
+		
+		cpBool isStatic = (cpBodyGetType(body) == CP_BODY_TYPE_STATIC);
+		if(!isStatic) cpBodyActivate(body);
+		cpBodyAddShape(body, shape);
+		
+		cpSpaceAssignHashID(space, shape);
+		cpShapeUpdate(shape, body->transform);
+		shape->space = space;
+		
+		int index = (isStatic ? staticCount++ : --dynamicStart);
+		objs[index] = shape;
+		hashids[index] = shape->hashid;
+	}
+	
+	cpSpatialIndexInsertBatch(space->staticShapes, objs, hashids, staticCount);
+	cpSpatialIndexInsertBatch(space->dynamicShapes, objs + dynamicStart, hashids + dynamicStart, count - dynamicStart);
+	
+	cpfree(objs);
+	cpfree(hashids);
+}
+
 cpBody *
 cpSpaceAddBody(cpSpace *space, cpBody *body)
 {
@@ -534,6 +702,18 @@ cpSpaceRemoveShape(cpSpace *space, cpShape *shape)
 
 	cpBodyRemoveShape(body, shape);
 	cpSpaceFilterArbiters(space, body, shape);
+	cpSpaceFilterSeparations(space, shape);
+	cpSpaceFilterPairIDs(space, shape);
+	
+	if(shape->klass->type == CP_COMPOUND_SHAPE){
+		// The arbiters of a compound belong to its children.
+		cpCompoundShape *compound = (cpCompoundShape *)shape;
+		for(int i=0; i<compound->count; i++){
+			cpShape *child = compound->shapes[i];
+			if(isStatic) cpBodyActivateStatic(body, child);
+			cpSpaceFilterArbiters(space, body, child);
+		}
+	}
 	cpSpatialIndexRemove(isStatic ? space->staticShapes : space->dynamicShapes, shape, shape->hashid);
 	shape->space = NULL;
 	shape->hashid = 0;
@@ -686,9 +866,67 @@ copyShapes(cpShape *shape, cpSpatialIndex *index)
 void
 cpSpaceUseSpatialHash(cpSpace *space, cpFloat dim, int count)
 {
+	cpBool autoResize = (dim <= 0.0f);
+	if(autoResize) dim = 0.0f;
+	
 	cpSpatialIndex *staticShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
 	cpSpatialIndex *dynamicShapes = cpSpaceHashNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
 	
+	cpSpaceHashSetAutoResize((cpSpaceHash *)staticShapes, autoResize);
+	cpSpaceHashSetAutoResize((cpSpaceHash *)dynamicShapes, autoResize);
+	
+	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
+	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
+	
+	cpSpatialIndexFree(space->staticShapes);
+	cpSpatialIndexFree(space->dynamicShapes);
+	
+	space->staticShapes = staticShapes;
+	space->dynamicShapes = dynamicShapes;
+}
+
+void
+cpSpaceUseStaticTree(cpSpace *space)
+{
+	cpSpatialIndex *staticShapes = cpStaticTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpSpatialIndex *dynamicShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	cpBBTreeSetVelocityFunc(dynamicShapes, (cpBBTreeVelocityFunc)ShapeVelocityFunc);
+	
+	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
+	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
+	
+	cpSpatialIndexFree(space->staticShapes);
+	cpSpatialIndexFree(space->dynamicShapes);
+	
+	space->staticShapes = staticShapes;
+	space->dynamicShapes = dynamicShapes;
+}
+
+void
+cpSpaceUseSpatialGrid(cpSpace *space, cpFloat dim, int count)
+{
+	// Unlike the spatial hash, the grid can't pick its own cell dimensions.
+	cpAssertHard(dim > 0.0f, "The cell dimensions of a uniform grid must be positive.");
+	
+	cpSpatialIndex *staticShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpSpatialIndex *dynamicShapes = cpSpaceGridNew(dim, count, (cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	
+	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
+	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
+	
+	cpSpatialIndexFree(space->staticShapes);
+	cpSpatialIndexFree(space->dynamicShapes);
+	
+	space->staticShapes = staticShapes;
+	space->dynamicShapes = dynamicShapes;
+}
+
+void
+cpSpaceUseSweep2D(cpSpace *space)
+{
+	cpSpatialIndex *staticShapes = cpBBTreeNew((cpSpatialIndexBBFunc)cpShapeGetBB, NULL);
+	cpSpatialIndex *dynamicShapes = cpSweep2DNew((cpSpatialIndexBBFunc)cpShapeGetBB, staticShapes);
+	
 	cpSpatialIndexEach(space->staticShapes, (cpSpatialIndexIteratorFunc)copyShapes, staticShapes);
 	cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)copyShapes, dynamicShapes);
 	
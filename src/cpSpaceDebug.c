@@ -54,6 +54,31 @@ cpSpaceDebugDrawShape(cpShape *shape, cpSpaceDebugDrawOptions *options)
 			options->drawPolygon(count, verts, poly->r, outline_color, fill_color, data);
 			break;
 		}
+		case CP_CHAIN_SHAPE: {
+			cpChainShape *chain = (cpChainShape *)shape;
+			
+			for(int i=0, count=cpChainShapeEdgeCount(chain); i<count; i++){
+				cpSegmentShape seg;
+				cpChainShapeGetEdge(chain, i, &seg);
+				options->drawFatSegment(seg.ta, seg.tb, seg.r, outline_color, fill_color, data);
+			}
+			break;
+		}
+		case CP_HEIGHTFIELD_SHAPE: {
+			cpHeightfieldShape *heightfield = (cpHeightfieldShape *)shape;
+			
+			for(int i=0, count=cpHeightfieldShapeColumnCount(heightfield); i<count; i++){
+				cpSegmentShape seg;
+				cpHeightfieldShapeGetColumn(heightfield, i, &seg);
+				options->drawFatSegment(seg.ta, seg.tb, seg.r, outline_color, fill_color, data);
+			}
+			break;
+		}
+		case CP_COMPOUND_SHAPE: {
+			cpCompoundShape *compound = (cpCompoundShape *)shape;
+			for(int i=0; i<compound->count; i++) cpSpaceDebugDrawShape(compound->shapes[i], options);
+			break;
+		}
 		default: break;
 	}
 }
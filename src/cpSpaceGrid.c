@@ -0,0 +1,512 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+#include "prime.h"
+
+static inline cpSpatialIndexClass *Klass();
+
+//MARK: Basic Structures
+
+typedef struct cpGridHandle {
+	void *obj;
+	// Position of the object in the grid's dense arrays.
+	int index;
+} cpGridHandle;
+
+struct cpSpaceGrid {
+	cpSpatialIndex spatialIndex;
+	
+	int numcells;
+	cpFloat celldim;
+	
+	cpHashSet *handleSet;
+	
+	// Dense arrays of the objects and their bounds.
+	int count, capacity;
+	cpGridHandle **handles;
+	cpBB *bbs;
+	cpTimestamp *stamps;
+	
+	// The cells are stored in compressed form. Cell i holds the object indexes in items[cellStart[i]] to items[cellStart[i + 1] - 1].
+	// Objects are added in index order, so the items in each cell are sorted.
+	int *cellStart;
+	int *items;
+	int itemCapacity;
+	
+	// Set when objects are added, removed or moved and the cells need to be rebuilt.
+	cpBool dirty;
+	cpTimestamp stamp;
+	
+	cpGridHandle *pooledHandles;
+	cpArray *allocatedBuffers;
+};
+
+//MARK: Handle Functions
+
+static inline void
+recycleHandle(cpSpaceGrid *grid, cpGridHandle *hand)
+{
+	// Pooled handles are linked through their obj pointers.
+	hand->obj = grid->pooledHandles;
+	grid->pooledHandles = hand;
+}
+
+static cpGridHandle *
+getEmptyHandle(cpSpaceGrid *grid)
+{
+	cpGridHandle *hand = grid->pooledHandles;
+	
+	if(hand){
+		grid->pooledHandles = (cpGridHandle *)hand->obj;
+		return hand;
+	} else {
+		// Pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(cpGridHandle);
+		cpAssertHard(count, "Internal Error: Buffer size is too small.");
+		
+		cpGridHandle *buffer = (cpGridHandle *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpArrayPush(grid->allocatedBuffers, buffer);
+		
+		// push all but the first one, return the first instead
+		for(int i=1; i<count; i++) recycleHandle(grid, buffer + i);
+		return buffer;
+	}
+}
+
+static int handleSetEql(void *obj, cpGridHandle *hand){return (obj == hand->obj);}
+
+static void *
+handleSetTrans(void *obj, cpSpaceGrid *grid)
+{
+	if(grid->count == grid->capacity){
+		grid->capacity = (grid->capacity ? 2*grid->capacity : 64);
+		grid->handles = (cpGridHandle **)cprealloc(grid->handles, grid->capacity*sizeof(cpGridHandle *));
+		grid->bbs = (cpBB *)cprealloc(grid->bbs, grid->capacity*sizeof(cpBB));
+		grid->stamps = (cpTimestamp *)cprealloc(grid->stamps, grid->capacity*sizeof(cpTimestamp));
+	}
+	
+	cpGridHandle *hand = getEmptyHandle(grid);
+	hand->obj = obj;
+	hand->index = grid->count++;
+	
+	grid->handles[hand->index] = hand;
+	grid->stamps[hand->index] = 0;
+	
+	return hand;
+}
+
+//MARK: Memory Management Functions
+
+cpSpaceGrid *
+cpSpaceGridAlloc(void)
+{
+	return (cpSpaceGrid *)cpcalloc(1, sizeof(cpSpaceGrid));
+}
+
+cpSpatialIndex *
+cpSpaceGridInit(cpSpaceGrid *grid, cpFloat celldim, int numcells, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	cpAssertHard(celldim > 0.0f, "The cell dimensions of a uniform grid must be positive.");
+	
+	cpSpatialIndexInit((cpSpatialIndex *)grid, Klass(), bbfunc, staticIndex);
+	
+	grid->numcells = next_prime(numcells);
+	grid->celldim = celldim;
+	
+	grid->handleSet = cpHashSetNew(0, (cpHashSetEqlFunc)handleSetEql);
+	
+	grid->count = grid->capacity = 0;
+	grid->handles = NULL;
+	grid->bbs = NULL;
+	grid->stamps = NULL;
+	
+	grid->cellStart = (int *)cpcalloc(grid->numcells + 1, sizeof(int));
+	grid->items = NULL;
+	grid->itemCapacity = 0;
+	
+	grid->dirty = cpFalse;
+	grid->stamp = 1;
+	
+	grid->pooledHandles = NULL;
+	grid->allocatedBuffers = cpArrayNew(0);
+	
+	return (cpSpatialIndex *)grid;
+}
+
+cpSpatialIndex *
+cpSpaceGridNew(cpFloat celldim, int cells, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	return cpSpaceGridInit(cpSpaceGridAlloc(), celldim, cells, bbfunc, staticIndex);
+}
+
+static void
+cpSpaceGridDestroy(cpSpaceGrid *grid)
+{
+	cpHashSetFree(grid->handleSet);
+	
+	cpfree(grid->handles);
+	cpfree(grid->bbs);
+	cpfree(grid->stamps);
+	
+	cpfree(grid->cellStart);
+	cpfree(grid->items);
+	
+	cpArrayFreeEach(grid->allocatedBuffers, cpfree);
+	cpArrayFree(grid->allocatedBuffers);
+}
+
+//MARK: Helper Functions
+
+// The hash function itself.
+static inline cpHashValue
+hash_func(cpHashValue x, cpHashValue y, cpHashValue n)
+{
+	return (x*1640531513ul ^ y*2654435789ul) % n;
+}
+
+// Much faster than (int)floor(f)
+// Profiling showed floor() to be a sizable performance hog
+static inline int
+floor_int(cpFloat f)
+{
+	int i = (int)f;
+	return (f < 0.0f && f != i ? i - 1 : i);
+}
+
+// Rebuild the cells from scratch using a counting sort.
+// Each pass is a flat loop over the objects or the cells, so the work is linear in the number of objects and easy to split up.
+static void
+cpSpaceGridRebuild(cpSpaceGrid *grid)
+{
+	cpFloat dim = grid->celldim;
+	int n = grid->numcells;
+	int *cellStart = grid->cellStart;
+	memset(cellStart, 0, (n + 1)*sizeof(int));
+	
+	// Update the bounds and count the items in each cell.
+	int itemCount = 0;
+	for(int index=0; index<grid->count; index++){
+		cpBB bb = grid->bbs[index] = grid->spatialIndex.bbfunc(grid->handles[index]->obj);
+		
+		int l = floor_int(bb.l/dim), r = floor_int(bb.r/dim);
+		int b = floor_int(bb.b/dim), t = floor_int(bb.t/dim);
+		
+		for(int i=l; i<=r; i++){
+			for(int j=b; j<=t; j++) cellStart[hash_func(i,j,n) + 1]++;
+		}
+		
+		itemCount += (r - l + 1)*(t - b + 1);
+	}
+	
+	if(itemCount > grid->itemCapacity){
+		grid->itemCapacity = (itemCount > 2*grid->itemCapacity ? itemCount : 2*grid->itemCapacity);
+		cpfree(grid->items);
+		grid->items = (int *)cpcalloc(grid->itemCapacity, sizeof(int));
+	}
+	
+	// Convert the counts to the starting offset of each cell.
+	for(int i=0; i<n; i++) cellStart[i + 1] += cellStart[i];
+	
+	// Scatter the object indexes into the cells. This advances each cell's start to the start of the next cell.
+	int *items = grid->items;
+	for(int index=0; index<grid->count; index++){
+		cpBB bb = grid->bbs[index];
+		
+		int l = floor_int(bb.l/dim), r = floor_int(bb.r/dim);
+		int b = floor_int(bb.b/dim), t = floor_int(bb.t/dim);
+		
+		for(int i=l; i<=r; i++){
+			for(int j=b; j<=t; j++) items[cellStart[hash_func(i,j,n)]++] = index;
+		}
+	}
+	
+	// Shift the starts back into place.
+	for(int i=n; i>0; i--) cellStart[i] = cellStart[i - 1];
+	cellStart[0] = 0;
+	
+	grid->dirty = cpFalse;
+}
+
+static inline void
+cpSpaceGridUpdate(cpSpaceGrid *grid)
+{
+	if(grid->dirty) cpSpaceGridRebuild(grid);
+}
+
+// Objects that cover several grid cells are reported only from the cell holding the lower left corner of the overlap.
+// This avoids reporting the same pair from more than one cell without needing to mark anything.
+static inline cpBool
+OwnsOverlap(cpFloat dim, cpBB a, cpBB b, int i, int j)
+{
+	return (floor_int(cpfmax(a.l, b.l)/dim) == i && floor_int(cpfmax(a.b, b.b)/dim) == j);
+}
+
+//MARK: Basic Operations
+
+static void
+cpSpaceGridInsert(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	cpHashSetInsert(grid->handleSet, hashid, obj, (cpHashSetTransFunc)handleSetTrans, grid);
+	grid->dirty = cpTrue;
+}
+
+static void
+cpSpaceGridRemove(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	cpGridHandle *hand = (cpGridHandle *)cpHashSetRemove(grid->handleSet, hashid, obj);
+	
+	if(hand){
+		// Move the last object into the hole.
+		int index = hand->index, last = --grid->count;
+		cpGridHandle *lastHand = grid->handles[last];
+		
+		grid->handles[index] = lastHand;
+		grid->bbs[index] = grid->bbs[last];
+		grid->stamps[index] = grid->stamps[last];
+		lastHand->index = index;
+		
+		recycleHandle(grid, hand);
+		grid->dirty = cpTrue;
+	}
+}
+
+//MARK: Reindexing Functions
+
+static void
+cpSpaceGridReindex(cpSpaceGrid *grid)
+{
+	cpSpaceGridRebuild(grid);
+}
+
+static void
+cpSpaceGridReindexObject(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	// Objects are only placed in the cells during a rebuild.
+	if(cpHashSetFind(grid->handleSet, hashid, obj)) grid->dirty = cpTrue;
+}
+
+static void
+cpSpaceGridReindexQuery(cpSpaceGrid *grid, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpSpaceGridRebuild(grid);
+	
+	cpFloat dim = grid->celldim;
+	int n = grid->numcells;
+	int *cellStart = grid->cellStart, *items = grid->items;
+	cpBB *bbs = grid->bbs;
+	cpGridHandle **handles = grid->handles;
+	
+	for(int index=0; index<grid->count; index++){
+		cpBB bb = bbs[index];
+		void *obj = handles[index]->obj;
+		
+		int l = floor_int(bb.l/dim), r = floor_int(bb.r/dim);
+		int b = floor_int(bb.b/dim), t = floor_int(bb.t/dim);
+		
+		for(int i=l; i<=r; i++){
+			for(int j=b; j<=t; j++){
+				int cell = (int)hash_func(i,j,n);
+				int start = cellStart[cell];
+				
+				// The items are sorted, so walk backwards over the objects with a higher index to visit each pair once.
+				for(int k=cellStart[cell + 1] - 1; k >= start && items[k] > index; k--){
+					int other = items[k];
+					
+					// Skip duplicates left by other grid cells that hash to the same table cell.
+					if(k > start && items[k - 1] == other) continue;
+					
+					cpBB otherBB = bbs[other];
+					if(cpBBIntersects(bb, otherBB) && OwnsOverlap(dim, bb, otherBB, i, j)) func(obj, handles[other]->obj, 0, data);
+				}
+			}
+		}
+	}
+	
+	cpSpatialIndexCollideStatic((cpSpatialIndex *)grid, grid->spatialIndex.staticIndex, func, data);
+}
+
+//MARK: Query Functions
+
+static void
+cpSpaceGridQuery(cpSpaceGrid *grid, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpSpaceGridUpdate(grid);
+	
+	cpFloat dim = grid->celldim;
+	cpBB *bbs = grid->bbs;
+	cpGridHandle **handles = grid->handles;
+	
+	// Large queries are faster to check against every object than cell by cell.
+	cpFloat cells = (cpffloor(bb.r/dim) - cpffloor(bb.l/dim) + 1.0f)*(cpffloor(bb.t/dim) - cpffloor(bb.b/dim) + 1.0f);
+	if(cells > grid->count){
+		for(int index=0; index<grid->count; index++){
+			void *other = handles[index]->obj;
+			if(cpBBIntersects(bb, bbs[index]) && obj != other) func(obj, other, 0, data);
+		}
+		
+		return;
+	}
+	
+	int n = grid->numcells;
+	int *cellStart = grid->cellStart, *items = grid->items;
+	
+	int l = floor_int(bb.l/dim), r = floor_int(bb.r/dim);
+	int b = floor_int(bb.b/dim), t = floor_int(bb.t/dim);
+	
+	for(int i=l; i<=r; i++){
+		for(int j=b; j<=t; j++){
+			int cell = (int)hash_func(i,j,n);
+			int start = cellStart[cell], end = cellStart[cell + 1];
+			
+			for(int k=start; k<end; k++){
+				int index = items[k];
+				if(k > start && items[k - 1] == index) continue;
+				
+				cpBB otherBB = bbs[index];
+				void *other = handles[index]->obj;
+				if(cpBBIntersects(bb, otherBB) && OwnsOverlap(dim, bb, otherBB, i, j) && obj != other) func(obj, other, 0, data);
+			}
+		}
+	}
+}
+
+static inline cpFloat
+segmentQuery_helper(cpSpaceGrid *grid, int cell, void *obj, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	cpFloat t = 1.0f;
+	cpTimestamp *stamps = grid->stamps;
+	
+	for(int k=grid->cellStart[cell], end=grid->cellStart[cell + 1]; k<end; k++){
+		int index = grid->items[k];
+		
+		if(stamps[index] != grid->stamp){
+			t = cpfmin(t, func(obj, grid->handles[index]->obj, data));
+			stamps[index] = grid->stamp;
+		}
+	}
+	
+	return t;
+}
+
+// modified from http://playtechs.blogspot.com/2007/03/raytracing-on-grid.html
+static void
+cpSpaceGridSegmentQuery(cpSpaceGrid *grid, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	cpSpaceGridUpdate(grid);
+	
+	a = cpvmult(a, 1.0f/grid->celldim);
+	b = cpvmult(b, 1.0f/grid->celldim);
+	
+	int cell_x = floor_int(a.x), cell_y = floor_int(a.y);
+
+	cpFloat t = 0;
+
+	int x_inc, y_inc;
+	cpFloat temp_v, temp_h;
+
+	if (b.x > a.x){
+		x_inc = 1;
+		temp_h = (cpffloor(a.x + 1.0f) - a.x);
+	} else {
+		x_inc = -1;
+		temp_h = (a.x - cpffloor(a.x));
+	}
+
+	if (b.y > a.y){
+		y_inc = 1;
+		temp_v = (cpffloor(a.y + 1.0f) - a.y);
+	} else {
+		y_inc = -1;
+		temp_v = (a.y - cpffloor(a.y));
+	}
+	
+	// Division by zero is *very* slow on ARM
+	cpFloat dx = cpfabs(b.x - a.x), dy = cpfabs(b.y - a.y);
+	cpFloat dt_dx = (dx ? 1.0f/dx : INFINITY), dt_dy = (dy ? 1.0f/dy : INFINITY);
+	
+	// Avoid NANs in horizontal and vertical directions.
+	// A segment starting on a cell boundary and heading in the negative direction leaves its first cell immediately.
+	cpFloat next_h = (dx ? temp_h*dt_dx : INFINITY);
+	cpFloat next_v = (dy ? temp_v*dt_dy : INFINITY);
+	
+	int n = grid->numcells;
+
+	while(t < t_exit){
+		int cell = (int)hash_func(cell_x, cell_y, n);
+		t_exit = cpfmin(t_exit, segmentQuery_helper(grid, cell, obj, func, data));
+
+		if (next_v < next_h){
+			cell_y += y_inc;
+			t = next_v;
+			next_v += dt_dy;
+		} else {
+			cell_x += x_inc;
+			t = next_h;
+			next_h += dt_dx;
+		}
+	}
+	
+	grid->stamp++;
+}
+
+//MARK: Misc
+
+static int
+cpSpaceGridCount(cpSpaceGrid *grid)
+{
+	return grid->count;
+}
+
+static void
+cpSpaceGridEach(cpSpaceGrid *grid, cpSpatialIndexIteratorFunc func, void *data)
+{
+	// Iterate backwards so the callback can remove the current object.
+	for(int index=grid->count - 1; index>=0; index--) func(grid->handles[index]->obj, data);
+}
+
+static cpBool
+cpSpaceGridContains(cpSpaceGrid *grid, void *obj, cpHashValue hashid)
+{
+	return (cpHashSetFind(grid->handleSet, hashid, obj) != NULL);
+}
+
+static cpSpatialIndexClass klass = {
+	(cpSpatialIndexDestroyImpl)cpSpaceGridDestroy,
+	
+	(cpSpatialIndexCountImpl)cpSpaceGridCount,
+	(cpSpatialIndexEachImpl)cpSpaceGridEach,
+	(cpSpatialIndexContainsImpl)cpSpaceGridContains,
+	
+	(cpSpatialIndexInsertImpl)cpSpaceGridInsert,
+	(cpSpatialIndexRemoveImpl)cpSpaceGridRemove,
+	
+	(cpSpatialIndexReindexImpl)cpSpaceGridReindex,
+	(cpSpatialIndexReindexObjectImpl)cpSpaceGridReindexObject,
+	(cpSpatialIndexReindexQueryImpl)cpSpaceGridReindexQuery,
+	
+	(cpSpatialIndexQueryImpl)cpSpaceGridQuery,
+	(cpSpatialIndexSegmentQueryImpl)cpSpaceGridSegmentQuery,
+};
+
+static inline cpSpatialIndexClass *Klass(){return &klass;}
@@ -39,6 +39,11 @@ struct cpSpaceHash {
 	cpArray *allocatedBuffers;
 	
 	cpTimestamp stamp;
+	
+	// Statistics about the hashed objects, collected since the last rehash and used to resize the table automatically.
+	cpBool autoResize;
+	int statObjects, statBins;
+	cpFloat statSize;
 };
 
 
@@ -187,6 +192,10 @@ cpSpaceHashInit(cpSpaceHash *hash, cpFloat celldim, int numcells, cpSpatialIndex
 	
 	hash->stamp = 1;
 	
+	hash->autoResize = cpFalse;
+	hash->statObjects = hash->statBins = 0;
+	hash->statSize = 0.0f;
+	
 	return (cpSpatialIndex *)hash;
 }
 
@@ -238,6 +247,14 @@ floor_int(cpFloat f)
 	return (f < 0.0f && f != i ? i - 1 : i);
 }
 
+static inline void
+accumulateStats(cpSpaceHash *hash, cpBB bb, int l, int r, int b, int t)
+{
+	hash->statObjects++;
+	hash->statBins += (r - l + 1)*(t - b + 1);
+	hash->statSize += cpfmax(bb.r - bb.l, bb.t - bb.b);
+}
+
 static inline void
 hashHandle(cpSpaceHash *hash, cpHandle *hand, cpBB bb)
 {
@@ -247,6 +264,7 @@ hashHandle(cpSpaceHash *hash, cpHandle *hand, cpBB bb)
 	int r = floor_int(bb.r/dim);
 	int b = floor_int(bb.b/dim);
 	int t = floor_int(bb.t/dim);
+	accumulateStats(hash, bb, l, r, b, t);
 	
 	int n = hash->numcells;
 	for(int i=l; i<=r; i++){
@@ -267,13 +285,85 @@ hashHandle(cpSpaceHash *hash, cpHandle *hand, cpBB bb)
 	}
 }
 
+//MARK: Automatic Resizing
+
+// The target cell size relative to the average object size.
+// Cells a bit larger than the objects keep the number of cells each object covers low.
+#define CELL_SIZE_RATIO 1.5f
+// The cell size is reset to the target when it drifts outside of this range of the target.
+#define MIN_SIZE_RATIO 0.5f
+#define MAX_SIZE_RATIO 2.0f
+
+// The table is resized to hold CELLS_PER_BIN cells for each bin when the number of bins per cell drifts outside of this range.
+#define MIN_LOAD 0.03f
+#define MAX_LOAD 0.5f
+#define CELLS_PER_BIN 4.0f
+
+// Objects at the target size cover about 3 cells on average.
+#define BINS_PER_OBJECT 3
+
+#define MIN_CELLS 64
+
+static void cpSpaceHashResizeTable(cpSpaceHash *hash, cpFloat celldim, int numcells);
+static void cpSpaceHashRehash(cpSpaceHash *hash);
+
+// Check the statistics collected since the last rehash and resize the hash if it has drifted out of tune.
+// The targets sit well inside of the allowed ranges so that the hash does not keep resizing back and forth.
+static void
+autoResize(cpSpaceHash *hash)
+{
+	int objects = hash->statObjects, bins = hash->statBins;
+	cpFloat size = hash->statSize;
+	hash->statObjects = hash->statBins = 0;
+	hash->statSize = 0.0f;
+	
+	if(!hash->autoResize || objects == 0) return;
+	
+	cpFloat celldim = hash->celldim;
+	cpFloat target = CELL_SIZE_RATIO*size/objects;
+	if(target > 0.0f && (celldim < MIN_SIZE_RATIO*target || celldim > MAX_SIZE_RATIO*target)){
+		celldim = target;
+		bins = BINS_PER_OBJECT*objects;
+	}
+	
+	int numcells = hash->numcells;
+	cpFloat load = (cpFloat)bins/(cpFloat)numcells;
+	if(load < MIN_LOAD || load > MAX_LOAD || celldim != hash->celldim){
+		numcells = next_prime((int)cpfmax(CELLS_PER_BIN*bins, MIN_CELLS));
+	}
+	
+	if(celldim != hash->celldim || numcells != hash->numcells) cpSpaceHashResizeTable(hash, celldim, numcells);
+}
+
+void
+cpSpaceHashSetAutoResize(cpSpaceHash *hash, cpBool autoResize)
+{
+	if(hash->spatialIndex.klass != Klass()){
+		cpAssertWarn(cpFalse, "Ignoring cpSpaceHashSetAutoResize() call to non-cpSpaceHash spatial index.");
+		return;
+	}
+	
+	hash->autoResize = autoResize;
+}
+
 //MARK: Basic Operations
 
 static void
 cpSpaceHashInsert(cpSpaceHash *hash, void *obj, cpHashValue hashid)
 {
 	cpHandle *hand = (cpHandle *)cpHashSetInsert(hash->handleSet, hashid, obj, (cpHashSetTransFunc)handleSetTrans, hash);
-	hashHandle(hash, hand, hash->spatialIndex.bbfunc(obj));
+	cpBB bb = hash->spatialIndex.bbfunc(obj);
+	
+	// An automatically sized hash without a cell size yet picks one from the first object.
+	if(hash->celldim == 0.0f){
+		cpFloat size = cpfmax(bb.r - bb.l, bb.t - bb.b);
+		hash->celldim = (size > 0.0f ? CELL_SIZE_RATIO*size : 1.0f);
+	}
+	
+	hashHandle(hash, hand, bb);
+	
+	// Static hashes are rarely rehashed, so grow the table as objects are added.
+	if(hash->autoResize && hash->statBins > MAX_LOAD*hash->numcells) cpSpaceHashRehash(hash);
 }
 
 static void
@@ -298,6 +388,7 @@ rehash_helper(cpHandle *hand, cpSpaceHash *hash)
 static void
 cpSpaceHashRehash(cpSpaceHash *hash)
 {
+	autoResize(hash);
 	clearTable(hash);
 	cpHashSetEach(hash->handleSet, (cpHashSetIteratorFunc)rehash_helper, hash);
 }
@@ -376,6 +467,9 @@ query_helper(cpSpaceHash *hash, cpSpaceHashBin **bin_ptr, void *obj, cpSpatialIn
 static void
 cpSpaceHashQuery(cpSpaceHash *hash, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
 {
+	// An automatically sized hash has no cell size until the first object is inserted.
+	if(hash->celldim == 0.0f) return;
+	
 	// Get the dimensions in cell coordinates.
 	cpFloat dim = hash->celldim;
 	int l = floor_int(bb.l/dim);  // Fix by ShiftZ
@@ -421,6 +515,7 @@ queryRehash_helper(cpHandle *hand, queryRehashContext *context)
 	int r = floor_int(bb.r/dim);
 	int b = floor_int(bb.b/dim);
 	int t = floor_int(bb.t/dim);
+	accumulateStats(hash, bb, l, r, b, t);
 	
 	cpSpaceHashBin **table = hash->table;
 
@@ -448,6 +543,7 @@ queryRehash_helper(cpHandle *hand, queryRehashContext *context)
 static void
 cpSpaceHashReindexQuery(cpSpaceHash *hash, cpSpatialIndexQueryFunc func, void *data)
 {
+	autoResize(hash);
 	clearTable(hash);
 	
 	queryRehashContext context = {hash, func, data};
@@ -487,6 +583,8 @@ segmentQuery_helper(cpSpaceHash *hash, cpSpaceHashBin **bin_ptr, void *obj, cpSp
 static void
 cpSpaceHashSegmentQuery(cpSpaceHash *hash, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
 {
+	if(hash->celldim == 0.0f) return;
+	
 	a = cpvmult(a, 1.0f/hash->celldim);
 	b = cpvmult(b, 1.0f/hash->celldim);
 	
@@ -517,9 +615,10 @@ cpSpaceHashSegmentQuery(cpSpaceHash *hash, void *obj, cpVect a, cpVect b, cpFloa
 	cpFloat dx = cpfabs(b.x - a.x), dy = cpfabs(b.y - a.y);
 	cpFloat dt_dx = (dx ? 1.0f/dx : INFINITY), dt_dy = (dy ? 1.0f/dy : INFINITY);
 	
-	// fix NANs in horizontal directions
-	cpFloat next_h = (temp_h ? temp_h*dt_dx : dt_dx);
-	cpFloat next_v = (temp_v ? temp_v*dt_dy : dt_dy);
+	// Avoid NANs in horizontal and vertical directions.
+	// A segment starting on a cell boundary and heading in the negative direction leaves its first cell immediately.
+	cpFloat next_h = (dx ? temp_h*dt_dx : INFINITY);
+	cpFloat next_v = (dy ? temp_v*dt_dy : INFINITY);
 	
 	int n = hash->numcells;
 	cpSpaceHashBin **table = hash->table;
@@ -552,6 +651,12 @@ cpSpaceHashResize(cpSpaceHash *hash, cpFloat celldim, int numcells)
 		return;
 	}
 	
+	cpSpaceHashResizeTable(hash, celldim, numcells);
+}
+
+static void
+cpSpaceHashResizeTable(cpSpaceHash *hash, cpFloat celldim, int numcells)
+{
 	clearTable(hash);
 	
 	hash->celldim = celldim;
@@ -0,0 +1,298 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "chipmunk/chipmunk_private.h"
+
+// The packed solver copies the contacts of the active arbiters into flat arrays once per step
+// so the solver iterations don't need to chase arbiter, body and contact buffer pointers.
+
+//MARK: Memory Management
+
+#define GROW(ptr, type, count) ptr = (type *)cprealloc(ptr, (count)*sizeof(type))
+
+static void
+cpContactSolverReserveBodies(struct cpContactSolver *solver, int count)
+{
+	if(count <= solver->bodyCapacity) return;
+	
+	int capacity = (count > 2*solver->bodyCapacity ? count : 2*solver->bodyCapacity);
+	solver->bodyCapacity = capacity;
+	
+	GROW(solver->bodies, cpBody *, capacity);
+	GROW(solver->solverBodies, struct cpSolverBody, capacity);
+	GROW(solver->constrainedBodies, int, capacity);
+}
+
+static void
+cpContactSolverReserveContacts(struct cpContactSolver *solver, int count)
+{
+	if(count <= solver->contactCapacity) return;
+	
+	int capacity = (count > 2*solver->contactCapacity ? count : 2*solver->contactCapacity);
+	solver->contactCapacity = capacity;
+	
+	GROW(solver->contacts, struct cpContact *, capacity);
+	GROW(solver->bodyA, int, capacity);
+	GROW(solver->bodyB, int, capacity);
+	
+	GROW(solver->r1x, cpFloat, capacity); GROW(solver->r1y, cpFloat, capacity);
+	GROW(solver->r2x, cpFloat, capacity); GROW(solver->r2y, cpFloat, capacity);
+	GROW(solver->nx, cpFloat, capacity); GROW(solver->ny, cpFloat, capacity);
+	GROW(solver->surfaceVx, cpFloat, capacity); GROW(solver->surfaceVy, cpFloat, capacity);
+	GROW(solver->friction, cpFloat, capacity);
+	
+	GROW(solver->nMass, cpFloat, capacity); GROW(solver->tMass, cpFloat, capacity);
+	GROW(solver->bias, cpFloat, capacity); GROW(solver->bounce, cpFloat, capacity);
+	GROW(solver->jnAcc, cpFloat, capacity); GROW(solver->jtAcc, cpFloat, capacity); GROW(solver->jBias, cpFloat, capacity);
+}
+
+void
+cpContactSolverDestroy(struct cpContactSolver *solver)
+{
+	cpfree(solver->bodies);
+	cpfree(solver->solverBodies);
+	cpfree(solver->constrainedBodies);
+	
+	cpfree(solver->contacts);
+	cpfree(solver->bodyA); cpfree(solver->bodyB);
+	cpfree(solver->r1x); cpfree(solver->r1y);
+	cpfree(solver->r2x); cpfree(solver->r2y);
+	cpfree(solver->nx); cpfree(solver->ny);
+	cpfree(solver->surfaceVx); cpfree(solver->surfaceVy);
+	cpfree(solver->friction);
+	cpfree(solver->nMass); cpfree(solver->tMass);
+	cpfree(solver->bias); cpfree(solver->bounce);
+	cpfree(solver->jnAcc); cpfree(solver->jtAcc); cpfree(solver->jBias);
+	
+	memset(solver, 0, sizeof(struct cpContactSolver));
+}
+
+//MARK: Packing
+
+static inline void
+PackBodyVelocity(struct cpSolverBody *packed, cpBody *body)
+{
+	packed->v = body->v;
+	packed->w = body->w;
+	packed->v_bias = body->v_bias;
+	packed->w_bias = body->w_bias;
+}
+
+static inline void
+UnpackBodyVelocity(struct cpSolverBody *packed, cpBody *body)
+{
+	body->v = packed->v;
+	body->w = packed->w;
+	body->v_bias = packed->v_bias;
+	body->w_bias = packed->w_bias;
+}
+
+static inline int
+PackBody(struct cpContactSolver *solver, cpBody *body)
+{
+	int index = body->solver.index;
+	
+	if(index < 0){
+		index = body->solver.index = solver->bodyCount++;
+		solver->bodies[index] = body;
+		
+		struct cpSolverBody *packed = solver->solverBodies + index;
+		PackBodyVelocity(packed, body);
+		packed->m_inv = body->m_inv;
+		packed->i_inv = body->i_inv;
+	}
+	
+	return index;
+}
+
+static void
+cpContactSolverPack(struct cpContactSolver *solver, cpArray *arbiters, cpArray *constraints)
+{
+	int contactCount = 0;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		arb->body_a->solver.index = arb->body_b->solver.index = -1;
+		contactCount += arb->count;
+	}
+	
+	for(int i=0; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		constraint->a->solver.index = constraint->b->solver.index = -1;
+	}
+	
+	cpContactSolverReserveBodies(solver, 2*arbiters->num);
+	cpContactSolverReserveContacts(solver, contactCount);
+	solver->bodyCount = 0;
+	solver->contactCount = contactCount;
+	
+	int j = 0;
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		int a = PackBody(solver, arb->body_a);
+		int b = PackBody(solver, arb->body_b);
+		
+		for(int k=0; k<arb->count; k++, j++){
+			struct cpContact *con = arb->contacts + k;
+			solver->contacts[j] = con;
+			solver->bodyA[j] = a;
+			solver->bodyB[j] = b;
+			
+			solver->r1x[j] = con->r1.x; solver->r1y[j] = con->r1.y;
+			solver->r2x[j] = con->r2.x; solver->r2y[j] = con->r2.y;
+			solver->nx[j] = arb->n.x; solver->ny[j] = arb->n.y;
+			solver->surfaceVx[j] = arb->surface_vr.x; solver->surfaceVy[j] = arb->surface_vr.y;
+			solver->friction[j] = arb->u;
+			
+			solver->nMass[j] = con->nMass; solver->tMass[j] = con->tMass;
+			solver->bias[j] = con->bias; solver->bounce[j] = con->bounce;
+			solver->jnAcc[j] = con->jnAcc; solver->jtAcc[j] = con->jtAcc; solver->jBias[j] = con->jBias;
+		}
+	}
+	
+	// Find the packed bodies that constraints will also modify.
+	solver->constrainedCount = 0;
+	for(int i=0; i<solver->bodyCount; i++){
+		if(solver->bodies[i]->constraintList) solver->constrainedBodies[solver->constrainedCount++] = i;
+	}
+}
+
+static void
+cpContactSolverUnpack(struct cpContactSolver *solver)
+{
+	for(int i=0; i<solver->contactCount; i++){
+		struct cpContact *con = solver->contacts[i];
+		con->jnAcc = solver->jnAcc[i];
+		con->jtAcc = solver->jtAcc[i];
+		con->jBias = solver->jBias[i];
+	}
+	
+	for(int i=0; i<solver->bodyCount; i++){
+		cpBody *body = solver->bodies[i];
+		UnpackBodyVelocity(solver->solverBodies + i, body);
+		body->solver.index = -1;
+	}
+}
+
+//MARK: Solving
+
+static inline void
+ApplyPackedImpulse(struct cpSolverBody *body, cpVect j, cpVect r){
+	body->v = cpvadd(body->v, cpvmult(j, body->m_inv));
+	body->w += body->i_inv*cpvcross(r, j);
+}
+
+static inline void
+ApplyPackedBiasImpulse(struct cpSolverBody *body, cpVect j, cpVect r)
+{
+	body->v_bias = cpvadd(body->v_bias, cpvmult(j, body->m_inv));
+	body->w_bias += body->i_inv*cpvcross(r, j);
+}
+
+// Same math as cpArbiterApplyImpulse(), but reading from the packed arrays.
+// Returns the largest change in the accumulated impulses.
+static cpFloat
+cpContactSolverApplyImpulses(struct cpContactSolver *solver)
+{
+	struct cpSolverBody *bodies = solver->solverBodies;
+	cpFloat delta = 0.0f;
+	
+	for(int i=0; i<solver->contactCount; i++){
+		struct cpSolverBody *a = bodies + solver->bodyA[i];
+		struct cpSolverBody *b = bodies + solver->bodyB[i];
+		
+		cpVect n = cpv(solver->nx[i], solver->ny[i]);
+		cpVect r1 = cpv(solver->r1x[i], solver->r1y[i]);
+		cpVect r2 = cpv(solver->r2x[i], solver->r2y[i]);
+		cpFloat nMass = solver->nMass[i];
+		
+		cpVect vb1 = cpvadd(a->v_bias, cpvmult(cpvperp(r1), a->w_bias));
+		cpVect vb2 = cpvadd(b->v_bias, cpvmult(cpvperp(r2), b->w_bias));
+		cpVect v1 = cpvadd(a->v, cpvmult(cpvperp(r1), a->w));
+		cpVect v2 = cpvadd(b->v, cpvmult(cpvperp(r2), b->w));
+		cpVect vr = cpvadd(cpvsub(v2, v1), cpv(solver->surfaceVx[i], solver->surfaceVy[i]));
+		
+		cpFloat vbn = cpvdot(cpvsub(vb2, vb1), n);
+		cpFloat vrn = cpvdot(vr, n);
+		cpFloat vrt = cpvdot(vr, cpvperp(n));
+		
+		cpFloat jbn = (solver->bias[i] - vbn)*nMass;
+		cpFloat jbnOld = solver->jBias[i];
+		cpFloat jbnAcc = solver->jBias[i] = cpfmax(jbnOld + jbn, 0.0f);
+		
+		cpFloat jn = -(solver->bounce[i] + vrn)*nMass;
+		cpFloat jnOld = solver->jnAcc[i];
+		cpFloat jnAcc = solver->jnAcc[i] = cpfmax(jnOld + jn, 0.0f);
+		
+		cpFloat jtMax = solver->friction[i]*jnAcc;
+		cpFloat jt = -vrt*solver->tMass[i];
+		cpFloat jtOld = solver->jtAcc[i];
+		cpFloat jtAcc = solver->jtAcc[i] = cpfclamp(jtOld + jt, -jtMax, jtMax);
+		
+		cpVect jb = cpvmult(n, jbnAcc - jbnOld);
+		ApplyPackedBiasImpulse(a, cpvneg(jb), r1);
+		ApplyPackedBiasImpulse(b, jb, r2);
+		
+		cpVect j = cpvrotate(n, cpv(jnAcc - jnOld, jtAcc - jtOld));
+		ApplyPackedImpulse(a, cpvneg(j), r1);
+		ApplyPackedImpulse(b, j, r2);
+		
+		delta = cpfmax(delta, cpfmax(cpfabs(jbnAcc - jbnOld), cpfmax(cpfabs(jnAcc - jnOld), cpfabs(jtAcc - jtOld))));
+	}
+	
+	return delta;
+}
+
+int
+cpSpaceSolvePacked(cpSpace *space, cpFloat dt)
+{
+	struct cpContactSolver *solver = &space->contactSolver;
+	cpArray *constraints = space->constraints;
+	
+	cpContactSolverPack(solver, space->arbiters, constraints);
+	
+	int iterations = 0;
+	while(iterations < space->iterations){
+		cpFloat delta = cpContactSolverApplyImpulses(solver);
+		
+		if(constraints->num){
+			// Constraints work directly on the bodies, so sync any bodies they share with the contacts.
+			for(int j=0; j<solver->constrainedCount; j++){
+				int index = solver->constrainedBodies[j];
+				UnpackBodyVelocity(solver->solverBodies + index, solver->bodies[index]);
+			}
+			
+			delta = cpfmax(delta, cpSpaceApplyConstraintImpulses(space, dt));
+			
+			for(int j=0; j<solver->constrainedCount; j++){
+				int index = solver->constrainedBodies[j];
+				PackBodyVelocity(solver->solverBodies + index, solver->bodies[index]);
+			}
+		}
+		
+		iterations++;
+		if(delta < space->solverTolerance) break;
+	}
+	
+	cpContactSolverUnpack(solver);
+	return iterations;
+}
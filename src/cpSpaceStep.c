@@ -182,6 +182,238 @@ cpSpacePopContacts(cpSpace *space, int count){
 	space->contactBuffersHead->numContacts -= count;
 }
 
+//MARK: Separation Caching
+
+static void *
+cpSpaceSeparationSetTrans(const cpShape **shapes, cpSpace *space)
+{
+	if(space->pooledSeparations->num == 0){
+		// separation pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(struct cpSeparation);
+		cpAssertHard(count, "Internal Error: Buffer size too small.");
+		
+		struct cpSeparation *buffer = (struct cpSeparation *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpArrayPush(space->allocatedBuffers, buffer);
+		
+		for(int i=0; i<count; i++) cpArrayPush(space->pooledSeparations, buffer + i);
+	}
+	
+	struct cpSeparation *separation = (struct cpSeparation *)cpArrayPop(space->pooledSeparations);
+	separation->a = shapes[0];
+	separation->b = shapes[1];
+	
+	return separation;
+}
+
+// Distance from the body's center of gravity to the farthest corner of the shape's bounding box.
+static inline cpFloat
+ShapeReach(const cpShape *shape)
+{
+	cpBB bb = shape->bb;
+	cpVect p = shape->body->p;
+	cpFloat x = cpfmax(cpfabs(bb.l - p.x), cpfabs(bb.r - p.x));
+	cpFloat y = cpfmax(cpfabs(bb.b - p.y), cpfabs(bb.t - p.y));
+	
+	return cpfsqrt(x*x + y*y);
+}
+
+// Upper bound on how far any point of a shape has moved since its body was at 'p' and 'angle'.
+// A point 'reach' away from the center of gravity travels at most 'reach*|delta angle|' when the body rotates.
+static inline cpFloat
+ShapeMotion(const cpShape *shape, cpVect p, cpFloat angle, cpFloat reach)
+{
+	cpBody *body = shape->body;
+	return cpvdist(body->p, p) + reach*cpfabs(body->a - angle);
+}
+
+cpBool
+cpSpaceSeparationHolds(cpSpace *space, const cpShape *a, const cpShape *b, struct cpSeparation **cached)
+{
+	const cpShape *shape_pair[] = {a, b};
+	cpHashValue hash = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+	struct cpSeparation *separation = (*cached = (struct cpSeparation *)cpHashSetFind(space->cachedSeparations, hash, shape_pair));
+	if(separation == NULL) return cpFalse;
+	
+	cpFloat motion = (
+		ShapeMotion(separation->a, separation->p_a, separation->angle_a, separation->reach_a) +
+		ShapeMotion(separation->b, separation->p_b, separation->angle_b, separation->reach_b)
+	);
+	
+	if(motion < separation->distance){
+		// Keep the entry alive as long as the pair stays in the broadphase.
+		separation->stamp = space->stamp;
+		return cpTrue;
+	} else {
+		return cpFalse;
+	}
+}
+
+void
+cpSpaceCacheSeparation(cpSpace *space, struct cpSeparation *separation, const struct cpCollisionInfo *info)
+{
+	const cpShape *a = info->a, *b = info->b;
+	const cpShape *shape_pair[] = {a, b};
+	cpHashValue hash = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+	
+	if(info->count == 0 && info->d > 0.0f){
+		if(separation == NULL){
+			separation = (struct cpSeparation *)cpHashSetInsert(space->cachedSeparations, hash, shape_pair, (cpHashSetTransFunc)cpSpaceSeparationSetTrans, space);
+		}
+		
+		// Leave some slack for rounding errors in the distance.
+		separation->distance = info->d*(1.0f - 1e-3f);
+		
+		// The entry may have been created with the shapes in the opposite order.
+		const cpShape *sa = separation->a, *sb = separation->b;
+		separation->p_a = sa->body->p;
+		separation->p_b = sb->body->p;
+		separation->angle_a = sa->body->a;
+		separation->angle_b = sb->body->a;
+		separation->reach_a = ShapeReach(sa);
+		separation->reach_b = ShapeReach(sb);
+		
+		separation->stamp = space->stamp;
+	} else if(separation){
+		// The shapes are touching or too close to bound. Collide them normally until they separate again.
+		cpHashSetRemove(space->cachedSeparations, hash, shape_pair);
+		cpArrayPush(space->pooledSeparations, separation);
+	}
+}
+
+// Hashset filter func to throw away separations for pairs that left the broadphase.
+cpBool
+cpSpaceSeparationSetFilter(struct cpSeparation *separation, cpSpace *space)
+{
+	if(separation->stamp != space->stamp){
+		cpArrayPush(space->pooledSeparations, separation);
+		return cpFalse;
+	}
+	
+	return cpTrue;
+}
+
+struct separationFilterContext {
+	cpSpace *space;
+	const cpShape *shape;
+};
+
+static cpBool
+cachedSeparationsFilter(struct cpSeparation *separation, struct separationFilterContext *context)
+{
+	const cpShape *shape = context->shape;
+	
+	// Match on the filter shape, or everything if it's NULL.
+	if(shape == NULL || separation->a == shape || separation->b == shape){
+		cpArrayPush(context->space->pooledSeparations, separation);
+		return cpFalse;
+	}
+	
+	return cpTrue;
+}
+
+void
+cpSpaceFilterSeparations(cpSpace *space, const cpShape *filter)
+{
+	if(cpHashSetCount(space->cachedSeparations) == 0) return;
+	
+	if(filter && filter->klass->type == CP_COMPOUND_SHAPE){
+		// The separations of a compound are cached for its children.
+		cpCompoundShape *compound = (cpCompoundShape *)filter;
+		for(int i=0; i<compound->count; i++) cpSpaceFilterSeparations(space, compound->shapes[i]);
+	} else {
+		struct separationFilterContext context = {space, filter};
+		cpHashSetFilter(space->cachedSeparations, (cpHashSetFilterFunc)cachedSeparationsFilter, &context);
+	}
+}
+
+//MARK: Collision ID Caching
+
+// Collision IDs let the narrowphase start from where it left off on the previous step.
+// The spatial indexes keep them for the pairs they find, but not for pairs the space finds itself,
+// like the children of compound shapes, or when cpHastySpace runs the narrowphase after the broadphase returns.
+
+static void *
+cpSpacePairIDSetTrans(const cpShape **shapes, cpSpace *space)
+{
+	if(space->pooledPairIDs->num == 0){
+		// pair ID pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(struct cpPairID);
+		cpAssertHard(count, "Internal Error: Buffer size too small.");
+		
+		struct cpPairID *buffer = (struct cpPairID *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpArrayPush(space->allocatedBuffers, buffer);
+		
+		for(int i=0; i<count; i++) cpArrayPush(space->pooledPairIDs, buffer + i);
+	}
+	
+	struct cpPairID *pairID = (struct cpPairID *)cpArrayPop(space->pooledPairIDs);
+	pairID->a = shapes[0];
+	pairID->b = shapes[1];
+	
+	return pairID;
+}
+
+struct cpPairID *
+cpSpacePairID(cpSpace *space, const cpShape *a, const cpShape *b, cpCollisionID id)
+{
+	const cpShape *shape_pair[] = {a, b};
+	cpHashValue hash = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
+	
+	struct cpPairID *pairID = (struct cpPairID *)cpHashSetFind(space->cachedPairIDs, hash, shape_pair);
+	if(pairID == NULL){
+		pairID = (struct cpPairID *)cpHashSetInsert(space->cachedPairIDs, hash, shape_pair, (cpHashSetTransFunc)cpSpacePairIDSetTrans, space);
+		pairID->id = id;
+	}
+	
+	pairID->stamp = space->stamp;
+	return pairID;
+}
+
+// Hashset filter func to throw away the IDs of pairs that weren't found this step.
+cpBool
+cpSpacePairIDSetFilter(struct cpPairID *pairID, cpSpace *space)
+{
+	if(pairID->stamp != space->stamp){
+		cpArrayPush(space->pooledPairIDs, pairID);
+		return cpFalse;
+	}
+	
+	return cpTrue;
+}
+
+struct pairIDFilterContext {
+	cpSpace *space;
+	const cpShape *shape;
+};
+
+static cpBool
+cachedPairIDsFilter(struct cpPairID *pairID, struct pairIDFilterContext *context)
+{
+	const cpShape *shape = context->shape;
+	
+	if(pairID->a == shape || pairID->b == shape){
+		cpArrayPush(context->space->pooledPairIDs, pairID);
+		return cpFalse;
+	}
+	
+	return cpTrue;
+}
+
+void
+cpSpaceFilterPairIDs(cpSpace *space, const cpShape *filter)
+{
+	if(cpHashSetCount(space->cachedPairIDs) == 0) return;
+	
+	if(filter->klass->type == CP_COMPOUND_SHAPE){
+		// The collision IDs of a compound are kept for its children.
+		cpCompoundShape *compound = (cpCompoundShape *)filter;
+		for(int i=0; i<compound->count; i++) cpSpaceFilterPairIDs(space, compound->shapes[i]);
+	} else {
+		struct pairIDFilterContext context = {space, filter};
+		cpHashSetFilter(space->cachedPairIDs, (cpHashSetFilterFunc)cachedPairIDsFilter, &context);
+	}
+}
+
 //MARK: Collision Detection Functions
 
 static void *
@@ -201,34 +433,25 @@ cpSpaceArbiterSetTrans(cpShape **shapes, cpSpace *space)
 	return cpArbiterInit((cpArbiter *)cpArrayPop(space->pooledArbiters), shapes[0], shapes[1]);
 }
 
-static inline cpBool
-QueryRejectConstraint(cpBody *a, cpBody *b)
-{
-	CP_BODY_FOREACH_CONSTRAINT(a, constraint){
-		if(
-			!constraint->collideBodies && (
-				(constraint->a == a && constraint->b == b) ||
-				(constraint->a == b && constraint->b == a)
-			)
-		) return cpTrue;
-	}
-	
-	return cpFalse;
-}
+struct CompoundCollideContext {
+	cpShape *other;
+	cpSpace *space;
+};
 
-static inline cpBool
-QueryReject(cpShape *a, cpShape *b)
+static void
+CompoundChildCollide(cpShape *child, int index, struct CompoundCollideContext *context)
 {
-	return (
-		// BBoxes must overlap
-		!cpBBIntersects(a->bb, b->bb)
-		// Don't collide shapes attached to the same body.
-		|| a->body == b->body
-		// Don't collide shapes that are filtered.
-		|| cpShapeFilterReject(a->filter, b->filter)
-		// Don't collide bodies if they have a constraint with collideBodies == cpFalse.
-		|| QueryRejectConstraint(a->body, b->body)
-	);
+	cpShape *other = context->other;
+	cpSpace *space = context->space;
+	
+	if(other->klass->type == CP_COMPOUND_SHAPE){
+		// Descend into the other compound to find the pairs of children.
+		cpSpaceCollideShapes(child, other, 0, space);
+	} else if(!cpSpaceQueryReject(child, other)){
+		// The spatial index only knows about the compound, so the space keeps the child pair's collision ID.
+		struct cpPairID *pairID = cpSpacePairID(space, child, other, 0);
+		pairID->id = cpSpaceCollideShapes(child, other, pairID->id, space);
+	}
 }
 
 // Callback from the spatial hash.
@@ -236,20 +459,42 @@ cpCollisionID
 cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 {
 	// Reject any of the simple cases
-	if(QueryReject(a,b)) return id;
+	if(cpSpaceQueryReject(a,b)) return id;
+	
+	// Collide the overlapping children of compound shapes individually so they each get their own arbiter.
+	if(a->klass->type == CP_COMPOUND_SHAPE || b->klass->type == CP_COMPOUND_SHAPE){
+		cpCompoundShape *compound = (cpCompoundShape *)(a->klass->type == CP_COMPOUND_SHAPE ? a : b);
+		struct CompoundCollideContext context = {(compound == (cpCompoundShape *)a ? b : a), space};
+		cpCompoundShapeQueryShapes(compound, context.other->bb, (cpCompoundShapeIteratorFunc)CompoundChildCollide, &context);
+		return id;
+	}
+	
+	// Skip the narrowphase if the shapes haven't moved far enough to close the gap since they were last measured.
+	struct cpSeparation *separation = NULL;
+	if(space->cacheSeparations && cpSpaceSeparationHolds(space, a, b, &separation)) return id;
 	
 	// Narrow-phase collision detection.
 	struct cpCollisionInfo info = cpCollide(a, b, id, cpContactBufferGetArray(space));
+	if(space->cacheSeparations) cpSpaceCacheSeparation(space, separation, &info);
 	
 	if(info.count == 0) return info.id; // Shapes are not colliding.
 	cpSpacePushContacts(space, info.count);
 	
+	cpSpaceProcessCollision(space, &info);
+	return info.id;
+}
+
+void
+cpSpaceProcessCollision(cpSpace *space, struct cpCollisionInfo *info)
+{
+	const cpShape *a = info->a, *b = info->b;
+	
 	// Get an arbiter from space->arbiterSet for the two shapes.
 	// This is where the persistant contact magic comes from.
-	const cpShape *shape_pair[] = {info.a, info.b};
-	cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)info.a, (cpHashValue)info.b);
+	const cpShape *shape_pair[] = {a, b};
+	cpHashValue arbHashID = CP_HASH_PAIR((cpHashValue)a, (cpHashValue)b);
 	cpArbiter *arb = (cpArbiter *)cpHashSetInsert(space->cachedArbiters, arbHashID, shape_pair, (cpHashSetTransFunc)cpSpaceArbiterSetTrans, space);
-	cpArbiterUpdate(arb, &info, space);
+	cpArbiterUpdate(arb, info, space);
 	
 	cpCollisionHandler *handler = arb->handler;
 	
@@ -273,7 +518,7 @@ cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 	){
 		cpArrayPush(space->arbiters, arb);
 	} else {
-		cpSpacePopContacts(space, info.count);
+		cpSpacePopContacts(space, info->count);
 		
 		arb->contacts = NULL;
 		arb->count = 0;
@@ -285,7 +530,6 @@ cpSpaceCollideShapes(cpShape *a, cpShape *b, cpCollisionID id, cpSpace *space)
 	
 	// Time stamp the arbiter so we know it was used recently.
 	arb->stamp = space->stamp;
-	return info.id;
 }
 
 // Hashset filter func to throw away old arbiters.
@@ -324,6 +568,137 @@ cpSpaceArbiterSetFilter(cpArbiter *arb, cpSpace *space)
 	return cpTrue;
 }
 
+//MARK: Constraint Buckets
+
+static inline int
+cpSpaceBucketForClass(cpSpace *space, const cpConstraintClass *klass, int last)
+{
+	// Constraints are usually still sorted from the previous step, so check the last bucket first.
+	if(last >= 0 && space->constraintBuckets[last].klass == klass) return last;
+	
+	for(int i=0; i<space->constraintBucketCount; i++){
+		if(space->constraintBuckets[i].klass == klass) return i;
+	}
+	
+	if(space->constraintBucketCount == space->constraintBucketCapacity){
+		space->constraintBucketCapacity = (space->constraintBucketCapacity ? 2*space->constraintBucketCapacity : 16);
+		space->constraintBuckets = (struct cpConstraintBucket *)cprealloc(space->constraintBuckets, space->constraintBucketCapacity*sizeof(struct cpConstraintBucket));
+	}
+	
+	struct cpConstraintBucket *bucket = space->constraintBuckets + space->constraintBucketCount;
+	bucket->klass = klass;
+	bucket->start = bucket->count = 0;
+	
+	return space->constraintBucketCount++;
+}
+
+void
+cpSpaceSortConstraints(cpSpace *space)
+{
+	cpArray *constraints = space->constraints;
+	space->constraintBucketCount = 0;
+	
+	// Count the constraints of each class. Buckets are ordered by the first constraint of each class.
+	for(int i=0, bucket=-1; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		bucket = cpSpaceBucketForClass(space, constraint->klass, bucket);
+		space->constraintBuckets[bucket].count++;
+	}
+	
+	// A single bucket is already sorted.
+	if(space->constraintBucketCount <= 1){
+		if(space->constraintBucketCount) space->constraintBuckets[0].start = 0;
+		return;
+	}
+	
+	for(int i=1; i<space->constraintBucketCount; i++){
+		struct cpConstraintBucket *prev = space->constraintBuckets + i - 1;
+		space->constraintBuckets[i].start = prev->start + prev->count;
+	}
+	
+	cpArray *sorted = space->sortedConstraints;
+	if(sorted->max < constraints->num){
+		sorted->max = constraints->num;
+		sorted->arr = (void **)cprealloc(sorted->arr, sorted->max*sizeof(void*));
+	}
+	
+	// Stable counting sort so the solving order is deterministic.
+	// The counts are recomputed as the bucket cursors while filling.
+	for(int i=0; i<space->constraintBucketCount; i++) space->constraintBuckets[i].count = 0;
+	
+	for(int i=0, bucket=-1; i<constraints->num; i++){
+		cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
+		bucket = cpSpaceBucketForClass(space, constraint->klass, bucket);
+		
+		struct cpConstraintBucket *b = space->constraintBuckets + bucket;
+		sorted->arr[b->start + b->count++] = constraint;
+	}
+	
+	// Swap the storage of the two arrays.
+	void **arr = constraints->arr; int max = constraints->max;
+	constraints->arr = sorted->arr; constraints->max = sorted->max;
+	sorted->arr = arr; sorted->max = max;
+}
+
+void
+cpSpacePreStepConstraints(cpSpace *space, cpFloat dt)
+{
+	cpConstraint **constraints = (cpConstraint **)space->constraints->arr;
+	
+	for(int i=0; i<space->constraintBucketCount; i++){
+		struct cpConstraintBucket *bucket = space->constraintBuckets + i;
+		const cpConstraintClass *klass = bucket->klass;
+		
+		if(klass->preStepBatch){
+			klass->preStepBatch(constraints + bucket->start, bucket->count, dt);
+		} else {
+			for(int j=bucket->start; j<bucket->start + bucket->count; j++) klass->preStep(constraints[j], dt);
+		}
+	}
+}
+
+void
+cpSpaceApplyCachedConstraintImpulses(cpSpace *space, cpFloat dt_coef)
+{
+	cpConstraint **constraints = (cpConstraint **)space->constraints->arr;
+	
+	for(int i=0; i<space->constraintBucketCount; i++){
+		struct cpConstraintBucket *bucket = space->constraintBuckets + i;
+		const cpConstraintClass *klass = bucket->klass;
+		
+		if(klass->applyCachedImpulseBatch){
+			klass->applyCachedImpulseBatch(constraints + bucket->start, bucket->count, dt_coef);
+		} else {
+			for(int j=bucket->start; j<bucket->start + bucket->count; j++) klass->applyCachedImpulse(constraints[j], dt_coef);
+		}
+	}
+}
+
+cpFloat
+cpSpaceApplyConstraintImpulses(cpSpace *space, cpFloat dt)
+{
+	cpConstraint **constraints = (cpConstraint **)space->constraints->arr;
+	cpFloat delta = 0.0f;
+	
+	// The change only needs to be measured when the solver can stop early.
+	cpBool measure = (space->solverTolerance > 0.0f);
+	
+	for(int i=0; i<space->constraintBucketCount; i++){
+		struct cpConstraintBucket *bucket = space->constraintBuckets + i;
+		const cpConstraintClass *klass = bucket->klass;
+		
+		if(klass->applyImpulseBatch){
+			delta = cpfmax(delta, klass->applyImpulseBatch(constraints + bucket->start, bucket->count, dt));
+		} else if(measure){
+			for(int j=bucket->start; j<bucket->start + bucket->count; j++) delta = cpfmax(delta, cpConstraintApplyImpulseDelta(constraints[j], dt));
+		} else {
+			for(int j=bucket->start; j<bucket->start + bucket->count; j++) klass->applyImpulse(constraints[j], dt);
+		}
+	}
+	
+	return delta;
+}
+
 //MARK: All Important cpSpaceStep() Function
 
  void
@@ -332,18 +707,111 @@ cpShapeUpdateFunc(cpShape *shape, void *unused)
 	cpShapeCacheBB(shape);
 }
 
+// Run the impulse solver iterations and return the number of iterations used.
+static int
+cpSpaceSolve(cpSpace *space, cpFloat dt)
+{
+	if(space->packedSolver) return cpSpaceSolvePacked(space, dt);
+	
+	cpArray *arbiters = space->arbiters;
+	
+	// Overlap is resolved by the position solver instead of bias velocities when it's enabled.
+	cpFloat (*applyImpulse)(cpArbiter *arb) = (space->positionIterations ? cpArbiterApplyVelocityImpulse : cpArbiterApplyImpulse);
+	
+	int iterations = 0;
+	while(iterations < space->iterations){
+		cpFloat delta = 0.0f;
+		for(int j=0; j<arbiters->num; j++){
+			delta = cpfmax(delta, applyImpulse((cpArbiter *)arbiters->arr[j]));
+		}
+		
+		delta = cpfmax(delta, cpSpaceApplyConstraintImpulses(space, dt));
+		iterations++;
+		
+		// Stop early once the impulses have converged.
+		if(delta < space->solverTolerance) break;
+	}
+	
+	return iterations;
+}
+
+// Push overlapping bodies apart by moving them directly instead of using bias velocities.
+// Each iteration corrects the same fraction of the overlap so the total correction per step matches the collision bias.
+static void
+cpSpaceSolvePositions(cpSpace *space, cpFloat dt)
+{
+	cpArray *arbiters = space->arbiters;
+	cpArray *bodies = space->dynamicBodies;
+	cpFloat slop = space->collisionSlop;
+	cpFloat bias = 1.0f - cpfpow(space->collisionBias, dt/space->positionIterations);
+	
+	for(int i=0; i<space->positionIterations; i++){
+		cpFloat depth = 0.0f;
+		for(int j=0; j<arbiters->num; j++){
+			depth = cpfmax(depth, cpArbiterSolvePosition((cpArbiter *)arbiters->arr[j], slop, bias));
+		}
+		
+		// Nothing overlaps by more than the slop.
+		if(depth == 0.0f) break;
+	}
+	
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody *)bodies->arr[i];
+		if(body->solver.dp.x == 0.0f && body->solver.dp.y == 0.0f && body->solver.da == 0.0f) continue;
+		
+		cpBodyCorrectPosition(body, body->solver.dp, body->solver.da);
+		body->solver.dp = cpvzero;
+		body->solver.da = 0.0f;
+		
+		CP_BODY_FOREACH_SHAPE(body, shape) cpShapeCacheBB(shape);
+	}
+}
+
+static void
+cpSpaceIntegrateVelocities(cpSpace *space, cpFloat dt)
+{
+	cpArray *bodies = space->dynamicBodies;
+	cpFloat damping = cpfpow(space->damping, dt);
+	cpVect gravity = space->gravity;
+	
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody *)bodies->arr[i];
+		body->velocity_func(body, gravity, damping, dt);
+	}
+}
+
+static void
+cpSpaceIntegratePositions(cpSpace *space, cpFloat dt)
+{
+	cpArray *bodies = space->dynamicBodies;
+	
+	for(int i=0; i<bodies->num; i++){
+		cpBody *body = (cpBody *)bodies->arr[i];
+		body->position_func(body, dt);
+	}
+}
+
 void
 cpSpaceStep(cpSpace *space, cpFloat dt)
 {
+	cpSpaceStepSubsteps(space, dt, 1);
+}
+
+void
+cpSpaceStepSubsteps(cpSpace *space, cpFloat dt, int substeps)
+{
+	cpAssertHard(substeps > 0, "The number of substeps must be positive and non-zero.");
+	
 	// don't step if the timestep is 0!
 	if(dt == 0.0f) return;
 	
 	space->stamp++;
 	
+	// Callbacks see the substep's timestep so impulses can still be converted to forces.
+	cpFloat h = dt/substeps;
 	cpFloat prev_dt = space->curr_dt;
-	space->curr_dt = dt;
+	space->curr_dt = h;
 		
-	cpArray *bodies = space->dynamicBodies;
 	cpArray *constraints = space->constraints;
 	cpArray *arbiters = space->arbiters;
 	
@@ -361,10 +829,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 
 	cpSpaceLock(space); {
 		// Integrate positions
-		for(int i=0; i<bodies->num; i++){
-			cpBody *body = (cpBody *)bodies->arr[i];
-			body->position_func(body, dt);
-		}
+		cpSpaceIntegratePositions(space, h);
 		
 		// Find colliding pairs.
 		cpSpacePushFreshContactBuffer(space);
@@ -375,57 +840,80 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 	// Rebuild the contact graph (and detect sleeping components if sleeping is enabled)
 	cpSpaceProcessComponents(space, dt);
 	
+	// The constraints array won't change again until the step is over.
+	cpSpaceSortConstraints(space);
+	
 	cpSpaceLock(space); {
 		// Clear out old cached arbiters and call separate callbacks
 		cpHashSetFilter(space->cachedArbiters, (cpHashSetFilterFunc)cpSpaceArbiterSetFilter, space);
+		// Clear out separations for pairs that weren't found this step.
+		if(space->cacheSeparations) cpHashSetFilter(space->cachedSeparations, (cpHashSetFilterFunc)cpSpaceSeparationSetFilter, space);
+		// Clear out collision IDs for pairs that weren't found this step.
+		if(cpHashSetCount(space->cachedPairIDs)) cpHashSetFilter(space->cachedPairIDs, (cpHashSetFilterFunc)cpSpacePairIDSetFilter, space);
 
 		// Prestep the arbiters and constraints.
 		cpFloat slop = space->collisionSlop;
-		cpFloat biasCoef = 1.0f - cpfpow(space->collisionBias, dt);
+		cpFloat biasCoef = (space->positionIterations ? 0.0f : 1.0f - cpfpow(space->collisionBias, h));
 		for(int i=0; i<arbiters->num; i++){
-			cpArbiterPreStep((cpArbiter *)arbiters->arr[i], dt, slop, biasCoef);
+			cpArbiterPreStep((cpArbiter *)arbiters->arr[i], h, slop, biasCoef, space->blockSolver);
 		}
+		
+		// The position solver runs before the constraints are prestepped so they see the corrected positions.
+		if(space->positionIterations) cpSpaceSolvePositions(space, h);
 
 		for(int i=0; i<constraints->num; i++){
 			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
 			
 			cpConstraintPreSolveFunc preSolve = constraint->preSolve;
 			if(preSolve) preSolve(constraint, space);
-			
-			constraint->klass->preStep(constraint, dt);
 		}
+		
+		cpSpacePreStepConstraints(space, h);
 	
 		// Integrate velocities.
-		cpFloat damping = cpfpow(space->damping, dt);
-		cpVect gravity = space->gravity;
-		for(int i=0; i<bodies->num; i++){
-			cpBody *body = (cpBody *)bodies->arr[i];
-			body->velocity_func(body, gravity, damping, dt);
-		}
+		cpSpaceIntegrateVelocities(space, h);
 		
 		// Apply cached impulses
-		cpFloat dt_coef = (prev_dt == 0.0f ? 0.0f : dt/prev_dt);
+		cpFloat dt_coef = (prev_dt == 0.0f ? 0.0f : h/prev_dt);
 		for(int i=0; i<arbiters->num; i++){
 			cpArbiterApplyCachedImpulse((cpArbiter *)arbiters->arr[i], dt_coef);
 		}
 		
-		for(int i=0; i<constraints->num; i++){
-			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
-			constraint->klass->applyCachedImpulse(constraint, dt_coef);
-		}
+		cpSpaceApplyCachedConstraintImpulses(space, dt_coef);
 		
 		// Run the impulse solver.
-		for(int i=0; i<space->iterations; i++){
-			for(int j=0; j<arbiters->num; j++){
-				cpArbiterApplyImpulse((cpArbiter *)arbiters->arr[j]);
+		space->iterationsUsed = cpSpaceSolve(space, h);
+		
+		// The remaining substeps reuse the contacts found above.
+		// Only the bias velocities are updated from the new positions, and the bias velocities
+		// are discarded when integrating the positions, so overlap is resolved without adding energy.
+		for(int substep=1; substep<substeps; substep++){
+			cpSpaceIntegratePositions(space, h);
+			
+			if(space->positionIterations){
+				cpSpaceSolvePositions(space, h);
+			} else {
+				for(int i=0; i<arbiters->num; i++){
+					cpArbiterUpdateBias((cpArbiter *)arbiters->arr[i], h, slop, biasCoef);
+				}
 			}
-				
-			for(int j=0; j<constraints->num; j++){
-				cpConstraint *constraint = (cpConstraint *)constraints->arr[j];
-				constraint->klass->applyImpulse(constraint, dt);
+			
+			cpSpacePreStepConstraints(space, h);
+			cpSpaceIntegrateVelocities(space, h);
+			
+			// Warm start with the impulses from the previous substep.
+			for(int i=0; i<arbiters->num; i++){
+				cpArbiterApplyAccumulatedImpulse((cpArbiter *)arbiters->arr[i]);
 			}
+			
+			cpSpaceApplyCachedConstraintImpulses(space, 1.0f);
+			
+			space->iterationsUsed += cpSpaceSolve(space, h);
 		}
 		
+		// Keep the shapes in sync with the bodies moved by the extra substeps.
+		if(substeps > 1) cpSpatialIndexEach(space->dynamicShapes, (cpSpatialIndexIteratorFunc)cpShapeUpdateFunc, NULL);
+		
 		// Run the constraint post-solve callbacks
 		for(int i=0; i<constraints->num; i++){
 			cpConstraint *constraint = (cpConstraint *)constraints->arr[i];
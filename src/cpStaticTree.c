@@ -0,0 +1,404 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chipmunk/chipmunk_private.h"
+
+static inline cpSpatialIndexClass *Klass();
+
+//MARK: Basic Structures
+
+// Nodes are stored depth first, so the first child of a branch is the next node in the array.
+typedef struct Node {
+	cpBB bb;
+	// Index of the first node after this node's subtree. Traversals jump here when the bounds are missed.
+	int skip;
+	// Index of the object for leaves, or -1 for branches.
+	int obj;
+} Node;
+
+typedef struct Item {
+	void *obj;
+	cpBB bb;
+} Item;
+
+struct cpStaticTree {
+	cpSpatialIndex spatialIndex;
+	
+	cpHashSet *objs;
+	
+	// The packed tree and the objects in leaf order.
+	Node *nodes;
+	int nodeCount, nodeCapacity;
+	void **leafObjs;
+	
+	// Set when objects are added, removed or moved and the tree needs to be rebuilt.
+	cpBool dirty;
+};
+
+//MARK: Building
+
+// Number of candidate split planes per axis evaluated by the SAH builder.
+#define SAH_BINS 16
+
+// Half the perimeter is the 2D equivalent of the surface area.
+static inline cpFloat
+BBCost(cpBB bb)
+{
+	return (bb.r - bb.l) + (bb.t - bb.b);
+}
+
+static inline cpFloat
+BBCenter(cpBB bb, int axis)
+{
+	return (axis == 0 ? bb.l + bb.r : bb.b + bb.t)*0.5f;
+}
+
+// Build the subtree over 'items' using binned SAH splits, appending its nodes depth first.
+static void
+BuildSubtree(cpStaticTree *tree, Item *items, int first, int count)
+{
+	int node = tree->nodeCount++;
+	
+	if(count == 1){
+		Node leaf = {items[first].bb, node + 1, first};
+		tree->nodes[node] = leaf;
+		return;
+	}
+	
+	// Find the bounds and the range of the item centers.
+	cpBB bounds = items[first].bb;
+	cpBB centers = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+	for(int i=first; i<first + count; i++){
+		bounds = cpBBMerge(bounds, items[i].bb);
+		centers = cpBBExpand(centers, cpBBCenter(items[i].bb));
+	}
+	
+	int bestAxis = -1, bestSplit = 0;
+	cpFloat bestCost = INFINITY;
+	
+	for(int axis=0; axis<2; axis++){
+		cpFloat min = (axis == 0 ? centers.l : centers.b);
+		cpFloat max = (axis == 0 ? centers.r : centers.t);
+		if(max <= min) continue;
+		
+		cpFloat scale = SAH_BINS/(max - min);
+		cpBB binBB[SAH_BINS];
+		int binCount[SAH_BINS] = {0};
+		
+		for(int i=first; i<first + count; i++){
+			cpBB bb = items[i].bb;
+			int bin = cpfclamp((BBCenter(bb, axis) - min)*scale, 0, SAH_BINS - 1);
+			binBB[bin] = (binCount[bin] ? cpBBMerge(binBB[bin], bb) : bb);
+			binCount[bin]++;
+		}
+		
+		// Sweep from the right to find the cost of everything to the right of each split.
+		cpFloat rightCost[SAH_BINS];
+		cpBB bb = {0.0f, 0.0f, 0.0f, 0.0f};
+		for(int i=SAH_BINS - 1, n=0; i>0; i--){
+			if(binCount[i]){
+				bb = (n ? cpBBMerge(bb, binBB[i]) : binBB[i]);
+				n += binCount[i];
+			}
+			
+			rightCost[i] = BBCost(bb)*n;
+		}
+		
+		// Then sweep from the left and combine them.
+		for(int i=0, n=0; i<SAH_BINS - 1; i++){
+			if(binCount[i]){
+				bb = (n ? cpBBMerge(bb, binBB[i]) : binBB[i]);
+				n += binCount[i];
+			}
+			
+			cpFloat cost = BBCost(bb)*n + rightCost[i + 1];
+			if(n > 0 && n < count && cost < bestCost){
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i + 1;
+			}
+		}
+	}
+	
+	// Partition the items. Items with identical centers are split down the middle.
+	int right = count/2;
+	if(bestAxis >= 0){
+		cpFloat min = (bestAxis == 0 ? centers.l : centers.b);
+		cpFloat max = (bestAxis == 0 ? centers.r : centers.t);
+		cpFloat scale = SAH_BINS/(max - min);
+		
+		right = count;
+		for(int left=0; left < right;){
+			Item item = items[first + left];
+			int bin = cpfclamp((BBCenter(item.bb, bestAxis) - min)*scale, 0, SAH_BINS - 1);
+			
+			if(bin >= bestSplit){
+				right--;
+				items[first + left] = items[first + right];
+				items[first + right] = item;
+			} else {
+				left++;
+			}
+		}
+	}
+	
+	BuildSubtree(tree, items, first, right);
+	BuildSubtree(tree, items, first + right, count - right);
+	
+	Node branch = {bounds, tree->nodeCount, -1};
+	tree->nodes[node] = branch;
+}
+
+typedef struct buildContext {
+	cpStaticTree *tree;
+	Item *items;
+	int count;
+} buildContext;
+
+static void
+fillItems(void *obj, buildContext *context)
+{
+	Item item = {obj, context->tree->spatialIndex.bbfunc(obj)};
+	context->items[context->count++] = item;
+}
+
+static void
+cpStaticTreeBuild(cpStaticTree *tree)
+{
+	int count = cpHashSetCount(tree->objs);
+	
+	if(2*count > tree->nodeCapacity){
+		tree->nodeCapacity = 2*count;
+		cpfree(tree->nodes);
+		cpfree(tree->leafObjs);
+		tree->nodes = (Node *)cpcalloc(tree->nodeCapacity, sizeof(Node));
+		tree->leafObjs = (void **)cpcalloc(count, sizeof(void *));
+	}
+	
+	tree->nodeCount = 0;
+	tree->dirty = cpFalse;
+	if(count == 0) return;
+	
+	Item *items = (Item *)cpcalloc(count, sizeof(Item));
+	buildContext context = {tree, items, 0};
+	cpHashSetEach(tree->objs, (cpHashSetIteratorFunc)fillItems, &context);
+	
+	BuildSubtree(tree, items, 0, count);
+	for(int i=0; i<count; i++) tree->leafObjs[i] = items[i].obj;
+	
+	cpfree(items);
+}
+
+static inline void
+cpStaticTreeUpdate(cpStaticTree *tree)
+{
+	if(tree->dirty) cpStaticTreeBuild(tree);
+}
+
+//MARK: Memory Management Functions
+
+cpStaticTree *
+cpStaticTreeAlloc(void)
+{
+	return (cpStaticTree *)cpcalloc(1, sizeof(cpStaticTree));
+}
+
+static int
+objSetEql(void *obj, void *elt)
+{
+	return (obj == elt);
+}
+
+cpSpatialIndex *
+cpStaticTreeInit(cpStaticTree *tree, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	cpSpatialIndexInit((cpSpatialIndex *)tree, Klass(), bbfunc, staticIndex);
+	
+	tree->objs = cpHashSetNew(0, (cpHashSetEqlFunc)objSetEql);
+	
+	tree->nodes = NULL;
+	tree->nodeCount = tree->nodeCapacity = 0;
+	tree->leafObjs = NULL;
+	
+	tree->dirty = cpFalse;
+	
+	return (cpSpatialIndex *)tree;
+}
+
+cpSpatialIndex *
+cpStaticTreeNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	return cpStaticTreeInit(cpStaticTreeAlloc(), bbfunc, staticIndex);
+}
+
+static void
+cpStaticTreeDestroy(cpStaticTree *tree)
+{
+	cpHashSetFree(tree->objs);
+	
+	cpfree(tree->nodes);
+	cpfree(tree->leafObjs);
+}
+
+//MARK: Basic Operations
+
+static void
+cpStaticTreeInsert(cpStaticTree *tree, void *obj, cpHashValue hashid)
+{
+	cpHashSetInsert(tree->objs, hashid, obj, NULL, obj);
+	tree->dirty = cpTrue;
+}
+
+static void
+cpStaticTreeRemove(cpStaticTree *tree, void *obj, cpHashValue hashid)
+{
+	if(cpHashSetRemove(tree->objs, hashid, obj)) tree->dirty = cpTrue;
+}
+
+//MARK: Reindexing Functions
+
+static void
+cpStaticTreeReindex(cpStaticTree *tree)
+{
+	cpStaticTreeBuild(tree);
+}
+
+static void
+cpStaticTreeReindexObject(cpStaticTree *tree, void *obj, cpHashValue hashid)
+{
+	// The tree is immutable, so any change rebuilds it before it is used next.
+	if(cpHashSetFind(tree->objs, hashid, obj)) tree->dirty = cpTrue;
+}
+
+//MARK: Query Functions
+
+static void
+cpStaticTreeQuery(cpStaticTree *tree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpStaticTreeUpdate(tree);
+	
+	Node *nodes = tree->nodes;
+	for(int i=0, count=tree->nodeCount; i<count;){
+		Node *node = nodes + i;
+		
+		if(cpBBIntersects(bb, node->bb)){
+			if(node->obj >= 0) func(obj, tree->leafObjs[node->obj], 0, data);
+			i++;
+		} else {
+			i = node->skip;
+		}
+	}
+}
+
+static void
+cpStaticTreeSegmentQuery(cpStaticTree *tree, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	cpStaticTreeUpdate(tree);
+	
+	// The nodes are visited in a fixed order instead of nearest first, but a closer hit still prunes the rest of the traversal.
+	Node *nodes = tree->nodes;
+	for(int i=0, count=tree->nodeCount; i<count;){
+		Node *node = nodes + i;
+		
+		if(cpBBSegmentQuery(node->bb, a, b) < t_exit){
+			if(node->obj >= 0) t_exit = cpfmin(t_exit, func(obj, tree->leafObjs[node->obj], data));
+			i++;
+		} else {
+			i = node->skip;
+		}
+	}
+}
+
+static void
+cpStaticTreeReindexQuery(cpStaticTree *tree, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpStaticTreeBuild(tree);
+	
+	// Query each leaf against the leaves after it so each pair is reported once.
+	Node *nodes = tree->nodes;
+	for(int leaf=0, count=tree->nodeCount; leaf<count; leaf++){
+		if(nodes[leaf].obj < 0) continue;
+		
+		cpBB bb = nodes[leaf].bb;
+		void *obj = tree->leafObjs[nodes[leaf].obj];
+		
+		for(int i=0; i<count;){
+			Node *node = nodes + i;
+			
+			if(node->skip > leaf + 1 && cpBBIntersects(bb, node->bb)){
+				if(node->obj >= 0) func(obj, tree->leafObjs[node->obj], 0, data);
+				i++;
+			} else {
+				i = node->skip;
+			}
+		}
+	}
+	
+	cpSpatialIndexCollideStatic((cpSpatialIndex *)tree, tree->spatialIndex.staticIndex, func, data);
+}
+
+//MARK: Misc
+
+static int
+cpStaticTreeCount(cpStaticTree *tree)
+{
+	return cpHashSetCount(tree->objs);
+}
+
+typedef struct eachContext {
+	cpSpatialIndexIteratorFunc func;
+	void *data;
+} eachContext;
+
+static void each_helper(void *obj, eachContext *context){context->func(obj, context->data);}
+
+static void
+cpStaticTreeEach(cpStaticTree *tree, cpSpatialIndexIteratorFunc func, void *data)
+{
+	eachContext context = {func, data};
+	cpHashSetEach(tree->objs, (cpHashSetIteratorFunc)each_helper, &context);
+}
+
+static cpBool
+cpStaticTreeContains(cpStaticTree *tree, void *obj, cpHashValue hashid)
+{
+	return (cpHashSetFind(tree->objs, hashid, obj) != NULL);
+}
+
+static cpSpatialIndexClass klass = {
+	(cpSpatialIndexDestroyImpl)cpStaticTreeDestroy,
+	
+	(cpSpatialIndexCountImpl)cpStaticTreeCount,
+	(cpSpatialIndexEachImpl)cpStaticTreeEach,
+	(cpSpatialIndexContainsImpl)cpStaticTreeContains,
+	
+	(cpSpatialIndexInsertImpl)cpStaticTreeInsert,
+	(cpSpatialIndexRemoveImpl)cpStaticTreeRemove,
+	
+	(cpSpatialIndexReindexImpl)cpStaticTreeReindex,
+	(cpSpatialIndexReindexObjectImpl)cpStaticTreeReindexObject,
+	(cpSpatialIndexReindexQueryImpl)cpStaticTreeReindexQuery,
+	
+	(cpSpatialIndexQueryImpl)cpStaticTreeQuery,
+	(cpSpatialIndexSegmentQueryImpl)cpStaticTreeSegmentQuery,
+};
+
+static inline cpSpatialIndexClass *Klass(){return &klass;}
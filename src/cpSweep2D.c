@@ -0,0 +1,626 @@
+/* Copyright (c) 2013 Scott Lembcke and Howling Moon Software
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chipmunk/chipmunk_private.h"
+
+static inline cpSpatialIndexClass *Klass();
+
+//MARK: Basic Structures
+
+typedef struct Proxy Proxy;
+
+// One end of an object's bounds along an axis.
+typedef struct Endpoint {
+	cpFloat value;
+	Proxy *proxy;
+	cpBool max;
+} Endpoint;
+
+struct Proxy {
+	void *obj;
+	cpBB bb;
+	// Indexes of the min and max endpoints on each axis.
+	int index[2][2];
+	// Position in the active list while rebuilding.
+	int active;
+};
+
+struct cpSweep2D
+{
+	cpSpatialIndex spatialIndex;
+	
+	cpHashSet *proxies;
+	
+	// Endpoints of all the proxies sorted along the x and y axes.
+	// They are kept between steps so that they are nearly sorted when the objects move.
+	Endpoint *endpoints[2];
+	int endpointCount, endpointCapacity;
+	
+	// Pairs of proxies with overlapping bounds.
+	cpPairTable pairs;
+	
+	// Upper bounds on the width and height of the proxies, used to limit the range of endpoints a query scans.
+	cpFloat maxExtent[2];
+	
+	// Proxies inserted since the endpoints were last updated.
+	cpArray *pending;
+	
+	Proxy *pooledProxies;
+	cpArray *allocatedBuffers;
+};
+
+static inline cpFloat
+BBMin(cpBB bb, int axis)
+{
+	return (axis == 0 ? bb.l : bb.b);
+}
+
+static inline cpFloat
+BBMax(cpBB bb, int axis)
+{
+	return (axis == 0 ? bb.r : bb.t);
+}
+
+static inline void
+ExtentGrow(cpSweep2D *sweep, cpBB bb)
+{
+	sweep->maxExtent[0] = cpfmax(sweep->maxExtent[0], bb.r - bb.l);
+	sweep->maxExtent[1] = cpfmax(sweep->maxExtent[1], bb.t - bb.b);
+}
+
+// Bounds that sort after all of the other endpoints and overlap nothing.
+static const cpBB InfiniteBB = {INFINITY, INFINITY, INFINITY, INFINITY};
+
+//MARK: Pair Events
+
+static inline void
+PairBegin(cpSweep2D *sweep, Proxy *a, Proxy *b)
+{
+	// The bounds only started to overlap on one axis.
+	if(cpBBIntersects(a->bb, b->bb)) cpPairTableInsert(&sweep->pairs, a, b);
+}
+
+static inline void
+PairEnd(cpSweep2D *sweep, Proxy *a, Proxy *b)
+{
+	cpPairTableRemove(&sweep->pairs, a, b);
+}
+
+//MARK: Endpoint Functions
+
+// Min endpoints sort before max endpoints with the same value so that touching bounds are treated as overlapping.
+static inline cpBool
+EndpointLess(Endpoint a, Endpoint b)
+{
+	return (a.value < b.value || (a.value == b.value && !a.max && b.max));
+}
+
+static inline void
+EndpointSet(cpSweep2D *sweep, int axis, int index, Endpoint endpoint)
+{
+	sweep->endpoints[axis][index] = endpoint;
+	endpoint.proxy->index[axis][endpoint.max] = index;
+}
+
+// Move an endpoint down the list to its sorted position, updating the pairs as it passes other endpoints.
+static void
+EndpointMoveDown(cpSweep2D *sweep, int axis, int index)
+{
+	Endpoint *endpoints = sweep->endpoints[axis];
+	Endpoint endpoint = endpoints[index];
+	
+	for(; index > 0 && EndpointLess(endpoint, endpoints[index - 1]); index--){
+		Endpoint prev = endpoints[index - 1];
+		
+		if(endpoint.max != prev.max){
+			if(endpoint.max){
+				PairEnd(sweep, endpoint.proxy, prev.proxy);
+			} else {
+				PairBegin(sweep, endpoint.proxy, prev.proxy);
+			}
+		}
+		
+		EndpointSet(sweep, axis, index, prev);
+	}
+	
+	EndpointSet(sweep, axis, index, endpoint);
+}
+
+// Move an endpoint up the list to its sorted position, updating the pairs as it passes other endpoints.
+static void
+EndpointMoveUp(cpSweep2D *sweep, int axis, int index)
+{
+	Endpoint *endpoints = sweep->endpoints[axis];
+	Endpoint endpoint = endpoints[index];
+	int last = sweep->endpointCount - 1;
+	
+	for(; index < last && EndpointLess(endpoints[index + 1], endpoint); index++){
+		Endpoint next = endpoints[index + 1];
+		
+		if(endpoint.max != next.max){
+			if(endpoint.max){
+				PairBegin(sweep, endpoint.proxy, next.proxy);
+			} else {
+				PairEnd(sweep, endpoint.proxy, next.proxy);
+			}
+		}
+		
+		EndpointSet(sweep, axis, index, next);
+	}
+	
+	EndpointSet(sweep, axis, index, endpoint);
+}
+
+// Move one of a proxy's endpoints to its sorted position after its value has changed.
+static inline void
+EndpointUpdate(cpSweep2D *sweep, Proxy *proxy, int axis, cpBool max)
+{
+	EndpointMoveDown(sweep, axis, proxy->index[axis][max]);
+	EndpointMoveUp(sweep, axis, proxy->index[axis][max]);
+}
+
+// Update the bounds of a proxy and move its endpoints to their sorted positions.
+static void
+ProxyMove(cpSweep2D *sweep, Proxy *proxy, cpBB bb)
+{
+	cpBB old = proxy->bb;
+	proxy->bb = bb;
+	
+	for(int axis=0; axis<2; axis++){
+		Endpoint *endpoints = sweep->endpoints[axis];
+		endpoints[proxy->index[axis][0]].value = BBMin(bb, axis);
+		endpoints[proxy->index[axis][1]].value = BBMax(bb, axis);
+		
+		// Move the leading endpoint first so the endpoints of the proxy never pass each other.
+		cpBool leading = (BBMin(bb, axis) > BBMin(old, axis));
+		EndpointUpdate(sweep, proxy, axis, leading);
+		EndpointUpdate(sweep, proxy, axis, !leading);
+	}
+}
+
+//MARK: Proxy Pool
+
+static void
+ProxyRecycle(cpSweep2D *sweep, Proxy *proxy)
+{
+	// Pooled proxies are linked through their obj pointers.
+	proxy->obj = sweep->pooledProxies;
+	sweep->pooledProxies = proxy;
+}
+
+static Proxy *
+ProxyFromPool(cpSweep2D *sweep)
+{
+	Proxy *proxy = sweep->pooledProxies;
+	
+	if(proxy){
+		sweep->pooledProxies = (Proxy *)proxy->obj;
+		return proxy;
+	} else {
+		// Pool is exhausted, make more
+		int count = CP_BUFFER_BYTES/sizeof(Proxy);
+		cpAssertHard(count, "Internal Error: Buffer size is too small.");
+		
+		Proxy *buffer = (Proxy *)cpcalloc(1, CP_BUFFER_BYTES);
+		cpArrayPush(sweep->allocatedBuffers, buffer);
+		
+		// push all but the first one, return the first instead
+		for(int i=1; i<count; i++) ProxyRecycle(sweep, buffer + i);
+		return buffer;
+	}
+}
+
+//MARK: Memory Management Functions
+
+cpSweep2D *
+cpSweep2DAlloc(void)
+{
+	return (cpSweep2D *)cpcalloc(1, sizeof(cpSweep2D));
+}
+
+static int
+proxySetEql(void *obj, Proxy *proxy)
+{
+	return (obj == proxy->obj);
+}
+
+static void *
+proxySetTrans(void *obj, cpSweep2D *sweep)
+{
+	Proxy *proxy = ProxyFromPool(sweep);
+	proxy->obj = obj;
+	proxy->bb = InfiniteBB;
+	
+	return proxy;
+}
+
+cpSpatialIndex *
+cpSweep2DInit(cpSweep2D *sweep, cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	cpSpatialIndexInit((cpSpatialIndex *)sweep, Klass(), bbfunc, staticIndex);
+	
+	sweep->proxies = cpHashSetNew(0, (cpHashSetEqlFunc)proxySetEql);
+	
+	sweep->endpoints[0] = sweep->endpoints[1] = NULL;
+	sweep->endpointCount = sweep->endpointCapacity = 0;
+	sweep->maxExtent[0] = sweep->maxExtent[1] = 0.0f;
+	
+	cpPairTableInit(&sweep->pairs);
+	sweep->pending = cpArrayNew(0);
+	
+	sweep->pooledProxies = NULL;
+	sweep->allocatedBuffers = cpArrayNew(0);
+	
+	return (cpSpatialIndex *)sweep;
+}
+
+cpSpatialIndex *
+cpSweep2DNew(cpSpatialIndexBBFunc bbfunc, cpSpatialIndex *staticIndex)
+{
+	return cpSweep2DInit(cpSweep2DAlloc(), bbfunc, staticIndex);
+}
+
+static void
+cpSweep2DDestroy(cpSweep2D *sweep)
+{
+	cpHashSetFree(sweep->proxies);
+	
+	cpfree(sweep->endpoints[0]);
+	cpfree(sweep->endpoints[1]);
+	
+	cpPairTableDestroy(&sweep->pairs);
+	cpArrayFree(sweep->pending);
+	
+	if(sweep->allocatedBuffers) cpArrayFreeEach(sweep->allocatedBuffers, cpfree);
+	cpArrayFree(sweep->allocatedBuffers);
+}
+
+//MARK: Misc
+
+static int
+cpSweep2DCount(cpSweep2D *sweep)
+{
+	return cpHashSetCount(sweep->proxies);
+}
+
+typedef struct eachContext {
+	cpSpatialIndexIteratorFunc func;
+	void *data;
+} eachContext;
+
+static void each_helper(Proxy *proxy, eachContext *context){context->func(proxy->obj, context->data);}
+
+static void
+cpSweep2DEach(cpSweep2D *sweep, cpSpatialIndexIteratorFunc func, void *data)
+{
+	eachContext context = {func, data};
+	cpHashSetEach(sweep->proxies, (cpHashSetIteratorFunc)each_helper, &context);
+}
+
+static cpBool
+cpSweep2DContains(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	return (cpHashSetFind(sweep->proxies, hashid, obj) != NULL);
+}
+
+//MARK: Pending Proxies
+
+// Proxies inserted since the last update have no endpoints yet.
+#define PENDING -1
+
+// Adding more than this many proxies at once re-sorts all of the endpoints instead of moving each new one into place.
+#define REBUILD_THRESHOLD 8
+
+static void
+EndpointsReserve(cpSweep2D *sweep, int count)
+{
+	if(count > sweep->endpointCapacity){
+		while(count > sweep->endpointCapacity) sweep->endpointCapacity = (sweep->endpointCapacity ? 2*sweep->endpointCapacity : 64);
+		
+		for(int axis=0; axis<2; axis++){
+			sweep->endpoints[axis] = (Endpoint *)cprealloc(sweep->endpoints[axis], sweep->endpointCapacity*sizeof(Endpoint));
+		}
+	}
+}
+
+static void
+ProxyAdd(cpSweep2D *sweep, Proxy *proxy)
+{
+	EndpointsReserve(sweep, sweep->endpointCount + 2);
+	
+	// Add the endpoints at the end of the lists and then move them into place.
+	int index = sweep->endpointCount;
+	sweep->endpointCount += 2;
+	
+	for(int axis=0; axis<2; axis++){
+		Endpoint min = {INFINITY, proxy, cpFalse}, max = {INFINITY, proxy, cpTrue};
+		EndpointSet(sweep, axis, index + 0, min);
+		EndpointSet(sweep, axis, index + 1, max);
+	}
+	
+	cpBB bb = sweep->spatialIndex.bbfunc(proxy->obj);
+	ExtentGrow(sweep, bb);
+	ProxyMove(sweep, proxy, bb);
+}
+
+static int
+EndpointCompare(const Endpoint *a, const Endpoint *b)
+{
+	return (EndpointLess(*a, *b) ? -1 : (EndpointLess(*b, *a) ? 1 : 0));
+}
+
+static void
+FillEndpoints(Proxy *proxy, cpSweep2D *sweep)
+{
+	cpBB bb = proxy->bb = sweep->spatialIndex.bbfunc(proxy->obj);
+	ExtentGrow(sweep, bb);
+	
+	int index = sweep->endpointCount;
+	sweep->endpointCount += 2;
+	
+	for(int axis=0; axis<2; axis++){
+		Endpoint min = {BBMin(bb, axis), proxy, cpFalse}, max = {BBMax(bb, axis), proxy, cpTrue};
+		sweep->endpoints[axis][index + 0] = min;
+		sweep->endpoints[axis][index + 1] = max;
+	}
+}
+
+// Sort all of the endpoints from scratch and find the pairs with a single sweep along the x axis.
+static void
+SweepRebuild(cpSweep2D *sweep)
+{
+	int count = cpHashSetCount(sweep->proxies);
+	EndpointsReserve(sweep, 2*count);
+	
+	sweep->endpointCount = 0;
+	sweep->maxExtent[0] = sweep->maxExtent[1] = 0.0f;
+	cpHashSetEach(sweep->proxies, (cpHashSetIteratorFunc)FillEndpoints, sweep);
+	
+	for(int axis=0; axis<2; axis++){
+		Endpoint *endpoints = sweep->endpoints[axis];
+		qsort(endpoints, sweep->endpointCount, sizeof(Endpoint), (int (*)(const void *, const void *))EndpointCompare);
+		for(int i=0; i<sweep->endpointCount; i++) endpoints[i].proxy->index[axis][endpoints[i].max] = i;
+	}
+	
+	// Proxies whose x bounds contain the sweep position.
+	Proxy **active = (Proxy **)cpcalloc(count, sizeof(Proxy *));
+	int activeCount = 0;
+	
+	cpPairTable pairs;
+	cpPairTableInit(&pairs);
+	
+	Endpoint *endpoints = sweep->endpoints[0];
+	for(int i=0; i<sweep->endpointCount; i++){
+		Proxy *proxy = endpoints[i].proxy;
+		
+		if(endpoints[i].max){
+			Proxy *last = active[--activeCount];
+			active[proxy->active] = last;
+			last->active = proxy->active;
+		} else {
+			for(int j=0; j<activeCount; j++){
+				if(cpBBIntersects(proxy->bb, active[j]->bb)){
+					// Keep the collision ids of pairs that already existed.
+					int old = cpPairTableFind(&sweep->pairs, proxy, active[j]);
+					int index = cpPairTableInsert(&pairs, proxy, active[j]);
+					if(old >= 0) pairs.pairs[index].id = sweep->pairs.pairs[old].id;
+				}
+			}
+			
+			proxy->active = activeCount;
+			active[activeCount++] = proxy;
+		}
+	}
+	
+	cpfree(active);
+	cpPairTableDestroy(&sweep->pairs);
+	sweep->pairs = pairs;
+	sweep->pending->num = 0;
+}
+
+// Add the endpoints of any pending proxies.
+static void
+SweepFlush(cpSweep2D *sweep)
+{
+	cpArray *pending = sweep->pending;
+	
+	if(pending->num > REBUILD_THRESHOLD){
+		SweepRebuild(sweep);
+	} else {
+		for(int i=0; i<pending->num; i++) ProxyAdd(sweep, (Proxy *)pending->arr[i]);
+		pending->num = 0;
+	}
+}
+
+//MARK: Basic Operations
+
+static void
+cpSweep2DInsert(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	Proxy *proxy = (Proxy *)cpHashSetInsert(sweep->proxies, hashid, obj, (cpHashSetTransFunc)proxySetTrans, sweep);
+	
+	// Defer adding the endpoints so that inserting many objects at once can be done with a single sort.
+	proxy->index[0][0] = PENDING;
+	cpArrayPush(sweep->pending, proxy);
+}
+
+static void
+cpSweep2DRemove(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	Proxy *proxy = (Proxy *)cpHashSetRemove(sweep->proxies, hashid, obj);
+	if(!proxy) return;
+	
+	if(proxy->index[0][0] == PENDING){
+		cpArrayDeleteObj(sweep->pending, proxy);
+	} else {
+		// Move the endpoints to the end of the lists, ending all of the proxy's pairs on the way.
+		ProxyMove(sweep, proxy, InfiniteBB);
+		sweep->endpointCount -= 2;
+	}
+	
+	ProxyRecycle(sweep, proxy);
+}
+
+//MARK: Reindexing Functions
+
+static void
+cpSweep2DReindexObject(cpSweep2D *sweep, void *obj, cpHashValue hashid)
+{
+	Proxy *proxy = (Proxy *)cpHashSetFind(sweep->proxies, hashid, obj);
+	if(proxy && proxy->index[0][0] != PENDING){
+		cpBB bb = sweep->spatialIndex.bbfunc(obj);
+		ExtentGrow(sweep, bb);
+		ProxyMove(sweep, proxy, bb);
+	}
+}
+
+static void
+UpdateProxy(Proxy *proxy, cpSweep2D *sweep)
+{
+	cpBB bb = proxy->bb = sweep->spatialIndex.bbfunc(proxy->obj);
+	ExtentGrow(sweep, bb);
+	
+	for(int axis=0; axis<2; axis++){
+		Endpoint *endpoints = sweep->endpoints[axis];
+		endpoints[proxy->index[axis][0]].value = BBMin(bb, axis);
+		endpoints[proxy->index[axis][1]].value = BBMax(bb, axis);
+	}
+}
+
+static void
+cpSweep2DReindex(cpSweep2D *sweep)
+{
+	if(sweep->pending->num > REBUILD_THRESHOLD){
+		// Rebuilding reads the current bounds of every proxy already.
+		SweepRebuild(sweep);
+	} else {
+		SweepFlush(sweep);
+		
+		sweep->maxExtent[0] = sweep->maxExtent[1] = 0.0f;
+		cpHashSetEach(sweep->proxies, (cpHashSetIteratorFunc)UpdateProxy, sweep);
+		
+		// The endpoints only move a little between steps, so insertion sort is nearly linear.
+		for(int axis=0; axis<2; axis++){
+			for(int i=1; i<sweep->endpointCount; i++) EndpointMoveDown(sweep, axis, i);
+		}
+	}
+}
+
+//MARK: Query Functions
+
+// Find the first endpoint with a value greater than 'value' (or greater or equal if 'inclusive' is false).
+static int
+EndpointSearch(cpSweep2D *sweep, int axis, cpFloat value, cpBool inclusive)
+{
+	Endpoint *endpoints = sweep->endpoints[axis];
+	int lo = 0, hi = sweep->endpointCount;
+	
+	while(lo < hi){
+		int mid = (lo + hi)/2;
+		cpFloat v = endpoints[mid].value;
+		if(v < value || (inclusive && v == value)) lo = mid + 1; else hi = mid;
+	}
+	
+	return lo;
+}
+
+static void
+cpSweep2DQuery(cpSweep2D *sweep, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	SweepFlush(sweep);
+	
+	// The min endpoint of every overlapping proxy lies between the end of the query bounds
+	// and the start of the query bounds minus the widest proxy on both axes.
+	// Scan the min endpoints along whichever axis has fewer endpoints in that range.
+	int bestAxis = 0, bestStart = 0, bestEnd = sweep->endpointCount;
+	
+	for(int axis=0; axis<2; axis++){
+		int start = EndpointSearch(sweep, axis, BBMin(bb, axis) - sweep->maxExtent[axis], cpFalse);
+		int end = EndpointSearch(sweep, axis, BBMax(bb, axis), cpTrue);
+		if(end - start < bestEnd - bestStart){bestAxis = axis; bestStart = start; bestEnd = end;}
+	}
+	
+	Endpoint *endpoints = sweep->endpoints[bestAxis];
+	for(int i=bestStart; i<bestEnd; i++){
+		Endpoint endpoint = endpoints[i];
+		Proxy *proxy = endpoint.proxy;
+		if(!endpoint.max && cpBBIntersects(bb, proxy->bb) && obj != proxy->obj) func(obj, proxy->obj, 0, data);
+	}
+}
+
+typedef struct segmentQueryContext {
+	cpSpatialIndexSegmentQueryFunc func;
+	void *data;
+} segmentQueryContext;
+
+static cpCollisionID
+SegmentQueryHelper(void *obj1, void *obj2, cpCollisionID id, segmentQueryContext *context)
+{
+	context->func(obj1, obj2, context->data);
+	return id;
+}
+
+static void
+cpSweep2DSegmentQuery(cpSweep2D *sweep, void *obj, cpVect a, cpVect b, cpFloat t_exit, cpSpatialIndexSegmentQueryFunc func, void *data)
+{
+	cpBB bb = cpBBExpand(cpBBNew(a.x, a.y, a.x, a.y), b);
+	segmentQueryContext context = {func, data};
+	cpSweep2DQuery(sweep, obj, bb, (cpSpatialIndexQueryFunc)SegmentQueryHelper, &context);
+}
+
+//MARK: Reindex/Query
+
+static void
+cpSweep2DReindexQuery(cpSweep2D *sweep, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpSweep2DReindex(sweep);
+	
+	// Report the current pairs.
+	cpPairTable *pairs = &sweep->pairs;
+	for(int i=0; i<pairs->count; i++){
+		struct cpPair *pair = pairs->pairs + i;
+		pair->id = func(((Proxy *)pair->a)->obj, ((Proxy *)pair->b)->obj, pair->id, data);
+	}
+	
+	// Reindex query is also responsible for colliding against the static index.
+	// Fortunately there is a helper function for that.
+	cpSpatialIndexCollideStatic((cpSpatialIndex *)sweep, sweep->spatialIndex.staticIndex, func, data);
+}
+
+static cpSpatialIndexClass klass = {
+	(cpSpatialIndexDestroyImpl)cpSweep2DDestroy,
+	
+	(cpSpatialIndexCountImpl)cpSweep2DCount,
+	(cpSpatialIndexEachImpl)cpSweep2DEach,
+	(cpSpatialIndexContainsImpl)cpSweep2DContains,
+	
+	(cpSpatialIndexInsertImpl)cpSweep2DInsert,
+	(cpSpatialIndexRemoveImpl)cpSweep2DRemove,
+	
+	(cpSpatialIndexReindexImpl)cpSweep2DReindex,
+	(cpSpatialIndexReindexObjectImpl)cpSweep2DReindexObject,
+	(cpSpatialIndexReindexQueryImpl)cpSweep2DReindexQuery,
+	
+	(cpSpatialIndexQueryImpl)cpSweep2DQuery,
+	(cpSpatialIndexSegmentQueryImpl)cpSweep2DSegmentQuery,
+};
+
+static inline cpSpatialIndexClass *Klass(){return &klass;}